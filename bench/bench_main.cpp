@@ -0,0 +1,1266 @@
+// Host microbenchmarks for the code on
+// the control path. Reports ns/op and
+// heap allocations/op, and compares
+// against a saved baseline:
+//
+//   bench [--save] [--baseline path]
+//         [--tolerance percent]
+//
+// Exits nonzero if any benchmark's
+// fastest round is slower than the
+// baseline by more than the tolerance
+// or allocates more, if
+// the thermocouple correction misses the
+// NIST reference values, if the MPC
+// leaves its duty range or tracks the
+// simulated run poorly, or if the
+// supervisor misses a fault, trips
+// without one or reacts too slowly, or
+// if characterizing the plate model
+// doesn't recover it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <Arduino.h>
+#include <PID_v1.h>
+
+#include "calibration.hpp"
+#include "commands.hpp"
+#include "connections.hpp"
+#include "data.hpp"
+#include "decimator.hpp"
+#include "energy.hpp"
+#include "estimator.hpp"
+#include "gain_schedule.hpp"
+#include "lmt85.hpp"
+#include "max31855.hpp"
+#include "metrics.hpp"
+#include "mpc.hpp"
+#include "profile.hpp"
+#include "run_state.hpp"
+#include "sample_average.hpp"
+#include "spsc_queue.hpp"
+#include "supervisor.hpp"
+#include "system_id.hpp"
+#include "telemetry.hpp"
+#include "thermocouple.hpp"
+#include "trajectory.hpp"
+
+// Count heap allocations by wrapping
+// the C allocator; operator new goes
+// through malloc too
+static volatile unsigned long allocCount = 0;
+
+#ifdef __GLIBC__
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t n, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void __libc_free(void *ptr);
+
+    void *malloc(size_t size)
+    {
+        allocCount++;
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t n, size_t size)
+    {
+        allocCount++;
+        return __libc_calloc(n, size);
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+        allocCount++;
+        return __libc_realloc(ptr, size);
+    }
+
+    void free(void *ptr)
+    {
+        __libc_free(ptr);
+    }
+}
+#endif
+
+// Keeps results alive so the compiler
+// can't drop the work
+static volatile double sink;
+
+// The whole suite runs benchRounds
+// times, spread over the run, so a host
+// that's busy for a stretch doesn't
+// decide the result
+const int benchRounds = 5;
+
+struct Result
+{
+    const char *name;
+    double roundNs[benchRounds];
+    int rounds;
+    double allocs;
+
+    // Fastest round, which is compared
+    // against the baseline, and the
+    // median, which is saved as it; a
+    // change has to be slower than usual
+    // every round to count
+    double getBest() const;
+    double getTypical() const;
+};
+
+double Result::getBest() const
+{
+    return *std::min_element(roundNs, roundNs + rounds);
+}
+
+double Result::getTypical() const
+{
+    double sorted[benchRounds];
+    std::copy(roundNs, roundNs + rounds, sorted);
+    std::nth_element(sorted, sorted + rounds / 2, sorted + rounds);
+    return sorted[rounds / 2];
+}
+
+static const int maxResults = 32;
+static Result results[maxResults];
+static int numResults = 0;
+
+// Runs fn in batches of at least
+// minBatch_ms and adds the median as
+// one round
+template <typename F>
+static void bench(const char *name, F fn)
+{
+    typedef std::chrono::steady_clock Clock;
+    const double minBatch_ms = 20.0;
+    const int numBatches = 5;
+
+    // Find an iteration count that fills
+    // a batch
+    long iterations = 1;
+    while (true)
+    {
+        Clock::time_point start = Clock::now();
+        for (long i = 0; i < iterations; i++)
+        {
+            fn(i);
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (ms >= minBatch_ms)
+        {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    double batch_ns[numBatches];
+    unsigned long allocs = 0;
+    for (int b = 0; b < numBatches; b++)
+    {
+        unsigned long allocStart = allocCount;
+        Clock::time_point start = Clock::now();
+        for (long i = 0; i < iterations; i++)
+        {
+            fn(i);
+        }
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        allocs += allocCount - allocStart;
+
+        batch_ns[b] = ns / iterations;
+    }
+
+    // Median batch; less sensitive to a
+    // noisy host than the fastest
+    std::sort(batch_ns, batch_ns + numBatches);
+
+    double ns = batch_ns[numBatches / 2];
+    double perOp = (double)allocs / ((double)iterations * numBatches);
+    for (int i = 0; i < numResults; i++)
+    {
+        Result &r = results[i];
+        if (strcmp(r.name, name) == 0)
+        {
+            r.roundNs[r.rounds++] = ns;
+            r.allocs = std::max(r.allocs, perOp);
+            return;
+        }
+    }
+
+    Result &r = results[numResults++];
+    r.name = name;
+    r.roundNs[0] = ns;
+    r.rounds = 1;
+    r.allocs = perOp;
+}
+
+static void printResults()
+{
+    for (int i = 0; i < numResults; i++)
+    {
+        const Result &r = results[i];
+        printf("%-20s %10.1f ns/op %8.3f allocs/op  (%.1f - %.1f)\n",
+               r.name,
+               r.getTypical(),
+               r.allocs,
+               r.getBest(),
+               *std::max_element(r.roundNs, r.roundNs + r.rounds));
+    }
+}
+
+// Same points as chipQuikCurve in
+// main.cpp
+const ReflowCurvePoint benchCurve[] = {
+    {0, 25},
+    {90000, 90},
+    {180000, 130},
+    {210000, 138},
+    {240000, 165},
+    {270000, 138},
+    {-1, -1},
+};
+
+// Tracking of the chipquik profile by
+// the PID on a simulated plate with the
+// default model, one 100ms loop() tick
+// at a time, with or without a gain
+// schedule, coast mode and a shaped
+// setpoint, or with the MPC in place of
+// the PID when mpcConfig is given
+struct Tracking
+{
+    double rmsError;
+    double maxOvershoot;
+    double peak;
+    int gainSwitches;
+    double energy;
+
+    // Duty range the controller asked for
+    double minDuty;
+    double maxDuty;
+};
+
+static Tracking simulateRun(const GainSchedule &schedule,
+                            const EnergyConfig &energyConfig,
+                            const TrajectoryConfig &trajectoryConfig,
+                            const MpcConfig *mpcConfig = NULL)
+{
+    const PlateModel &model = defaultPlateModel;
+    const int tick_ms = 100;
+    const double dt = tick_ms / 1000.0;
+    const int deadTicks = (int)(model.deadTime / dt + 0.5);
+    const double outputMax = 4095;
+    const PidGains fixed = {500.0, 0.625, 1.0};
+
+    Profile profile("chipquik", benchCurve);
+    Trajectory trajectory;
+    trajectory.compile(profile, model, trajectoryConfig);
+    double input = model.ambient;
+    double output = 0.0;
+    double setpoint = 0.0;
+    PID pid(&input, &output, &setpoint, fixed.kp, fixed.ki, fixed.kd, DIRECT);
+    pid.SetOutputLimits(0, outputMax);
+    pid.SetSampleTime(tick_ms);
+    pid.SetMode(AUTOMATIC);
+
+    Mpc mpc;
+    if (mpcConfig != NULL)
+    {
+        mpc.begin(model, *mpcConfig);
+        mpc.reset(0.0);
+    }
+
+    // Duty applied deadTicks ago
+    double duty[64] = {};
+    int head = 0;
+
+    EnergyMeter meter;
+    meter.begin(energyConfig);
+    meter.reset();
+
+    Tracking t = {0.0, 0.0, 0.0, 0, 0.0, 1.0, 0.0};
+    long count = 0;
+    int gainIdx = -1;
+    for (unsigned long curveTime = 0;; curveTime += tick_ms)
+    {
+        setpoint = trajectory.setpointAt(curveTime);
+        if (setpoint == 0.0)
+        {
+            break;
+        }
+
+        if (mpcConfig != NULL)
+        {
+            output = mpc.compute(input, trajectory, curveTime, 0.0) * outputMax;
+        }
+        else
+        {
+            int idx = schedule.select(setpoint, trajectory.slopeAt(curveTime));
+            if (idx != gainIdx)
+            {
+                switchGains(pid, output, input, setpoint, idx < 0 ? fixed : schedule.getEntry(idx).gains);
+                gainIdx = idx;
+                t.gainSwitches++;
+            }
+
+            double trim = isCoasting(energyConfig, profile, curveTime) ? energyConfig.coastScale : 1.0;
+            pid.SetOutputLimits(0, outputMax * trim);
+
+            setMillis(millis() + tick_ms);
+            pid.Compute();
+        }
+        t.minDuty = std::min(t.minDuty, output / outputMax);
+        t.maxDuty = std::max(t.maxDuty, output / outputMax);
+
+        meter.add((int64_t)curveTime * 1000 + 1, output / outputMax);
+
+        duty[head] = output / outputMax;
+        head = (head + 1) % (deadTicks + 1);
+        double u = duty[head];
+        input += (model.ambient + model.gain * u - input) * (dt / model.tau);
+
+        double error = setpoint - input;
+        t.rmsError += error * error;
+        count++;
+        if (-error > t.maxOvershoot)
+        {
+            t.maxOvershoot = -error;
+        }
+        t.peak = std::max(t.peak, input);
+    }
+    t.rmsError = sqrt(t.rmsError / count);
+    t.energy = meter.getEnergy();
+
+    return t;
+}
+
+// Schedule tuned against the simulated
+// plate; a starting point for
+// "gainSchedule" in config.json
+static void addBenchSchedule(GainSchedule &schedule)
+{
+    const GainScheduleEntry entries[] = {
+        {140.0, PHASE_RISING, {800.0, 8.0, 1.0}},
+        {1000.0, PHASE_RISING, {2500.0, 1.0, 1.0}},
+        {1000.0, PHASE_ANY, {800.0, 8.0, 1.0}},
+    };
+    for (size_t i = 0; i < sizeof(entries) / sizeof(entries[0]); i++)
+    {
+        schedule.add(entries[i]);
+    }
+}
+
+// Worst MPC tracking error accepted on
+// the simulated plate (C rms)
+const double mpcMaxRmsError = 2.0;
+
+// Returns false if the MPC leaves its
+// duty range or tracks worse than
+// mpcMaxRmsError
+static bool reportTracking()
+{
+    GainSchedule none;
+    GainSchedule scheduled;
+    addBenchSchedule(scheduled);
+
+    EnergyConfig coast = defaultEnergyConfig;
+    coast.coast = true;
+
+    // The earlier comparisons follow the
+    // profile as given
+    TrajectoryConfig given = defaultTrajectoryConfig;
+    given.enabled = false;
+
+    Tracking fixed = simulateRun(none, defaultEnergyConfig, given);
+    Tracking tuned = simulateRun(scheduled, defaultEnergyConfig, given);
+    Tracking coasted = simulateRun(scheduled, coast, given);
+    Tracking shapedFixed = simulateRun(none, defaultEnergyConfig, defaultTrajectoryConfig);
+    Tracking shaped = simulateRun(scheduled, defaultEnergyConfig, defaultTrajectoryConfig);
+    Tracking mpc = simulateRun(none, defaultEnergyConfig, given, &defaultMpcConfig);
+    Tracking shapedMpc = simulateRun(none, defaultEnergyConfig, defaultTrajectoryConfig, &defaultMpcConfig);
+    printf("\nchipquik on the default plate model:\n");
+    printf("%-20s %6.2f C rms error %6.2f C max overshoot %6.1f C peak %6.1f kJ\n",
+           "fixed gains", fixed.rmsError, fixed.maxOvershoot, fixed.peak, fixed.energy / 1000.0);
+    printf("%-20s %6.2f C rms error %6.2f C max overshoot %6.1f C peak %6.1f kJ %d switches\n",
+           "gain schedule", tuned.rmsError, tuned.maxOvershoot, tuned.peak, tuned.energy / 1000.0, tuned.gainSwitches);
+    printf("%-20s %6.2f C rms error %6.2f C max overshoot %6.1f C peak %6.1f kJ\n",
+           "schedule + coast", coasted.rmsError, coasted.maxOvershoot, coasted.peak, coasted.energy / 1000.0);
+    printf("%-20s %6.2f C rms error %6.2f C max overshoot %6.1f C peak %6.1f kJ\n",
+           "fixed, shaped", shapedFixed.rmsError, shapedFixed.maxOvershoot, shapedFixed.peak, shapedFixed.energy / 1000.0);
+    printf("%-20s %6.2f C rms error %6.2f C max overshoot %6.1f C peak %6.1f kJ\n",
+           "schedule, shaped", shaped.rmsError, shaped.maxOvershoot, shaped.peak, shaped.energy / 1000.0);
+    printf("%-20s %6.2f C rms error %6.2f C max overshoot %6.1f C peak %6.1f kJ duty %.2f-%.2f\n",
+           "mpc", mpc.rmsError, mpc.maxOvershoot, mpc.peak, mpc.energy / 1000.0, mpc.minDuty, mpc.maxDuty);
+    printf("%-20s %6.2f C rms error %6.2f C max overshoot %6.1f C peak %6.1f kJ duty %.2f-%.2f\n",
+           "mpc, shaped", shapedMpc.rmsError, shapedMpc.maxOvershoot, shapedMpc.peak, shapedMpc.energy / 1000.0,
+           shapedMpc.minDuty, shapedMpc.maxDuty);
+    printf("coast: %+.1f%% energy, %+.2f C rms error\n",
+           100.0 * (coasted.energy - tuned.energy) / tuned.energy, coasted.rmsError - tuned.rmsError);
+
+    bool ok = true;
+    const Tracking *mpcRuns[] = {&mpc, &shapedMpc};
+    for (int i = 0; i < 2; i++)
+    {
+        const Tracking &run = *mpcRuns[i];
+        if (run.minDuty < 0.0 || run.maxDuty > 1.0)
+        {
+            printf("FAIL mpc duty %.3f-%.3f outside 0-1\n", run.minDuty, run.maxDuty);
+            ok = false;
+        }
+        if (!(run.rmsError <= mpcMaxRmsError))
+        {
+            printf("FAIL mpc tracking %.2f C rms, limit %.2f C\n", run.rmsError, mpcMaxRmsError);
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+// Compiles the chipquik profile against
+// the default plate model and lists
+// what it flags
+static void reportTrajectory()
+{
+    Profile profile("chipquik", benchCurve);
+    Trajectory trajectory;
+    const int repeats = 100;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; i++)
+    {
+        trajectory.compile(profile, defaultPlateModel, defaultTrajectoryConfig);
+    }
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / repeats;
+
+    int peak = 0;
+    for (int i = 0; i < profile.getNumPoints(); i++)
+    {
+        peak = std::max(peak, profile.getPoint(i).temp_c);
+    }
+
+    printf("\nchipquik compiled in %.1f us: peak %.1f C (profile %d C), up to %.1f C from the profile, %d infeasible segments\n",
+           us, trajectory.getPeak(), peak, trajectory.getMaxDeviation(), trajectory.getNumInfeasible());
+    for (int i = 0; i < trajectory.getNumInfeasible(); i++)
+    {
+        const InfeasibleSegment &s = trajectory.getInfeasible(i);
+        printf("  %lu-%lu s: %.2f C/s asked, %.2f C/s possible\n",
+               (unsigned long)profile.getPoint(s.point - 1).time_ms / 1000,
+               (unsigned long)profile.getPoint(s.point).time_ms / 1000,
+               s.slope, s.limit);
+    }
+}
+
+// NIST ITS-90 K-type reference table
+// values, C and mV
+struct KTypeReference
+{
+    double temp_c;
+    double emf_mV;
+};
+
+const KTypeReference kTypeReferences[] = {
+    {-40, -1.527},
+    {0, 0.000},
+    {25, 1.000},
+    {50, 2.023},
+    {100, 4.096},
+    {150, 6.138},
+    {200, 8.138},
+    {250, 10.153},
+    {300, 12.209},
+    {400, 16.397},
+    {500, 20.644},
+    {600, 24.905},
+    {800, 33.275},
+    {1000, 41.276},
+    {1372, 54.886},
+};
+
+// Worst error allowed against the
+// references (C); they are rounded to
+// 1 uV, about 0.025 C
+const double kTypeTolerance = 0.1;
+
+// Feeds every reference temperature
+// through what the MAX31855 would report
+// at each cold junction reference in
+// 0 - 50 C, and checks the correction
+// recovers it
+static bool checkThermocouple()
+{
+    const int numRefs = sizeof(kTypeReferences) / sizeof(kTypeReferences[0]);
+    double rawMax = 0.0;
+    double correctedMax = 0.0;
+    double correctedMaxAt = 0.0;
+
+    for (int j = 0; j < numRefs; j++)
+    {
+        const KTypeReference &cj = kTypeReferences[j];
+        if (cj.temp_c < 0 || cj.temp_c > 50)
+        {
+            continue;
+        }
+        for (int i = 0; i < numRefs; i++)
+        {
+            const KTypeReference &ref = kTypeReferences[i];
+            double reported = cj.temp_c + (ref.emf_mV - cj.emf_mV) / max31855Gain_mV;
+            double corrected = correctKType(reported, cj.temp_c);
+            rawMax = std::max(rawMax, fabs(reported - ref.temp_c));
+            if (fabs(corrected - ref.temp_c) > correctedMax)
+            {
+                correctedMax = fabs(corrected - ref.temp_c);
+                correctedMaxAt = ref.temp_c;
+            }
+        }
+    }
+
+    printf("\nK-type vs NIST ITS-90 references:\n");
+    printf("%-20s %6.2f C max error\n", "linear (MAX31855)", rawMax);
+    printf("%-20s %6.2f C max error at %.0f C\n", "corrected", correctedMax, correctedMaxAt);
+    if (correctedMax > kTypeTolerance)
+    {
+        printf("FAIL thermocouple correction: %.3f C, tolerance %.3f C\n", correctedMax, kTypeTolerance);
+        return false;
+    }
+
+    return true;
+}
+
+// Supervisor scenarios, checked at the
+// supervisor task's period with samples
+// arriving at the sensor tasks' rates,
+// as in main.cpp
+const int supervisorPeriod_ms = 10;
+const int supervisorSamplePeriods_ms[SUPERVISOR_CHANNEL_COUNT] = {25, 25, 100};
+
+// The supervisor promises heaters off
+// within two of its periods
+const int64_t supervisorMaxLatency_us = 2 * supervisorPeriod_ms * 1000;
+
+// A scenario fills in what each sensor
+// reads and the duty at t (s); a NaN
+// reading is a sample that never comes
+struct SupervisorScenario
+{
+    const char *name;
+    uint32_t expected;
+    double duration;
+    void (*read)(double t, double temp[SUPERVISOR_CHANNEL_COUNT], double &duty);
+};
+
+static void plateAt(double t, double duty, double temp[SUPERVISOR_CHANNEL_COUNT])
+{
+    const PlateModel &m = defaultPlateModel;
+    double plate = m.ambient + m.gain * duty * (1.0 - exp(-t / m.tau));
+    for (int c = 0; c < SUPERVISOR_CHANNEL_COUNT; c++)
+    {
+        temp[c] = plate;
+    }
+}
+
+const SupervisorScenario supervisorScenarios[] = {
+    {"ramp, full duty", FAULT_NONE, 120.0, [](double t, double *temp, double &duty) {
+         duty = 1.0;
+         plateAt(t, duty, temp);
+     }},
+    {"steady hold, 200 C", FAULT_NONE, 300.0, [](double t, double *temp, double &duty) {
+         duty = 0.6;
+         for (int c = 0; c < SUPERVISOR_CHANNEL_COUNT; c++)
+         {
+             temp[c] = 200.0 + 0.2 * sin(t);
+         }
+     }},
+    {"tc1 stale", FAULT_TC1_STALE, 10.0, [](double t, double *temp, double &duty) {
+         duty = 0.5;
+         plateAt(t, duty, temp);
+         temp[SUPERVISOR_TC1] = t < 1.0 ? temp[SUPERVISOR_TC1] : NAN;
+     }},
+    {"tc2 stale", FAULT_TC2_STALE, 10.0, [](double t, double *temp, double &duty) {
+         duty = 0.5;
+         plateAt(t, duty, temp);
+         temp[SUPERVISOR_TC2] = t < 1.0 ? temp[SUPERVISOR_TC2] : NAN;
+     }},
+    {"lmt85 stale", FAULT_LMT85_STALE, 10.0, [](double t, double *temp, double &duty) {
+         duty = 0.5;
+         plateAt(t, duty, temp);
+         temp[SUPERVISOR_LMT85] = t < 1.0 ? temp[SUPERVISOR_LMT85] : NAN;
+     }},
+    {"over temperature", FAULT_OVER_TEMP, 60.0, [](double t, double *temp, double &duty) {
+         duty = 1.0;
+         for (int c = 0; c < SUPERVISOR_CHANNEL_COUNT; c++)
+         {
+             temp[c] = 240.0 + t;
+         }
+     }},
+    {"tc1/tc2 disagree", FAULT_DISAGREEMENT, 10.0, [](double t, double *temp, double &duty) {
+         duty = 0.5;
+         plateAt(t, duty, temp);
+         temp[SUPERVISOR_TC2] += t < 2.0 ? 0.0 : 15.0;
+     }},
+    {"runaway, off plate", FAULT_RUNAWAY, 120.0, [](double t, double *temp, double &duty) {
+         duty = 1.0;
+         for (int c = 0; c < SUPERVISOR_CHANNEL_COUNT; c++)
+         {
+             temp[c] = 25.0 + 0.01 * t;
+         }
+     }},
+    {"runaway, stuck fet", FAULT_RUNAWAY, 120.0, [](double t, double *temp, double &duty) {
+         duty = 0.0;
+         for (int c = 0; c < SUPERVISOR_CHANNEL_COUNT; c++)
+         {
+             temp[c] = 100.0 + 0.5 * t;
+         }
+     }},
+};
+
+// Runs one scenario until the first
+// fault, forcing the heaters off in the
+// same period as the task does; returns
+// the latched faults
+static uint32_t runSupervisor(const SupervisorScenario &s, int64_t &latency_us)
+{
+    SupervisorLimits limits = defaultSupervisorLimits;
+    limits.requiredChannels = (1 << SUPERVISOR_CHANNEL_COUNT) - 1;
+    limits.maxDisagreement = 10.0;
+    Supervisor supervisor;
+    supervisor.begin(limits);
+
+    SupervisorInputs inputs = {};
+    int64_t nextSample_us[SUPERVISOR_CHANNEL_COUNT] = {};
+    double temp[SUPERVISOR_CHANNEL_COUNT];
+    double duty = 0.0;
+    uint32_t faults = FAULT_NONE;
+    latency_us = 0;
+    for (int64_t now = 0; now <= (int64_t)(s.duration * 1e6); now += supervisorPeriod_ms * 1000)
+    {
+        for (int c = 0; c < SUPERVISOR_CHANNEL_COUNT; c++)
+        {
+            while (nextSample_us[c] <= now)
+            {
+                s.read(nextSample_us[c] / 1e6, temp, duty);
+                if (!isnan(temp[c]))
+                {
+                    inputs.temp[c] = temp[c];
+                    inputs.timestamp_us[c] = nextSample_us[c];
+                }
+                nextSample_us[c] += supervisorSamplePeriods_ms[c] * 1000;
+            }
+        }
+        s.read(now / 1e6, temp, duty);
+        inputs.duty = duty;
+        inputs.steadyTemp = defaultPlateModel.ambient + defaultPlateModel.gain * duty;
+
+        faults = supervisor.check(inputs, now);
+        if (faults != FAULT_NONE)
+        {
+            supervisor.heatersOff(now);
+            latency_us = supervisor.getLastLatency_us();
+            break;
+        }
+    }
+
+    return faults;
+}
+
+// Each scenario must latch exactly its
+// fault, and the heaters must go off
+// within the promised bound of its onset
+static bool checkSupervisor()
+{
+    bool ok = true;
+    int64_t maxLatency_us = 0;
+
+    printf("\nSupervisor scenarios:\n");
+    for (size_t i = 0; i < sizeof(supervisorScenarios) / sizeof(supervisorScenarios[0]); i++)
+    {
+        const SupervisorScenario &s = supervisorScenarios[i];
+        int64_t latency_us;
+        uint32_t faults = runSupervisor(s, latency_us);
+        maxLatency_us = std::max(maxLatency_us, latency_us);
+
+        bool passed = faults == s.expected && latency_us <= supervisorMaxLatency_us;
+        printf("%-20s faults 0x%02x (want 0x%02x), heaters off %.1f ms after onset%s\n",
+               s.name,
+               (unsigned int)faults,
+               (unsigned int)s.expected,
+               latency_us / 1000.0,
+               passed ? "" : "  FAIL");
+        ok = ok && passed;
+    }
+    printf("%-20s %.1f ms, bound %.1f ms\n", "worst heater off", maxLatency_us / 1000.0, supervisorMaxLatency_us / 1000.0);
+
+    return ok;
+}
+
+// Largest error allowed in each fitted
+// plate model parameter: gain and tau
+// as a fraction, dead time in s
+const double sysIdMaxGainError = 0.05;
+const double sysIdMaxTauError = 0.1;
+const double sysIdMaxDeadTimeError = 1.0;
+
+// Characterizes the default plate model
+// at loop()'s 100ms tick with TC1 noise
+// and quantization, as the firmware
+// would, and checks the fit gets the
+// model back
+static bool checkSystemId()
+{
+    const PlateModel &model = defaultPlateModel;
+    const int tick_ms = 100;
+    const int deadTicks = (int)(model.deadTime * 1000 / tick_ms + 0.5);
+    const double a = exp(-tick_ms / 1000.0 / model.tau);
+    const SysIdExcitation excitations[] = {SYSID_STEP, SYSID_PRBS};
+    const char *const names[] = {"step", "prbs"};
+    bool ok = true;
+
+    printf("\nCharacterization of the default plate model (gain %.1f C, tau %.1f s, dead time %.1f s):\n",
+           model.gain, model.tau, model.deadTime);
+    for (int e = 0; e < 2; e++)
+    {
+        SysIdConfig config = defaultSysIdConfig;
+        config.excitation = excitations[e];
+        SystemId systemId;
+        systemId.begin(config);
+        systemId.start(0);
+
+        double temp = model.ambient;
+        double duty[64] = {};
+        int head = 0;
+        uint32_t seed = 1;
+        for (unsigned long ms = 0; !systemId.isDone(ms, temp); ms += tick_ms)
+        {
+            // White noise of about 0.1 C rms,
+            // then the MAX31855's 0.25 C steps
+            seed = seed * 1664525u + 1013904223u;
+            double noise = ((seed >> 8) / 16777216.0 - 0.5) * 0.35;
+            double tc1 = floor((temp + noise) / 0.25 + 0.5) * 0.25;
+
+            double u = systemId.dutyAt(ms);
+            systemId.addSample(ms, u, tc1, NAN);
+
+            duty[head] = u;
+            head = (head + 1) % (deadTicks + 1);
+            temp = model.ambient + model.gain * duty[head] + (temp - model.ambient - model.gain * duty[head]) * a;
+        }
+
+        PlateModel fitted;
+        double rmsError;
+        bool fit = systemId.getModel(SYSID_TC1, fitted, rmsError);
+        bool passed = fit &&
+                      fabs(fitted.gain / model.gain - 1.0) <= sysIdMaxGainError &&
+                      fabs(fitted.tau / model.tau - 1.0) <= sysIdMaxTauError &&
+                      fabs(fitted.deadTime - model.deadTime) <= sysIdMaxDeadTimeError;
+        if (fit)
+        {
+            printf("%-20s gain %6.1f C, tau %6.1f s, dead time %4.1f s, fit %.2f C rms, %ld samples%s\n",
+                   names[e], fitted.gain, fitted.tau, fitted.deadTime, rmsError, systemId.getSamples(),
+                   passed ? "" : "  FAIL");
+        }
+        else
+        {
+            printf("%-20s no usable fit  FAIL\n", names[e]);
+        }
+        ok = ok && passed;
+    }
+
+    return ok;
+}
+
+// Readings per window and the largest
+// error allowed in the bits gained
+const int decimatorReadings = 600;
+const double decimatorMaxBitsError = 0.25;
+
+// Input noise (counts rms) and ramp
+// (counts per reading) per scenario
+struct DecimatorScenario
+{
+    const char *name;
+    double rawNoise;
+    double ramp;
+};
+
+// 2 counts per reading is about 0.5 C/s.
+// A steady input with little noise sits
+// on one code, so gains nothing; a ramp
+// dithers it as well as noise does.
+const DecimatorScenario decimatorScenarios[] = {
+    {"steady, 0.2 counts", 0.2, 0.0},
+    {"ramp, 0.2 counts", 0.2, 2.0},
+    {"ramp, 1 count", 1.0, 2.0},
+    {"ramp, 4 counts", 4.0, 2.0},
+};
+
+// Feeds the LMT85 decimator Gaussian
+// noise on a steady input and on a
+// ramp, and checks the bits it reports
+// against the output noise expected
+// from N samples of noise plus
+// quantization
+static bool checkDecimator()
+{
+    const int n = 64;
+    bool ok = true;
+
+    printf("\nLMT85 decimator, %d samples/reading:\n", n);
+    for (const DecimatorScenario &s : decimatorScenarios)
+    {
+        Decimator<n> decimator;
+        uint32_t seed = 1;
+        double level = 2000.3;
+        for (int i = 0; i < n * decimatorReadings; i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            double u1 = ((seed >> 8) + 1) / 16777217.0;
+            seed = seed * 1664525u + 1013904223u;
+            double u2 = (seed >> 8) / 16777216.0;
+            double gaussian = sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+
+            level += s.ramp / n;
+            decimator.add((uint16_t)floor(level + s.rawNoise * gaussian + 0.5));
+        }
+
+        double expected = s.ramp == 0.0 && s.rawNoise < 0.5
+                              ? 0.0
+                              : fmin(Decimator<n>::getNominalBitsGained(),
+                                     -log2(sqrt((s.rawNoise * s.rawNoise + 1.0 / 12) / n)));
+        double bits = decimator.getBitsGained();
+        bool passed = fabs(bits - expected) <= decimatorMaxBitsError;
+        printf("%-20s output %.3f counts rms, +%.2f bits (expected %.2f)%s\n",
+               s.name, decimator.getOutputNoise(), bits, expected, passed ? "" : "  FAIL");
+        ok = ok && passed;
+    }
+
+    return ok;
+}
+
+// Returns the total bytes "sent"
+static int csvTick(const Data &data, ConnectionList &conns, char *frame, size_t size, long tick)
+{
+    TelemetryRow row;
+    row.setpoint = data.getSetpoint();
+    row.tc1Temp = data.getTc1Temp();
+    row.tc2Temp = data.getTc2Temp();
+    row.lmt85Temp = data.getLmt85Temp();
+    row.estimateTemp = data.getEstimateTemp();
+    row.estimateRate = data.getEstimateRate();
+
+    int64_t sample_us;
+    int64_t actuated_us;
+    data.getControlTiming(sample_us, actuated_us);
+    row.sensorToActuation_us = actuated_us - sample_us;
+    row.sampleToClient_us = 4321;
+    row.energy_J = 5123;
+    row.numOutputs = 1;
+    row.outputs[0] = 42.5;
+    row.phase = "reflow";
+
+    char *body = frame + csvTimePrefixSize;
+    int bodyLen = formatCsvBody(body, size - csvTimePrefixSize, row);
+
+    int sent = 0;
+    for (int c = 0; c < conns.getCount(); c++)
+    {
+        int64_t reportTime_us = tick * 100000 - conns.get(c).zero_us;
+        char *start = prependCsvTime(body, reportTime_us > 0 ? reportTime_us / 1000 : 0);
+        sent += body + bodyLen - start;
+    }
+
+    return sent;
+}
+
+// A list of numConns clients that
+// connected a second apart
+static void fillConnections(ConnectionList &conns, int numConns)
+{
+    conns.begin(numConns + 1);
+    for (int c = 0; c < numConns; c++)
+    {
+        conns.add(c, (int64_t)c * 1000000);
+    }
+}
+
+static int printfCsvTick(const Data &data, char *frame, size_t size, int numConns, long tick)
+{
+    int sent = 0;
+    for (int c = 0; c < numConns; c++)
+    {
+        unsigned long reportTime = (unsigned long)(tick * 100 + c * 1000);
+        sent += snprintf(frame, size,
+                         "%0.2f,%0.2f,%0.2f,%0.2f,%0.2f,%0.2f,%0.3f,%0.2f\n",
+                         (double)reportTime / 1000.0,
+                         data.getSetpoint(),
+                         data.getTc1Temp(),
+                         data.getTc2Temp(),
+                         data.getLmt85Temp(),
+                         data.getEstimateTemp(),
+                         data.getEstimateRate(),
+                         42.5);
+    }
+
+    return sent;
+}
+
+static void runBenchmarks()
+{
+    // Fixed integer workload; the other
+    // results are compared relative to it
+    // so a slower or busier host doesn't
+    // read as a regression
+    bench("host_scale", [](long i) {
+        uint32_t x = (uint32_t)i;
+        for (int k = 0; k < 100; k++)
+        {
+            x = x * 1664525u + 1013904223u;
+        }
+        sink = x;
+    });
+
+    // Thermocouple frame decode: 100.25 C
+    // at 24.5 C cold junction, -10.5 C,
+    // and an open circuit
+    const uint32_t frames[] = {0x06441880, 0xFF581880, 0x00011881, 0x06441880};
+    bench("max31855_decode", [&](long i) {
+        Max31855Sample sample = decodeMax31855Frame(frames[i & 3]);
+        sink = sample.temp_c + sample.coldJunction_c + sample.faults;
+    });
+
+    // K-type correction across the reflow
+    // range
+    bench("ktype_correct", [](long i) {
+        sink = correctKType(20.0 + (i % 1024) * 0.25, 24.5 + (i & 7) * 0.0625);
+    });
+
+    // Sensor calibration through four
+    // points, across the reflow range
+    Calibration sensorCalibration;
+    const CalibrationPoint calPoints[] = {
+        {60.0, {59.4, 61.0, 58.8}},
+        {100.0, {99.1, 101.6, 98.0}},
+        {150.0, {148.9, 152.3, 147.2}},
+        {200.0, {198.6, 203.1, NAN}},
+    };
+    sensorCalibration.set(calPoints, 4);
+    bench("sensor_calibration", [&](long i) {
+        sink = sensorCalibration.apply((CalSensor)(i % CAL_SENSOR_COUNT), 20.0 + (i % 1024) * 0.25);
+    });
+
+    // LMT85 lookup across its range
+    bench("lmt85_lookup", [](long i) {
+        sink = getLMT85Temp(300 + (i % 11200) * 0.125);
+    });
+
+    // One ADC burst into the LMT85
+    // decimator
+    Decimator<64> decimator;
+    bench("lmt85_decimate", [&](long i) {
+        for (int k = 0; k < 8; k++)
+        {
+            decimator.add((uint16_t)(2142 + ((i + k) & 3)));
+        }
+        sink = decimator.getReading();
+    });
+
+    // Profile interpolation, one loop()
+    // tick (100ms) at a time
+    Profile profile("chipquik", benchCurve);
+    bench("profile_setpoint", [&](long i) {
+        sink = profile.setpointAt((unsigned long)((i * 100) % 280000));
+    });
+
+    // The same from the compiled table
+    Trajectory trajectory;
+    trajectory.compile(profile, defaultPlateModel, defaultTrajectoryConfig);
+    bench("trajectory_setpoint", [&](long i) {
+        sink = trajectory.setpointAt((unsigned long)((i * 100) % 280000));
+    });
+
+    // PID on a first order plate; the
+    // fake clock advances one sample
+    // time per call so every call
+    // computes
+    double input = 25.0;
+    double output = 0.0;
+    double setpoint = 150.0;
+    PID pid(&input, &output, &setpoint, 500.0, 0.625, 1.0, DIRECT);
+    pid.SetOutputLimits(0, 4095);
+    pid.SetSampleTime(100);
+    pid.SetMode(AUTOMATIC);
+    bench("pid_compute", [&](long) {
+        setMillis(millis() + 100);
+        pid.Compute();
+        input += (25.0 + 300.0 * output / 4095 - input) * (0.1 / 120.0);
+        sink = output;
+    });
+
+    // One csvServer() tick: shared data
+    // reads, the row formatted once and
+    // each client's time patched in
+    Data data;
+    data.setTc1Temp(137.25, 0);
+    data.setTc2Temp(136.75, 0);
+    data.setLmt85(1071, getLMT85Temp(1071), 0);
+    data.setSetpoint(138.0);
+    data.setEstimate(137.1, 0.912);
+    data.setControlTiming(1000000, 1001234);
+    char frame[512];
+    ConnectionList conns;
+    fillConnections(conns, 1);
+    bench("csv_tick_1", [&](long i) {
+        sink = csvTick(data, conns, frame, sizeof(frame), i);
+    });
+    fillConnections(conns, 10);
+    bench("csv_tick_10", [&](long i) {
+        sink = csvTick(data, conns, frame, sizeof(frame), i);
+    });
+    fillConnections(conns, 100);
+    bench("csv_tick_100", [&](long i) {
+        sink = csvTick(data, conns, frame, sizeof(frame), i);
+    });
+
+    // A client connecting and dropping
+    // with 10 and 100 already connected
+    fillConnections(conns, 10);
+    bench("conn_accept_10", [&](long i) {
+        conns.add(1000, i);
+        conns.remove(conns.getCount() - 1);
+    });
+    fillConnections(conns, 100);
+    bench("conn_accept_100", [&](long i) {
+        conns.add(1000, i);
+        conns.remove(conns.getCount() - 1);
+    });
+
+    // The same tick done the old way, for
+    // comparison: reads and printf per
+    // client
+    bench("csv_tick_10_printf", [&](long i) {
+        sink = printfCsvTick(data, frame, sizeof(frame), 10, i);
+    });
+
+    // Thermocouple averaging as done
+    // per sample in readThermocouples()
+    SampleAverage<double, 4> tcSamples;
+    bench("sample_average", [&](long i) {
+        tcSamples.add(100.0 + (i & 7) * 0.25);
+        if (tcSamples.isFull())
+        {
+            sink = tcSamples.average();
+        }
+    });
+
+    // The shared data reads done every
+    // loop() tick plus one sensor write
+    bench("data_accessors", [&](long i) {
+        data.setTc1Temp(100.0 + (i & 7), i);
+        sink = data.getTc1Temp() + data.getTc2Temp() + data.getLmt85_mV() + data.getSetpoint();
+    });
+
+    // Kalman estimator update
+    Estimator estimator;
+    estimator.begin(defaultPlateModel, 0.1, 25.0);
+    bench("estimator_update", [&](long i) {
+        estimator.update(0.5, 100.0 + (i & 3) * 0.25, 100.5, 99.0);
+        sink = estimator.getTemp();
+    });
+
+    // Command lines as read off a CSV
+    // client
+    const char *const lines[] = {"start", "setpoint 150.5", "gains 500 0.625 1", "subscribe tc1,tc2,phase 500"};
+    bench("command_parse", [&](long i) {
+        Command command;
+        sink = parseCommand(lines[i & 3], command);
+    });
+
+    // Hot path counter increment, and a
+    // full /metrics scrape's counters
+    Metrics metrics;
+    bench("metrics_add", [&](long i) {
+        metrics.add((Counter)(i % COUNTER_COUNT));
+    });
+    static char metricsText[4096];
+    bench("metrics_format", [&](long) {
+        MetricsWriter w(metricsText, sizeof(metricsText));
+        w.counters(metrics);
+        sink = w.end();
+    });
+
+    // Button event through the queue to
+    // loop(), and the run phase lookup it
+    // does every tick
+    SpscQueue<RunEvent, 8> events;
+    bench("event_queue", [&](long i) {
+        RunEvent event = {EVENT_BUTTON, i, 100};
+        events.push(event);
+        events.pop(event);
+        sink = event.time_us;
+    });
+    bench("run_phase", [&](long i) {
+        sink = RunStateMachine::phaseAt(profile, (unsigned long)((i * 100) % 280000));
+    });
+
+    // Gain schedule lookup, one loop()
+    // tick per call
+    GainSchedule schedule;
+    addBenchSchedule(schedule);
+    bench("gain_schedule_select", [&](long i) {
+        unsigned long t = (unsigned long)((i * 100) % 270000);
+        sink = schedule.select(profile.setpointAt(t), profile.slopeAt(t));
+    });
+
+    // MPC step at the default horizon
+    Mpc mpc;
+    mpc.begin(defaultPlateModel, defaultMpcConfig);
+    mpc.reset(0.0);
+    bench("mpc_compute", [&](long i) {
+        sink = mpc.compute(100.0, trajectory, (unsigned long)((i * 100) % 270000), 0.0);
+    });
+}
+
+static bool saveBaseline(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Can't write %s\n", path);
+        return false;
+    }
+
+    fprintf(f, "# name ns/op allocs/op\n");
+    for (int i = 0; i < numResults; i++)
+    {
+        fprintf(f, "%s %.1f %.3f\n", results[i].name, results[i].getTypical(), results[i].allocs);
+    }
+    fclose(f);
+
+    printf("Saved baseline to %s\n", path);
+    return true;
+}
+
+// Baselines under smallOp_ns get at
+// least smallOpTolerance percent
+const double smallOp_ns = 20.0;
+const double smallOpTolerance = 60.0;
+
+// Returns the number of regressions,
+// or -1 if there's no baseline
+static int compareBaseline(const char *path, double tolerance)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        fprintf(stderr, "No baseline at %s; run with --save\n", path);
+        return -1;
+    }
+
+    // host_scale is always first
+    double hostScale = 1.0;
+    int regressions = 0;
+    char line[128];
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        char name[64];
+        double ns;
+        double allocs;
+        if (line[0] == '#' || sscanf(line, "%63s %lf %lf", name, &ns, &allocs) != 3)
+        {
+            continue;
+        }
+
+        for (int i = 0; i < numResults; i++)
+        {
+            const Result &r = results[i];
+            if (strcmp(r.name, name) != 0)
+            {
+                continue;
+            }
+
+            if (strcmp(name, "host_scale") == 0)
+            {
+                hostScale = r.getTypical() / ns;
+                printf("Host speed vs baseline: %.2fx\n", 1.0 / hostScale);
+                continue;
+            }
+
+            // A few ns of jitter is a large
+            // fraction of the smallest ops
+            double allowed = ns < smallOp_ns ? std::max(tolerance, smallOpTolerance) : tolerance;
+            if (r.getBest() > ns * hostScale * (1.0 + allowed / 100.0))
+            {
+                printf("REGRESSION %s: %.1f ns/op at best, baseline %.1f (%.1f scaled)\n", name, r.getBest(), ns, ns * hostScale);
+                regressions++;
+            }
+            if (r.allocs > allocs + 0.0005)
+            {
+                printf("REGRESSION %s: %.3f allocs/op, baseline %.3f\n", name, r.allocs, allocs);
+                regressions++;
+            }
+        }
+    }
+    fclose(f);
+
+    return regressions;
+}
+
+int main(int argc, char **argv)
+{
+    const char *baselinePath = "bench/baseline.txt";
+    double tolerance = 25.0;
+    bool save = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--save") == 0)
+        {
+            save = true;
+        }
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+        {
+            baselinePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+        {
+            tolerance = atof(argv[++i]);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--save] [--baseline path] [--tolerance percent]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    for (int round = 0; round < benchRounds; round++)
+    {
+        runBenchmarks();
+    }
+    printResults();
+    bool tracked = reportTracking();
+    reportTrajectory();
+    bool supervised = checkSupervisor();
+    bool identified = checkSystemId();
+    bool decimated = checkDecimator();
+    if (!checkThermocouple() || !tracked || !supervised || !identified || !decimated)
+    {
+        return 1;
+    }
+
+    if (save)
+    {
+        return saveBaseline(baselinePath) ? 0 : 1;
+    }
+
+    int regressions = compareBaseline(baselinePath, tolerance);
+    if (regressions != 0)
+    {
+        return 1;
+    }
+
+    printf("No regressions against %s\n", baselinePath);
+    return 0;
+}
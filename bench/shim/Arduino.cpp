@@ -0,0 +1,59 @@
+#include <stdarg.h>
+#include <mutex>
+#include "Arduino.h"
+
+HardwareSerial Serial;
+
+static unsigned long fakeMillis = 0;
+
+unsigned long millis()
+{
+    return fakeMillis;
+}
+
+void setMillis(unsigned long ms)
+{
+    fakeMillis = ms;
+}
+
+void delay(unsigned long ms)
+{
+    fakeMillis += ms;
+}
+
+size_t HardwareSerial::println(const char *s)
+{
+    return ::printf("%s\n", s);
+}
+
+size_t HardwareSerial::printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int len = vprintf(format, args);
+    va_end(args);
+
+    return len;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return new std::mutex();
+}
+
+int xSemaphoreTake(SemaphoreHandle_t sem, TickType_t)
+{
+    static_cast<std::mutex *>(sem)->lock();
+    return 1;
+}
+
+int xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    static_cast<std::mutex *>(sem)->unlock();
+    return 1;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    delete static_cast<std::mutex *>(sem);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+// Just enough of the Arduino core and
+// FreeRTOS to build the firmware's
+// pure-logic code on the host
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+// Fake millisecond clock; benchmarks
+// advance it with setMillis()
+unsigned long millis();
+void setMillis(unsigned long ms);
+void delay(unsigned long ms);
+
+class HardwareSerial
+{
+public:
+    size_t println(const char *s);
+    size_t printf(const char *format, ...);
+};
+
+extern HardwareSerial Serial;
+
+// Semaphores are backed by std::mutex
+typedef void *SemaphoreHandle_t;
+typedef uint32_t TickType_t;
+
+#define portMAX_DELAY 0xffffffff
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+int xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+int xSemaphoreGive(SemaphoreHandle_t sem);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+
+// Benchmarks run on one thread
+inline int xPortGetCoreID()
+{
+    return 0;
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <atomic>
+
+enum CalSensor
+{
+    CAL_SENSOR_TC1,
+    CAL_SENSOR_TC2,
+    CAL_SENSOR_LMT85,
+    CAL_SENSOR_COUNT
+};
+
+// What every sensor read at one stable
+// plate temperature, and what they all
+// should have read; NaN where a sensor
+// was out of range
+struct CalibrationPoint
+{
+    double reference;
+    double raw[CAL_SENSOR_COUNT];
+};
+
+// Per sensor piecewise-linear
+// corrections through the calibration
+// points, flattened into offset tables
+// at a fixed step, so a sample costs one
+// index and one interpolation however
+// many points there are. Readings past
+// a sensor's first or last point get
+// that point's offset.
+//
+// The tables are double buffered: set()
+// fills the idle copy, then switches
+// the readers over to it. Calls to set()
+// must be serialized.
+class Calibration
+{
+public:
+    static const int maxPoints = 8;
+
+    // -50 C to 460 C
+    static const int tableMin = -50;
+    static const int tableStep = 2;
+    static const int tableSize = 256;
+
+    Calibration();
+
+public:
+    // False, with nothing changed, if the
+    // points can't be used
+    bool set(const CalibrationPoint *points, int numPoints);
+    int getNumPoints() const;
+    const CalibrationPoint &getPoint(int i) const;
+
+    // Disabled passes readings through
+    // unchanged
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    double apply(CalSensor sensor, double temp) const;
+
+    static const char *getSensorName(CalSensor sensor);
+
+private:
+    void buildTable(CalSensor sensor, float *table) const;
+
+    CalibrationPoint _points[maxPoints];
+    int _numPoints;
+    float _tables[2][CAL_SENSOR_COUNT][tableSize];
+    std::atomic<int> _active;
+    std::atomic<bool> _enabled;
+};
+
+struct CalibrationConfig
+{
+    // Plate temperatures to record at
+    // (C)
+    double setpoints[Calibration::maxPoints];
+    int numSetpoints;
+
+    // Sensor the others are corrected to,
+    // or CAL_SENSOR_COUNT for their mean
+    int reference;
+};
+
+const CalibrationConfig defaultCalibrationConfig = {{60.0, 100.0, 150.0, 200.0}, 4, CAL_SENSOR_COUNT};
+
+enum CalibrationStep
+{
+    CAL_STEP_WAITING,
+    CAL_STEP_RECORDED,
+    CAL_STEP_DONE,
+    CAL_STEP_TIMED_OUT,
+};
+
+// Steps the plate through the configured
+// setpoints and, once every sensor has
+// held still at each, records their
+// averages. Fed raw readings, one per
+// loop() tick.
+class Calibrator
+{
+public:
+    // Time allowed to reach each setpoint
+    // before looking for a stable window,
+    // and to find one (ms)
+    static const unsigned long settleTime_ms = 120000;
+    static const unsigned long pointTimeout_ms = 1200000;
+
+    // Window of samples (30 s of ticks)
+    // every sensor must stay within
+    // stableBand (C) over
+    static const int windowSamples = 300;
+    static constexpr double stableBand = 0.5;
+
+    Calibrator();
+
+public:
+    void start(const CalibrationConfig &config, unsigned long now_ms);
+
+    // temps[] holds CAL_SENSOR_COUNT
+    // readings, NaN if out of range
+    CalibrationStep addSample(unsigned long now_ms, const double *temps);
+
+    double getSetpoint() const;
+    int getStep() const;
+    int getNumSteps() const;
+
+    int getNumPoints() const;
+    const CalibrationPoint *getPoints() const;
+
+private:
+    void resetWindow();
+
+    CalibrationConfig _config;
+    int _step;
+    unsigned long _stepStart_ms;
+
+    int _windowCount;
+    int _valid[CAL_SENSOR_COUNT];
+    double _min[CAL_SENSOR_COUNT];
+    double _max[CAL_SENSOR_COUNT];
+    double _sum[CAL_SENSOR_COUNT];
+
+    CalibrationPoint _points[Calibration::maxPoints];
+    int _numPoints;
+};
+
+inline int Calibration::getNumPoints() const
+{
+    return _numPoints;
+}
+
+inline const CalibrationPoint &Calibration::getPoint(int i) const
+{
+    return _points[i];
+}
+
+inline void Calibration::setEnabled(bool enabled)
+{
+    _enabled.store(enabled, std::memory_order_release);
+}
+
+inline bool Calibration::isEnabled() const
+{
+    return _enabled.load(std::memory_order_acquire);
+}
+
+inline double Calibration::apply(CalSensor sensor, double temp) const
+{
+    if (isnan(temp) || !isEnabled())
+    {
+        return temp;
+    }
+
+    const float *table = _tables[_active.load(std::memory_order_acquire)][sensor];
+    float pos = ((float)temp - tableMin) * (1.0f / tableStep);
+    if (pos < 0.0f)
+    {
+        pos = 0.0f;
+    }
+    else if (pos > tableSize - 1)
+    {
+        pos = tableSize - 1;
+    }
+    int i = (int)pos;
+    if (i > tableSize - 2)
+    {
+        i = tableSize - 2;
+    }
+
+    return temp + table[i] + (table[i + 1] - table[i]) * (pos - i);
+}
+
+inline double Calibrator::getSetpoint() const
+{
+    return _step < _config.numSetpoints ? _config.setpoints[_step] : 0.0;
+}
+
+inline int Calibrator::getStep() const
+{
+    return _step;
+}
+
+inline int Calibrator::getNumSteps() const
+{
+    return _config.numSetpoints;
+}
+
+inline int Calibrator::getNumPoints() const
+{
+    return _numPoints;
+}
+
+inline const CalibrationPoint *Calibrator::getPoints() const
+{
+    return _points;
+}
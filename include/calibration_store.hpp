@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "calibration.hpp"
+
+// Sensor calibration, kept on LittleFS
+// as JSON and exchanged unchanged over
+// HTTP, so one plate's file can be
+// loaded on another or hand edited:
+// {"points": [{"reference": 100.0,
+//   "tc1": 99.6, "tc2": 101.1,
+//   "lmt85": 98.9}, ...]}
+// A sensor left out of a point was out
+// of range there.
+const char *const calibrationPath = "/calibration.json";
+
+bool loadCalibration(const char *path, Calibration &calibration);
+bool saveCalibration(const char *path, const Calibration &calibration);
+
+// Applies an imported file; false, with
+// nothing changed, if it isn't valid
+bool importCalibration(const char *json, size_t length, Calibration &calibration);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "profile.hpp"
+
+// Line commands accepted on the CSV
+// port:
+//
+//   start
+//   cancel
+//   profile <name>
+//   setpoint <C>           (0 is off)
+//   gains <kp> <ki> <kd>
+//   calibrate              (cancel stops)
+//   coast <0|1>
+//   idle <0|1>             (allow idle mode)
+//   subscribe <columns> [period ms]
+//     e.g. subscribe tc1,tc2,phase 500
+//          subscribe all
+enum CommandType
+{
+    CMD_INVALID,
+    CMD_START,
+    CMD_CANCEL,
+    CMD_PROFILE,
+    CMD_SETPOINT,
+    CMD_GAINS,
+    CMD_SUBSCRIBE,
+    CMD_CALIBRATE,
+    CMD_COAST,
+    CMD_IDLE,
+};
+
+struct Command
+{
+    CommandType type;
+    double values[3];
+    char name[Profile::maxNameLength];
+    uint32_t columns;
+    int period_ms;
+};
+
+// Longest line accepted, newline
+// included
+const int commandMaxLength = 64;
+
+// Fills command from one line, without
+// its newline; false if the line isn't
+// a valid command
+bool parseCommand(const char *line, Command &command);
+
+const char *getCommandName(CommandType type);
+
+// A command passed from the CSV task to
+// loop(), and its result on the way
+// back; received_us is when the line
+// arrived
+struct CommandRequest
+{
+    uint32_t connId;
+    int64_t received_us;
+    Command command;
+};
+
+struct CommandReply
+{
+    uint32_t connId;
+    int64_t received_us;
+    CommandType type;
+    bool ok;
+};
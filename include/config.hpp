@@ -3,6 +3,23 @@
 #include <ArduinoJson.h>
 #include <LittleFS.h>
 
+#include "calibration.hpp"
+#include "energy.hpp"
+#include "gain_schedule.hpp"
+#include "heater.hpp"
+#include "idle.hpp"
+#include "ilc.hpp"
+#include "mpc.hpp"
+#include "plate_model.hpp"
+#include "profile.hpp"
+#include "supervisor.hpp"
+#include "system_id.hpp"
+#include "trajectory.hpp"
+#include "zone.hpp"
+
+// Values are copied out of the JSON
+// document while it is read, so no
+// document is kept on the heap
 class Config
 {
 public:
@@ -15,6 +32,83 @@ public:
     const char *getKey();
     const char *getMDNS();
 
+    bool getEstimatorEnabled();
+
+    // How far TC2 and the LMT85 lag the
+    // plate, as first order time
+    // constants (s)
+    double getTc2Lag();
+    double getLmt85Lag();
+
+    PlateModel getPlateModel();
+    SysIdConfig getSysIdConfig();
+
+    const char *getProfileName();
+    TrajectoryConfig getTrajectoryConfig();
+    ControllerMode getControllerMode();
+    MpcConfig getMpcConfig();
+    IlcConfig getIlcConfig();
+
+    // Empty unless configured; the fixed
+    // gains apply outside the schedule
+    GainSchedule getGainSchedule();
+
+    HeaterConfig getHeaterConfig();
+    EnergyConfig getEnergyConfig();
+    IdleConfig getIdleConfig();
+
+    CalibrationConfig getCalibrationConfig();
+
+    SupervisorLimits getSupervisorLimits();
+    bool getSupervisorSelfTest();
+
+    int getMemoryReportPeriod();
+
+    // Upper bound; the CSV server may
+    // allow fewer if memory is short
+    int getCsvMaxClients();
+
 private:
-    DynamicJsonDocument _doc;
+    void readPlateModel(JsonVariant m);
+    void readSysIdConfig(JsonVariant s);
+    void readTrajectoryConfig(JsonVariant t);
+    void readMpcConfig(JsonVariant m);
+    void readIlcConfig(JsonVariant l);
+    void readGainSchedule(JsonArray g);
+    void readHeaterConfig(JsonVariant h);
+    void readEnergyConfig(JsonVariant e);
+    void readIdleConfig(JsonVariant i);
+    void readCalibrationConfig(JsonVariant c);
+    void readSupervisorLimits(JsonVariant sv);
+    static void copyString(char *dest, size_t size, const char *src);
+
+    char _ssid[33];
+    char _key[65];
+    char _mdns[32];
+
+    bool _estimatorEnabled;
+    double _tc2Lag;
+    double _lmt85Lag;
+    PlateModel _plateModel;
+    SysIdConfig _sysIdConfig;
+
+    char _profileName[Profile::maxNameLength];
+    TrajectoryConfig _trajectoryConfig;
+    ControllerMode _controllerMode;
+    MpcConfig _mpcConfig;
+    IlcConfig _ilcConfig;
+    GainSchedule _gainSchedule;
+
+    HeaterConfig _heaterConfig;
+    EnergyConfig _energyConfig;
+    IdleConfig _idleConfig;
+
+    CalibrationConfig _calibrationConfig;
+
+    SupervisorLimits _supervisorLimits;
+    bool _supervisorSelfTest;
+
+    int _memoryReportPeriod;
+
+    int _csvMaxClients;
 };
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+
+#include "commands.hpp"
+#include "telemetry.hpp"
+
+struct Connection
+{
+    int fd;
+    // esp_timer_get_time() at connect
+    int64_t zero_us;
+
+    // Unique for the life of the list, so
+    // replies can find the client after
+    // removals have moved it
+    uint32_t id;
+
+    // Subscription: a column mask and a
+    // period (ms); 0 is every row
+    uint32_t columns;
+    int period_ms;
+    unsigned long nextSend_ms;
+
+    // Partial command line; -1 while
+    // skipping the rest of one too long
+    char line[commandMaxLength];
+    int lineLength;
+};
+
+// Live client connections, packed at the
+// front of a table allocated once in
+// begin(). Adding and removing are O(1)
+// and iterating touches only live
+// clients; removal moves the last
+// connection into the freed slot, so
+// order isn't kept.
+class ConnectionList
+{
+public:
+    ConnectionList();
+    ~ConnectionList();
+
+public:
+    bool begin(int maxConns);
+
+    int getMax() const;
+    int getCount() const;
+    bool isFull() const;
+
+    // Returns NULL when full. The new
+    // connection gets every column at the
+    // full rate.
+    Connection *add(int fd, int64_t zero_us);
+
+    // Forgets connection i; closing its
+    // socket is up to the caller
+    void remove(int i);
+
+    Connection &get(int i);
+
+    // Index of the connection with id, or
+    // -1 if it's gone
+    int find(uint32_t id) const;
+
+private:
+    Connection *_conns;
+    int _max;
+    int _count;
+    uint32_t _nextId;
+};
+
+inline ConnectionList::ConnectionList()
+    : _conns(NULL),
+      _max(0),
+      _count(0),
+      _nextId(0) {}
+
+inline ConnectionList::~ConnectionList()
+{
+    delete[] _conns;
+}
+
+inline bool ConnectionList::begin(int maxConns)
+{
+    delete[] _conns;
+    _conns = new (std::nothrow) Connection[maxConns];
+    _max = _conns != NULL ? maxConns : 0;
+    _count = 0;
+
+    return _conns != NULL;
+}
+
+inline int ConnectionList::getMax() const
+{
+    return _max;
+}
+
+inline int ConnectionList::getCount() const
+{
+    return _count;
+}
+
+inline bool ConnectionList::isFull() const
+{
+    return _count == _max;
+}
+
+inline Connection *ConnectionList::add(int fd, int64_t zero_us)
+{
+    if (isFull())
+    {
+        return NULL;
+    }
+
+    Connection &conn = _conns[_count++];
+    conn.fd = fd;
+    conn.zero_us = zero_us;
+    conn.id = _nextId++;
+    conn.columns = csvAllColumns;
+    conn.period_ms = 0;
+    conn.nextSend_ms = 0;
+    conn.lineLength = 0;
+
+    return &conn;
+}
+
+inline void ConnectionList::remove(int i)
+{
+    _conns[i] = _conns[--_count];
+}
+
+inline Connection &ConnectionList::get(int i)
+{
+    return _conns[i];
+}
+
+inline int ConnectionList::find(uint32_t id) const
+{
+    for (int i = 0; i < _count; i++)
+    {
+        if (_conns[i].id == id)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
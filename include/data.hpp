@@ -10,35 +10,72 @@ public:
 
     double getTc1Temp() const;
     double getTc2Temp() const;
-    int getLmt85_mV() const;
+    double getLmt85_mV() const;
+    double getLmt85Temp() const;
     double getSetpoint() const;
+    double getEstimateTemp() const;
+    double getEstimateRate() const;
 
-    void setTc1Temp(double temp);
-    void setTc2Temp(double temp);
-    void setLmt85_mV(int mv);
+    // Capture time (esp_timer_get_time())
+    // of the newest sample behind each
+    // value; 0 until the first sample
+    int64_t getTc1Timestamp() const;
+    int64_t getTc2Timestamp() const;
+    int64_t getLmt85Timestamp() const;
+
+    // Capture time of the sample behind
+    // the latest control output, and when
+    // that output reached the heater
+    void getControlTiming(int64_t &sample_us, int64_t &actuated_us) const;
+
+    void setTc1Temp(double temp, int64_t timestamp_us);
+    void setTc2Temp(double temp, int64_t timestamp_us);
+    void setLmt85(double mv, double temp, int64_t timestamp_us);
     void setSetpoint(double setpoint);
+    void setEstimate(double temp, double rate);
+    void setControlTiming(int64_t sample_us, int64_t actuated_us);
 
 private:
     double _tc1Temp;
     double _tc2Temp;
-    int _lmt85_mV;
+    double _lmt85_mV;
+    double _lmt85Temp;
+    int64_t _tc1Timestamp;
+    int64_t _tc2Timestamp;
+    int64_t _lmt85Timestamp;
     double _setpoint;
+    double _estimateTemp;
+    double _estimateRate;
+    int64_t _controlSample_us;
+    int64_t _controlActuated_us;
 
     SemaphoreHandle_t _tc1TempMutex;
     SemaphoreHandle_t _tc2TempMutex;
     SemaphoreHandle_t _lmt85Mutex;
     SemaphoreHandle_t _setpointMutex;
+    SemaphoreHandle_t _estimateMutex;
+    SemaphoreHandle_t _controlTimingMutex;
 };
 
 inline Data::Data()
     : _tc1Temp(0.0),
       _tc2Temp(0.0),
-      _lmt85_mV(0),
+      _lmt85_mV(0.0),
+      _lmt85Temp(0.0),
+      _tc1Timestamp(0),
+      _tc2Timestamp(0),
+      _lmt85Timestamp(0),
       _setpoint(0.0),
+      _estimateTemp(0.0),
+      _estimateRate(0.0),
+      _controlSample_us(0),
+      _controlActuated_us(0),
       _tc1TempMutex(NULL),
       _tc2TempMutex(NULL),
       _lmt85Mutex(NULL),
-      _setpointMutex(NULL)
+      _setpointMutex(NULL),
+      _estimateMutex(NULL),
+      _controlTimingMutex(NULL)
 {
     _tc1TempMutex = xSemaphoreCreateMutex();
     if (_tc1TempMutex == NULL)
@@ -76,6 +113,24 @@ inline Data::Data()
             delay(10);
         }
     }
+    _estimateMutex = xSemaphoreCreateMutex();
+    if (_estimateMutex == NULL)
+    {
+        Serial.println("Failed to create estimate mutex");
+        while (true)
+        {
+            delay(10);
+        }
+    }
+    _controlTimingMutex = xSemaphoreCreateMutex();
+    if (_controlTimingMutex == NULL)
+    {
+        Serial.println("Failed to create control timing mutex");
+        while (true)
+        {
+            delay(10);
+        }
+    }
 }
 
 inline Data::~Data()
@@ -84,6 +139,8 @@ inline Data::~Data()
     vSemaphoreDelete(_tc2TempMutex);
     vSemaphoreDelete(_lmt85Mutex);
     vSemaphoreDelete(_setpointMutex);
+    vSemaphoreDelete(_estimateMutex);
+    vSemaphoreDelete(_controlTimingMutex);
 }
 
 inline double Data::getTc1Temp() const
@@ -108,9 +165,9 @@ inline double Data::getTc2Temp() const
     return tmp;
 }
 
-inline int Data::getLmt85_mV() const
+inline double Data::getLmt85_mV() const
 {
-    int tmp = 0;
+    double tmp = 0.0;
 
     xSemaphoreTake(_lmt85Mutex, portMAX_DELAY);
     tmp = _lmt85_mV;
@@ -119,6 +176,50 @@ inline int Data::getLmt85_mV() const
     return tmp;
 }
 
+inline double Data::getLmt85Temp() const
+{
+    double tmp = 0.0;
+
+    xSemaphoreTake(_lmt85Mutex, portMAX_DELAY);
+    tmp = _lmt85Temp;
+    xSemaphoreGive(_lmt85Mutex);
+
+    return tmp;
+}
+
+inline int64_t Data::getTc1Timestamp() const
+{
+    int64_t tmp = 0;
+
+    xSemaphoreTake(_tc1TempMutex, portMAX_DELAY);
+    tmp = _tc1Timestamp;
+    xSemaphoreGive(_tc1TempMutex);
+
+    return tmp;
+}
+
+inline int64_t Data::getTc2Timestamp() const
+{
+    int64_t tmp = 0;
+
+    xSemaphoreTake(_tc2TempMutex, portMAX_DELAY);
+    tmp = _tc2Timestamp;
+    xSemaphoreGive(_tc2TempMutex);
+
+    return tmp;
+}
+
+inline int64_t Data::getLmt85Timestamp() const
+{
+    int64_t tmp = 0;
+
+    xSemaphoreTake(_lmt85Mutex, portMAX_DELAY);
+    tmp = _lmt85Timestamp;
+    xSemaphoreGive(_lmt85Mutex);
+
+    return tmp;
+}
+
 inline double Data::getSetpoint() const
 {
     double tmp = 0.0;
@@ -130,24 +231,58 @@ inline double Data::getSetpoint() const
     return tmp;
 }
 
-inline void Data::setTc1Temp(double temp)
+inline double Data::getEstimateTemp() const
+{
+    double tmp = 0.0;
+
+    xSemaphoreTake(_estimateMutex, portMAX_DELAY);
+    tmp = _estimateTemp;
+    xSemaphoreGive(_estimateMutex);
+
+    return tmp;
+}
+
+inline double Data::getEstimateRate() const
+{
+    double tmp = 0.0;
+
+    xSemaphoreTake(_estimateMutex, portMAX_DELAY);
+    tmp = _estimateRate;
+    xSemaphoreGive(_estimateMutex);
+
+    return tmp;
+}
+
+inline void Data::getControlTiming(int64_t &sample_us, int64_t &actuated_us) const
+{
+    xSemaphoreTake(_controlTimingMutex, portMAX_DELAY);
+    sample_us = _controlSample_us;
+    actuated_us = _controlActuated_us;
+    xSemaphoreGive(_controlTimingMutex);
+}
+
+inline void Data::setTc1Temp(double temp, int64_t timestamp_us)
 {
     xSemaphoreTake(_tc1TempMutex, portMAX_DELAY);
     _tc1Temp = temp;
+    _tc1Timestamp = timestamp_us;
     xSemaphoreGive(_tc1TempMutex);
 }
 
-inline void Data::setTc2Temp(double temp)
+inline void Data::setTc2Temp(double temp, int64_t timestamp_us)
 {
-    xSemaphoreTake(_tc1TempMutex, portMAX_DELAY);
+    xSemaphoreTake(_tc2TempMutex, portMAX_DELAY);
     _tc2Temp = temp;
-    xSemaphoreGive(_tc1TempMutex);
+    _tc2Timestamp = timestamp_us;
+    xSemaphoreGive(_tc2TempMutex);
 }
 
-inline void Data::setLmt85_mV(int mv)
+inline void Data::setLmt85(double mv, double temp, int64_t timestamp_us)
 {
     xSemaphoreTake(_lmt85Mutex, portMAX_DELAY);
     _lmt85_mV = mv;
+    _lmt85Temp = temp;
+    _lmt85Timestamp = timestamp_us;
     xSemaphoreGive(_lmt85Mutex);
 }
 
@@ -157,3 +292,19 @@ inline void Data::setSetpoint(double setpoint)
     _setpoint = setpoint;
     xSemaphoreGive(_setpointMutex);
 }
+
+inline void Data::setEstimate(double temp, double rate)
+{
+    xSemaphoreTake(_estimateMutex, portMAX_DELAY);
+    _estimateTemp = temp;
+    _estimateRate = rate;
+    xSemaphoreGive(_estimateMutex);
+}
+
+inline void Data::setControlTiming(int64_t sample_us, int64_t actuated_us)
+{
+    xSemaphoreTake(_controlTimingMutex, portMAX_DELAY);
+    _controlSample_us = sample_us;
+    _controlActuated_us = actuated_us;
+    xSemaphoreGive(_controlTimingMutex);
+}
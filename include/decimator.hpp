@@ -0,0 +1,170 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+// First-order CIC decimator (integrate
+// and dump): sums blocks of N raw ADC
+// samples and emits each block's mean
+// with its fractional counts kept.
+//
+// Averaging N samples gains
+// 0.5 log2(N) bits, but only if the
+// input noise dithers it across codes;
+// with under ~0.5 count rms, most
+// samples land on the same code and
+// the extra bits aren't real. The
+// spread of the raw samples within each
+// block is kept to check that, and the
+// noise left on the output is measured
+// from its second differences (a steady
+// ramp cancels out) to report the bits
+// actually gained.
+template <int N>
+class Decimator
+{
+public:
+    Decimator();
+
+public:
+    // True when sample completes a block
+    bool add(uint16_t sample);
+
+    // Mean of the last complete block
+    // (counts)
+    double getReading() const;
+
+    // RMS spread of the raw samples in
+    // the last complete block (counts)
+    double getNoise() const;
+
+    // RMS noise on the output since
+    // restartStats() (counts)
+    double getOutputNoise() const;
+
+    // log2(1 count / output rms) since
+    // restartStats(), capped at the
+    // nominal 0.5 log2(N); 0 when the raw
+    // noise is too small to dither
+    double getBitsGained() const;
+
+    void restartStats();
+
+    static double getNominalBitsGained();
+
+private:
+    // Raw rms below this leaves the
+    // output stuck near one code (counts)
+    static constexpr double minDither = 0.5;
+
+    uint32_t _sum;
+    uint64_t _sumSquares;
+    int _count;
+    double _reading;
+    double _noise;
+
+    double _previous[2];
+    int _blocks;
+    double _sumNoise;
+    double _sumCurvature;
+};
+
+template <int N>
+inline Decimator<N>::Decimator()
+    : _sum(0),
+      _sumSquares(0),
+      _count(0),
+      _reading(0.0),
+      _noise(0.0),
+      _previous{0.0, 0.0},
+      _blocks(0),
+      _sumNoise(0.0),
+      _sumCurvature(0.0) {}
+
+template <int N>
+inline bool Decimator<N>::add(uint16_t sample)
+{
+    _sum += sample;
+    _sumSquares += (uint32_t)sample * sample;
+    if (++_count < N)
+    {
+        return false;
+    }
+
+    // N^2 variance, exact in integers
+    uint64_t spread = (uint64_t)N * _sumSquares - (uint64_t)_sum * _sum;
+    _reading = (double)_sum / N;
+    _noise = sqrt((double)spread) / N;
+
+    // White noise of variance s^2 gives
+    // second differences of variance 6 s^2
+    if (_blocks >= 2)
+    {
+        double curvature = _reading - 2 * _previous[0] + _previous[1];
+        _sumCurvature += curvature * curvature;
+    }
+    _previous[1] = _previous[0];
+    _previous[0] = _reading;
+    _sumNoise += _noise;
+    _blocks++;
+
+    _sum = 0;
+    _sumSquares = 0;
+    _count = 0;
+
+    return true;
+}
+
+template <int N>
+inline double Decimator<N>::getReading() const
+{
+    return _reading;
+}
+
+template <int N>
+inline double Decimator<N>::getNoise() const
+{
+    return _noise;
+}
+
+template <int N>
+inline double Decimator<N>::getOutputNoise() const
+{
+    if (_blocks < 3)
+    {
+        return 0.0;
+    }
+
+    return sqrt(_sumCurvature / (6.0 * (_blocks - 2)));
+}
+
+template <int N>
+inline double Decimator<N>::getBitsGained() const
+{
+    if (_blocks < 3 || _sumNoise / _blocks < minDither)
+    {
+        return 0.0;
+    }
+
+    double outputNoise = getOutputNoise();
+    if (outputNoise <= 0.0)
+    {
+        return getNominalBitsGained();
+    }
+
+    return fmax(0.0, fmin(getNominalBitsGained(), -log2(outputNoise)));
+}
+
+template <int N>
+inline void Decimator<N>::restartStats()
+{
+    _blocks = 0;
+    _sumNoise = 0.0;
+    _sumCurvature = 0.0;
+}
+
+template <int N>
+inline double Decimator<N>::getNominalBitsGained()
+{
+    return 0.5 * log2((double)N);
+}
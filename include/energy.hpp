@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "profile.hpp"
+
+struct EnergyConfig
+{
+    // Heater supply (V) and the
+    // resistance of each zone's heater
+    // (ohm); full duty is V^2 / R watts
+    double supplyVoltage;
+    double heaterResistance;
+
+    // Coast mode: on a profile's trailing
+    // edges, where the setpoint's slope
+    // drops by at least coastSlopeDrop
+    // (C/s) within coastLookahead (s),
+    // PID output is capped at coastScale
+    // (above 0.0, up to 1.0) of full duty
+    // and the plate's stored heat carries
+    // it over the peak
+    bool coast;
+    double coastLookahead;
+    double coastSlopeDrop;
+    double coastScale;
+};
+
+// ~120 W; measure the heater for real
+// numbers
+const EnergyConfig defaultEnergyConfig = {13.5, 1.5, false, 5.0, 0.5, 0.3};
+
+bool isCoasting(const EnergyConfig &config, const Profile &profile, unsigned long curveTime);
+
+// Heater energy, integrated from duty.
+// Each duty holds until the next add(),
+// as it does at the heater.
+class EnergyMeter
+{
+public:
+    EnergyMeter();
+
+public:
+    void begin(const EnergyConfig &config);
+
+    // Starts and stops counting a run;
+    // the total since boot carries on
+    void reset();
+    void stop();
+
+    // Duty (0.0 - 1.0) from now on
+    void add(int64_t now_us, double duty);
+
+    // Joules this run (or the last), and
+    // since boot
+    double getEnergy() const;
+    double getTotal() const;
+
+private:
+    double _fullPower;
+    int64_t _last_us;
+    double _duty;
+    bool _running;
+    double _energy;
+    double _total;
+};
+
+inline bool isCoasting(const EnergyConfig &config, const Profile &profile, unsigned long curveTime)
+{
+    if (!config.coast)
+    {
+        return false;
+    }
+
+    unsigned long ahead = curveTime + (unsigned long)(config.coastLookahead * 1000.0);
+
+    return profile.slopeAt(curveTime) - profile.slopeAt(ahead) >= config.coastSlopeDrop;
+}
+
+inline EnergyMeter::EnergyMeter()
+    : _fullPower(0.0),
+      _last_us(0),
+      _duty(0.0),
+      _running(false),
+      _energy(0.0),
+      _total(0.0) {}
+
+inline void EnergyMeter::begin(const EnergyConfig &config)
+{
+    _fullPower = config.supplyVoltage * config.supplyVoltage / config.heaterResistance;
+}
+
+inline void EnergyMeter::reset()
+{
+    _energy = 0.0;
+    _running = true;
+}
+
+inline void EnergyMeter::stop()
+{
+    _running = false;
+}
+
+inline void EnergyMeter::add(int64_t now_us, double duty)
+{
+    if (_last_us != 0)
+    {
+        double energy = _duty * _fullPower * (now_us - _last_us) / 1e6;
+        _energy += _running ? energy : 0.0;
+        _total += energy;
+    }
+
+    _last_us = now_us;
+    _duty = duty;
+}
+
+inline double EnergyMeter::getEnergy() const
+{
+    return _energy;
+}
+
+inline double EnergyMeter::getTotal() const
+{
+    return _total;
+}
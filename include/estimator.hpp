@@ -0,0 +1,108 @@
+#pragma once
+
+#include "plate_model.hpp"
+
+// Kalman filter fusing TC1, TC2 and the
+// LMT85 into a single plate temperature
+// estimate. State is the plate
+// temperature, an unmodeled heat input
+// (in C of steady state rise) that
+// absorbs model error, and one node for
+// each of TC2 and the LMT85. Those sit
+// on boards that follow the plate
+// through a first order lag, so they are
+// compared with the lagged plate rather
+// than the plate itself and don't pull
+// the estimate low on a ramp. The heater
+// duty is the known input.
+class Estimator
+{
+public:
+    Estimator();
+
+public:
+    void begin(const PlateModel &model, double dt, double initialTemp);
+    void setNoise(double tc1Var, double tc2Var, double lmt85Var, double tempVar, double biasVar);
+
+    // Time constants (s) TC2 and the
+    // LMT85 lag the plate by; 0 treats
+    // the sensor as on the plate. Takes
+    // effect at the next begin().
+    void setLags(double tc2Lag, double lmt85Lag);
+
+    // Runs one predict step with the duty
+    // applied over the last period, then
+    // corrects with each sensor reading.
+    // NaN readings are skipped.
+    void update(double duty, double tc1, double tc2, double lmt85);
+
+    double getTemp() const;
+    double getRate() const;
+
+    // Ratio of the standard deviation of
+    // tick-to-tick TC1 changes to that of
+    // the estimate; higher is quieter
+    double getNoiseReduction() const;
+    void resetNoiseStats();
+
+private:
+    enum
+    {
+        TEMP,
+        BIAS,
+        TC2_NODE,
+        LMT85_NODE,
+        STATES
+    };
+
+    void correct(int state, double measurement, double variance);
+
+    static const int maxDelaySteps = 64;
+
+    PlateModel _model;
+    float _a;
+    float _b;
+
+    // Per step decay of each lagged node;
+    // 0 follows the plate at once
+    float _lagDecay[STATES];
+    double _tc2Lag;
+    double _lmt85Lag;
+
+    // Heater duty history for dead time
+    float _dutyHistory[maxDelaySteps];
+    int _delaySteps;
+    int _dutyIdx;
+    float _delayedDuty;
+
+    // State and covariance
+    float _x[STATES];
+    float _p[STATES][STATES];
+
+    // Noise variances
+    float _tc1Var;
+    float _tc2Var;
+    float _lmt85Var;
+    float _tempVar;
+    float _biasVar;
+
+    // Running variance (Welford) of
+    // TC1 and estimate first differences
+    double _lastRaw;
+    double _lastEst;
+    long _noiseCount;
+    double _rawMean;
+    double _rawM2;
+    double _estMean;
+    double _estM2;
+};
+
+inline double Estimator::getTemp() const
+{
+    return _x[TEMP];
+}
+
+inline double Estimator::getRate() const
+{
+    return (_model.ambient + _model.gain * _delayedDuty + _x[BIAS] - _x[TEMP]) / _model.tau;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <PID_v1.h>
+
+// Profile phase, from the slope of the
+// profile segment being followed
+enum ProfilePhase
+{
+    PHASE_ANY,
+    PHASE_RISING,
+    PHASE_HOLDING,
+    PHASE_FALLING,
+};
+
+struct PidGains
+{
+    double kp;
+    double ki;
+    double kd;
+};
+
+// Gains for setpoints up to upTo (C) in
+// the given phase
+struct GainScheduleEntry
+{
+    double upTo;
+    ProfilePhase phase;
+    PidGains gains;
+};
+
+// PID gains keyed by setpoint and profile
+// phase. Entries are checked in order and
+// the first match wins, so list them by
+// increasing upTo, phase specific ones
+// before PHASE_ANY.
+class GainSchedule
+{
+public:
+    static const int maxEntries = 8;
+
+    // Segments within this slope (C/s) of
+    // flat count as holding
+    static constexpr double holdingSlope = 0.1;
+
+    GainSchedule();
+
+public:
+    void clear();
+    bool add(const GainScheduleEntry &entry);
+    int getNumEntries() const;
+    const GainScheduleEntry &getEntry(int i) const;
+
+    // Index of the entry for setpoint and
+    // slope, or -1 if none matches
+    int select(double setpoint, double slope) const;
+
+    static ProfilePhase phaseOf(double slope);
+    static const char *getPhaseName(ProfilePhase phase);
+
+private:
+    GainScheduleEntry _entries[maxEntries];
+    int _numEntries;
+};
+
+// Switches pid to gains without a step in
+// output: the integral term is reset so
+// the proportional change is absorbed.
+// output, input and setpoint are the
+// variables pid was built with. Only as
+// bumpless as the output limits allow.
+void switchGains(PID &pid, double &output, double input, double setpoint, const PidGains &gains);
+
+inline GainSchedule::GainSchedule()
+    : _numEntries(0) {}
+
+inline void GainSchedule::clear()
+{
+    _numEntries = 0;
+}
+
+inline int GainSchedule::getNumEntries() const
+{
+    return _numEntries;
+}
+
+inline const GainScheduleEntry &GainSchedule::getEntry(int i) const
+{
+    return _entries[i];
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <Arduino.h>
+#include <driver/ledc.h>
+
+// How duty is turned into FET gate
+// drive
+enum HeaterMode
+{
+    // LEDC hardware PWM
+    HEATER_PWM,
+    // Time proportioning: on for duty x
+    // window, off for the rest
+    HEATER_BURST,
+    // First order sigma-delta (pulse
+    // density) modulation at the tick rate
+    HEATER_SIGMA_DELTA,
+};
+
+struct HeaterConfig
+{
+    HeaterMode mode;
+
+    // PWM frequency (Hz) and resolution
+    // (bits)
+    int freq;
+    int resolution;
+
+    // Burst window (ms)
+    int window_ms;
+
+    // Time slice for burst and
+    // sigma-delta modes (ms)
+    int tick_ms;
+};
+
+const HeaterConfig defaultHeaterConfig = {HEATER_PWM, 15, 12, 2000, 10};
+
+// Drives one heater FET. All outputs
+// share a mode: PWM outputs share one
+// LEDC timer and burst/sigma-delta
+// outputs share one esp_timer tick, so
+// phase offsets stay fixed between
+// heaters.
+class HeaterOutput
+{
+public:
+    static const int maxOutputs = 8;
+
+    HeaterOutput();
+
+public:
+    static bool beginShared(const HeaterConfig &config);
+    static const HeaterConfig &getConfig();
+    static const char *getModeName();
+
+    // Distinct duty levels the current
+    // mode can produce within one control
+    // period of period_ms. Sigma-delta has
+    // finer duty over longer spans, but a
+    // period only holds period_ms /
+    // tick_ms pulses.
+    static long getDutyLevels(int period_ms);
+
+    // Longest a new duty can wait before
+    // the FET follows it: LEDC latches at
+    // the next PWM period, burst and
+    // sigma-delta at the next tick
+    static int64_t getApplyDelay_us();
+
+    // Stops the burst and sigma-delta tick
+    // while every output is at 0, so it
+    // doesn't wake the CPU; a duty above 0
+    // restarts it
+    static void setIdle(bool idle);
+
+    // While inhibited every output is
+    // held off, whatever duty is set
+    static void setInhibit(bool inhibit);
+    static bool isInhibited();
+
+    // phase is a fraction (0.0 - 1.0)
+    // of the period or window
+    bool begin(int pin, int channel, double phase);
+    void setDuty(double duty);
+    double getDuty() const;
+
+    // esp_timer_get_time() when the last
+    // setDuty() handed the duty to the
+    // output; the FET follows within
+    // getApplyDelay_us()
+    int64_t getLastWrite_us() const;
+
+    // Turns the FET off now; safe to
+    // call from another task
+    void forceOff();
+
+private:
+    static void onTick(void *);
+    void tick(uint32_t tickCount);
+    void writePin(bool on);
+
+    static HeaterConfig _config;
+    static volatile bool _inhibit;
+    static HeaterOutput *_outputs[maxOutputs];
+    static int _numOutputs;
+    static esp_timer_handle_t _timer;
+    static bool _timerStopped;
+    static uint32_t _tickCount;
+
+    int _pin;
+    int _channel;
+    uint32_t _phase;
+    double _duty;
+    int64_t _lastWrite_us;
+    bool _pinOn;
+
+    // Burst: on ticks per window;
+    // sigma-delta: duty in 1/65536
+    volatile uint32_t _level;
+    uint32_t _accumulator;
+};
+
+inline const HeaterConfig &HeaterOutput::getConfig()
+{
+    return _config;
+}
+
+inline void HeaterOutput::setInhibit(bool inhibit)
+{
+    _inhibit = inhibit;
+}
+
+inline bool HeaterOutput::isInhibited()
+{
+    return _inhibit;
+}
+
+inline double HeaterOutput::getDuty() const
+{
+    return _duty;
+}
+
+inline int64_t HeaterOutput::getLastWrite_us() const
+{
+    return _lastWrite_us;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Sensors that must report at full rate
+// again before a wake counts as done
+enum IdleChannel
+{
+    IDLE_CHANNEL_TC,
+    IDLE_CHANNEL_LMT85,
+    IDLE_CHANNEL_COUNT
+};
+
+// Slower acquisition while nothing is
+// running: no run, characterization or
+// calibration, setpoint 0 and heaters
+// off
+struct IdleConfig
+{
+    bool enabled;
+
+    // Let the chip light-sleep between
+    // samples; needs a build with
+    // tickless idle
+    bool lightSleep;
+
+    // Thermocouple and LMT85 burst
+    // periods, display refresh and
+    // control tick (ms). Sensor data must
+    // stay fresher than the supervisor's
+    // maxSampleAge.
+    int tcPeriod_ms;
+    int lmt85Period_ms;
+    int displayPeriod_ms;
+    int loopPeriod_ms;
+};
+
+const IdleConfig defaultIdleConfig = {true, true, 200, 40, 2000, 500};
+
+// Idle state shared by the control loop,
+// which enters and leaves it, and the
+// reader tasks, which pick their period
+// from it and report their first sample
+// after a wake
+class IdleTracker
+{
+public:
+    IdleTracker();
+
+public:
+    void enter(int64_t now_us);
+    void exit(int64_t now_us);
+    bool isIdle() const;
+
+    // Reader tasks call this with each
+    // sample's capture time
+    void sampled(IdleChannel channel, int64_t timestamp_us);
+
+    // Time from the last exit() until
+    // every channel had sampled again;
+    // true once per wake, when known
+    bool takeWakeLatency(int32_t &latency_us);
+    int32_t getWakeLatency_us() const;
+
+    // Time spent idle since boot,
+    // including now
+    int64_t getIdleTime_us(int64_t now_us) const;
+
+private:
+    std::atomic<bool> _idle;
+    int64_t _since_us;
+    int64_t _idleTotal_us;
+
+    // Bit per channel yet to sample since
+    // the wake that started at _wake_us
+    std::atomic<uint32_t> _waking;
+    int64_t _wake_us;
+    std::atomic<int32_t> _wakeLatency_us;
+    std::atomic<bool> _wakeReported;
+};
+
+inline IdleTracker::IdleTracker()
+    : _idle(false),
+      _since_us(0),
+      _idleTotal_us(0),
+      _waking(0),
+      _wake_us(0),
+      _wakeLatency_us(0),
+      _wakeReported(true) {}
+
+inline void IdleTracker::enter(int64_t now_us)
+{
+    _since_us = now_us;
+    _waking.store(0, std::memory_order_relaxed);
+    _idle.store(true, std::memory_order_release);
+}
+
+inline void IdleTracker::exit(int64_t now_us)
+{
+    _idleTotal_us += now_us - _since_us;
+    _wake_us = now_us;
+    _wakeReported.store(false, std::memory_order_relaxed);
+    _waking.store((1u << IDLE_CHANNEL_COUNT) - 1, std::memory_order_release);
+    _idle.store(false, std::memory_order_release);
+}
+
+inline bool IdleTracker::isIdle() const
+{
+    return _idle.load(std::memory_order_acquire);
+}
+
+inline void IdleTracker::sampled(IdleChannel channel, int64_t timestamp_us)
+{
+    uint32_t bit = 1u << channel;
+    if (!(_waking.load(std::memory_order_acquire) & bit) || timestamp_us < _wake_us)
+    {
+        return;
+    }
+
+    // The last channel back records the
+    // latency
+    if (_waking.fetch_and(~bit, std::memory_order_acq_rel) == bit)
+    {
+        _wakeLatency_us.store((int32_t)(timestamp_us - _wake_us), std::memory_order_release);
+    }
+}
+
+inline bool IdleTracker::takeWakeLatency(int32_t &latency_us)
+{
+    if (_waking.load(std::memory_order_acquire) != 0 || _wakeReported.load(std::memory_order_relaxed))
+    {
+        return false;
+    }
+
+    _wakeReported.store(true, std::memory_order_relaxed);
+    latency_us = _wakeLatency_us.load(std::memory_order_acquire);
+    return true;
+}
+
+inline int32_t IdleTracker::getWakeLatency_us() const
+{
+    return _wakeLatency_us.load(std::memory_order_acquire);
+}
+
+inline int64_t IdleTracker::getIdleTime_us(int64_t now_us) const
+{
+    return _idleTotal_us + (isIdle() ? now_us - _since_us : 0);
+}
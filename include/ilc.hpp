@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdint.h>
+
+struct IlcConfig
+{
+    bool enabled;
+
+    // Fraction of a run's tracking error
+    // added to the next run's correction
+    double gain;
+
+    // Plate lag (s): the correction at t
+    // is learned from the error at
+    // t + lead
+    double lead;
+
+    // Limit on the setpoint correction
+    // (C, either way)
+    double maxCorrection;
+};
+
+const IlcConfig defaultIlcConfig = {false, 0.5, 3.0, 20.0};
+
+// Iterative learning control: a setpoint
+// correction against one profile's time
+// base, learned from the tracking error
+// of each completed run and kept on
+// LittleFS per profile and zone. Looking
+// up the correction and recording error
+// are O(1) per tick; learning runs once
+// at the end of a run.
+class Ilc
+{
+public:
+    // 1s bins cover a 10 minute profile
+    static const int binMs = 1000;
+    static const int maxBins = 600;
+
+    Ilc();
+
+public:
+    void begin(const IlcConfig &config);
+    bool isEnabled() const;
+
+    // Loads the correction for a profile
+    // and zone, or starts from zero if
+    // there's none or it doesn't match
+    // the profile's duration. Also starts
+    // a new run.
+    void load(const char *profileName, const char *zoneName, unsigned long duration);
+    bool save();
+
+    double correctionAt(unsigned long curveTime) const;
+
+    // error is target minus measured
+    void addError(unsigned long curveTime, double error);
+
+    // Updates the correction from the
+    // run's error; call only for runs
+    // that completed
+    void learn();
+
+    int getRuns() const;
+    double getRmsError() const;
+    double getPrevRmsError() const;
+
+private:
+    IlcConfig _config;
+    char _path[64];
+    int _numBins;
+
+    // Learned runs and the RMS error of
+    // the run before this one, both saved
+    // with the correction
+    int32_t _runs;
+    float _prevRmsError;
+
+    float _correction[maxBins];
+
+    // This run's error per bin
+    float _errorSum[maxBins];
+    uint16_t _errorCount[maxBins];
+    double _sumSqError;
+    long _ticks;
+};
+
+inline bool Ilc::isEnabled() const
+{
+    return _config.enabled;
+}
+
+inline double Ilc::correctionAt(unsigned long curveTime) const
+{
+    int bin = curveTime / binMs;
+    return bin < _numBins ? _correction[bin] : 0.0;
+}
+
+inline void Ilc::addError(unsigned long curveTime, double error)
+{
+    int bin = curveTime / binMs;
+    if (bin < _numBins)
+    {
+        _errorSum[bin] += error;
+        _errorCount[bin]++;
+    }
+    _sumSqError += error * error;
+    _ticks++;
+}
+
+inline int Ilc::getRuns() const
+{
+    return _runs;
+}
+
+inline double Ilc::getPrevRmsError() const
+{
+    return _prevRmsError;
+}
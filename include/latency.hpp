@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdint.h>
+
+// esp_timer_get_time() stamps taken as a
+// sample moves through one control tick
+struct TickTiming
+{
+    // Sensor read by its task
+    int64_t capture_us;
+    // Picked up by loop()
+    int64_t read_us;
+    // Estimator done (== read_us when
+    // disabled)
+    int64_t filtered_us;
+    // Controller output ready
+    int64_t computed_us;
+    // Duty written to the heater output
+    int64_t actuated_us;
+};
+
+enum LatencyStage
+{
+    // capture -> read
+    LATENCY_SAMPLE_AGE,
+    // read -> filtered
+    LATENCY_FILTER,
+    // filtered -> computed
+    LATENCY_COMPUTE,
+    // computed -> actuated
+    LATENCY_WRITE,
+    LATENCY_STAGE_COUNT
+};
+
+// Per stage and end to end (capture to
+// actuation) latency over a run
+struct LatencyStats
+{
+    long ticks;
+    long long total_us[LATENCY_STAGE_COUNT];
+    long max_us[LATENCY_STAGE_COUNT];
+    long long totalEndToEnd_us;
+    long maxEndToEnd_us;
+
+    void reset();
+    void add(const TickTiming &timing);
+    double getAvg_us(LatencyStage stage) const;
+    double getAvgEndToEnd_us() const;
+};
+
+inline void LatencyStats::reset()
+{
+    ticks = 0;
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++)
+    {
+        total_us[i] = 0;
+        max_us[i] = 0;
+    }
+    totalEndToEnd_us = 0;
+    maxEndToEnd_us = 0;
+}
+
+inline void LatencyStats::add(const TickTiming &timing)
+{
+    const int64_t stamps[] = {timing.capture_us,
+                              timing.read_us,
+                              timing.filtered_us,
+                              timing.computed_us,
+                              timing.actuated_us};
+
+    ticks++;
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++)
+    {
+        long us = stamps[i + 1] - stamps[i];
+        total_us[i] += us;
+        if (us > max_us[i])
+        {
+            max_us[i] = us;
+        }
+    }
+
+    long endToEnd = timing.actuated_us - timing.capture_us;
+    totalEndToEnd_us += endToEnd;
+    if (endToEnd > maxEndToEnd_us)
+    {
+        maxEndToEnd_us = endToEnd;
+    }
+}
+
+inline double LatencyStats::getAvg_us(LatencyStage stage) const
+{
+    return ticks > 0 ? (double)total_us[stage] / ticks : 0.0;
+}
+
+inline double LatencyStats::getAvgEndToEnd_us() const
+{
+    return ticks > 0 ? (double)totalEndToEnd_us / ticks : 0.0;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// Converts LMT85 output voltage (mV) to
+// temperature (C) using the datasheet
+// lookup table (LMT85_LookUpTable.csv)
+double getLMT85Temp(double lmt85_mV);
+
+// Output at the top of the table
+// (150 C); hotter readings are pinned
+// there
+const double lmt85Min_mV = 301.0;
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+class SPIClass;
+
+// Fault bits of a MAX31855 frame
+enum Max31855Fault
+{
+    TC_FAULT_OPEN = 0x01,
+    TC_FAULT_SHORT_GND = 0x02,
+    TC_FAULT_SHORT_VCC = 0x04,
+};
+
+// One MAX31855 reading, decoded from a
+// single 32 bit frame:
+//
+//   31..18  thermocouple, 0.25 C, signed
+//   16      any fault
+//   15..4   cold junction, 0.0625 C,
+//           signed
+//   2..0    SCV, SCG, OC faults
+//
+// Bits 17 and 3 always read 0.
+struct Max31855Sample
+{
+    // NaN on a fault
+    double temp_c;
+    double coldJunction_c;
+    uint8_t faults;
+};
+
+// False if the reserved bits are set,
+// i.e. the chip isn't driving the bus
+bool isMax31855FrameValid(uint32_t frame);
+
+Max31855Sample decodeMax31855Frame(uint32_t frame);
+
+// The thermocouple amplifiers on one
+// hardware SPI bus. A read takes every
+// chip's full frame, back to back in one
+// bus transaction, so temperature, cold
+// junction and faults all come from the
+// same conversion.
+class Max31855Bus
+{
+public:
+    static const int maxChips = 2;
+
+    // The MAX31855 clocks out at up to
+    // 5 MHz
+    static const uint32_t clock_Hz = 4000000;
+
+    Max31855Bus(SPIClass &spi, int sckPin, int misoPin);
+
+public:
+    // Returns the chip's index
+    int addChip(int csPin);
+
+    // Starts the bus; false if any chip
+    // returns an invalid frame
+    bool begin();
+
+    // Fills frames[] with one frame per
+    // chip, in the order added
+    void read(uint32_t *frames);
+
+    int getNumChips() const;
+
+private:
+    SPIClass &_spi;
+    int _sckPin;
+    int _misoPin;
+    int _csPins[maxChips];
+    int _numChips;
+};
+
+inline bool isMax31855FrameValid(uint32_t frame)
+{
+    return (frame & 0x00020008) == 0;
+}
+
+inline Max31855Sample decodeMax31855Frame(uint32_t frame)
+{
+    Max31855Sample sample;
+
+    // Arithmetic shifts sign extend both
+    // fields
+    int32_t tc = (int32_t)frame >> 18;
+    int32_t cj = (int32_t)(frame << 16) >> 20;
+
+    sample.faults = frame & 0x07;
+    sample.coldJunction_c = cj * 0.0625;
+    sample.temp_c = (frame & 0x00010000) ? NAN : tc * 0.25;
+
+    return sample;
+}
+
+inline int Max31855Bus::getNumChips() const
+{
+    return _numChips;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+enum Counter
+{
+    COUNTER_TC1_SAMPLES,
+    COUNTER_TC2_SAMPLES,
+    COUNTER_LMT85_SAMPLES,
+    COUNTER_TC1_FAULT_OPEN,
+    COUNTER_TC1_FAULT_SHORT_GND,
+    COUNTER_TC1_FAULT_SHORT_VCC,
+    COUNTER_TC2_FAULT_OPEN,
+    COUNTER_TC2_FAULT_SHORT_GND,
+    COUNTER_TC2_FAULT_SHORT_VCC,
+    COUNTER_I2C_FAILURES,
+    COUNTER_DISPLAY_REFRESHES,
+    COUNTER_TELEMETRY_BYTES,
+    COUNTER_TELEMETRY_CONNECTS,
+    COUNTER_TELEMETRY_DROPS,
+    COUNTER_TELEMETRY_COMMANDS,
+    COUNTER_RUNS_COMPLETED,
+    COUNTER_RUNS_CANCELLED,
+    COUNTER_RUNS_FAULTED,
+    COUNTER_SUPERVISOR_FAULTS,
+    COUNTER_COUNT
+};
+
+// Event counters. Each core increments
+// its own copy of every counter with a
+// relaxed atomic add, so a hot path pays
+// a few cycles and never waits on the
+// other core; reads sum the copies.
+// Counters are 32 bits and wrap, which
+// scrapers treat as a reset.
+class Metrics
+{
+public:
+    static const int numCores = 2;
+
+    Metrics();
+
+public:
+    void add(Counter counter, uint32_t n = 1);
+    uint32_t get(Counter counter) const;
+
+private:
+    std::atomic<uint32_t> _counts[numCores][COUNTER_COUNT];
+};
+
+// Writes OpenMetrics text exposition
+// into a fixed buffer. Room for the
+// closing "# EOF" is kept back, and a
+// family that doesn't fit is dropped
+// whole along with everything after
+// it, so the text stays valid.
+class MetricsWriter
+{
+public:
+    MetricsWriter(char *buf, size_t size);
+
+public:
+    // Starts a metric family; type is
+    // "counter" or "gauge"
+    void family(const char *name, const char *type, const char *help);
+
+    // One sample of the current family;
+    // labels are written as given, e.g.
+    // "channel=\"tc1\"", or NULL
+    void counter(const char *labels, uint32_t value);
+    void gauge(const char *labels, double value);
+
+    // One state of a "stateset" family
+    void state(const char *name, bool active);
+
+    // Every counter in metrics, grouped
+    // into families
+    void counters(const Metrics &metrics);
+
+    // Terminates the exposition and
+    // returns its length
+    int end();
+
+    bool isTruncated() const;
+
+private:
+    void sampleName(const char *suffix, const char *labels);
+    void append(const char *format, ...);
+
+    char *_buf;
+    size_t _size;
+    size_t _len;
+    bool _truncated;
+    const char *_family;
+
+    // Where the current family began
+    size_t _familyStart;
+};
+
+inline Metrics::Metrics()
+{
+    for (int c = 0; c < numCores; c++)
+    {
+        for (int i = 0; i < COUNTER_COUNT; i++)
+        {
+            _counts[c][i].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+inline void Metrics::add(Counter counter, uint32_t n)
+{
+    _counts[xPortGetCoreID()][counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+inline uint32_t Metrics::get(Counter counter) const
+{
+    uint32_t sum = 0;
+    for (int c = 0; c < numCores; c++)
+    {
+        sum += _counts[c][counter].load(std::memory_order_relaxed);
+    }
+
+    return sum;
+}
+
+inline bool MetricsWriter::isTruncated() const
+{
+    return _truncated;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "plate_model.hpp"
+
+// Identified plate model, kept on
+// LittleFS as JSON:
+// {"gain": 300.0, "tau": 120.0,
+//  "deadTime": 3.0, "ambient": 25.0,
+//  "rmsError": 0.5}
+const char *const identifiedModelPath = "/model.json";
+
+bool loadPlateModel(const char *path, PlateModel &model);
+bool savePlateModel(const char *path, const PlateModel &model, double rmsError);
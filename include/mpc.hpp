@@ -0,0 +1,62 @@
+#pragma once
+
+#include "plate_model.hpp"
+#include "trajectory.hpp"
+
+struct MpcConfig
+{
+    // Number of prediction steps and
+    // their length (s)
+    int horizon;
+    double step;
+
+    // Number of blocks the heater duty
+    // is held constant over
+    int blocks;
+
+    // Penalty on duty changes between
+    // blocks, relative to squared
+    // tracking error (C^2)
+    double moveWeight;
+};
+
+const MpcConfig defaultMpcConfig = {30, 1.0, 3, 500.0};
+
+// Unconstrained linear MPC on the plate
+// model with move blocking. Everything
+// that depends only on the model and
+// the horizon is solved in begin(), so
+// compute() is a pair of O(horizon)
+// passes: the free response and a dot
+// product with the precomputed gain.
+class Mpc
+{
+public:
+    static const int maxHorizon = 60;
+    static const int maxBlocks = 8;
+
+    Mpc();
+
+public:
+    bool begin(const PlateModel &model, const MpcConfig &config);
+    void reset(double duty);
+
+    // Returns heater duty (0.0 - 1.0)
+    // for a plate at temp, curveTime ms
+    // into the compiled profile, with the
+    // zone's profile offset applied
+    double compute(double temp, const Trajectory &trajectory, unsigned long curveTime, double offset);
+
+private:
+    PlateModel _model;
+    MpcConfig _config;
+
+    float _a;
+    float _heaterGain;
+    float _ambientGain;
+    int _delaySteps;
+
+    float _gain[maxHorizon];
+    float _prevGain;
+    double _lastDuty;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+// First-order-plus-dead-time thermal
+// model of the plate:
+//
+//   tau * dT/dt = gain * u(t - deadTime) - (T - ambient)
+//
+// where u is heater duty (0.0 - 1.0)
+struct PlateModel
+{
+    // Steady state rise above ambient
+    // at full duty (C)
+    double gain;
+
+    // Time constant (s)
+    double tau;
+
+    // Heater to sensor dead time (s)
+    double deadTime;
+
+    // Ambient temperature (C)
+    double ambient;
+};
+
+// Rough numbers for the 50x70mm plate
+// on ~13.5V; used until a config file
+// or identified model overrides them
+const PlateModel defaultPlateModel = {300.0, 120.0, 3.0, 25.0};
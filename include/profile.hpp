@@ -0,0 +1,138 @@
+#pragma once
+
+#include <string.h>
+
+struct ReflowCurvePoint
+{
+    int time_ms;
+    int temp_c;
+};
+
+// A reflow curve: piecewise linear
+// setpoint over time, held in fixed
+// storage so profiles can be swapped
+// without touching the heap
+class Profile
+{
+public:
+    static const int maxPoints = 32;
+    static const int maxNameLength = 32;
+
+    Profile();
+    Profile(const char *name, const ReflowCurvePoint *points);
+
+public:
+    // Points are terminated by a
+    // time_ms of -1 and their times must
+    // increase; the profile is unchanged
+    // if they don't
+    bool set(const char *name, const ReflowCurvePoint *points);
+
+    const char *getName() const;
+    int getNumPoints() const;
+    const ReflowCurvePoint &getPoint(int i) const;
+    unsigned long getDuration() const;
+
+    // Setpoint at curveTime ms into the
+    // curve; 0.0 once the curve is over
+    double setpointAt(unsigned long curveTime) const;
+
+    // Slope (C/s) of the segment at
+    // curveTime; 0.0 once the curve is
+    // over
+    double slopeAt(unsigned long curveTime) const;
+
+private:
+    char _name[maxNameLength];
+    ReflowCurvePoint _points[maxPoints];
+    int _numPoints;
+};
+
+inline Profile::Profile()
+    : _numPoints(0)
+{
+    _name[0] = '\0';
+}
+
+inline Profile::Profile(const char *name, const ReflowCurvePoint *points)
+    : _numPoints(0)
+{
+    set(name, points);
+}
+
+inline bool Profile::set(const char *name, const ReflowCurvePoint *points)
+{
+    // Validate before changing anything;
+    // setpointAt() divides by each
+    // segment's length
+    int numPoints = 0;
+    while (points[numPoints].time_ms != -1)
+    {
+        if (numPoints == maxPoints || points[numPoints].time_ms < 0 ||
+            (numPoints > 0 && points[numPoints].time_ms <= points[numPoints - 1].time_ms))
+        {
+            return false;
+        }
+        numPoints++;
+    }
+
+    strncpy(_name, name, maxNameLength - 1);
+    _name[maxNameLength - 1] = '\0';
+    for (int i = 0; i < numPoints; i++)
+    {
+        _points[i] = points[i];
+    }
+    _numPoints = numPoints;
+
+    return true;
+}
+
+inline const char *Profile::getName() const
+{
+    return _name;
+}
+
+inline int Profile::getNumPoints() const
+{
+    return _numPoints;
+}
+
+inline const ReflowCurvePoint &Profile::getPoint(int i) const
+{
+    return _points[i];
+}
+
+inline unsigned long Profile::getDuration() const
+{
+    return _numPoints > 0 ? _points[_numPoints - 1].time_ms : 0;
+}
+
+inline double Profile::setpointAt(unsigned long curveTime) const
+{
+    for (int i = 1; i < _numPoints; i++)
+    {
+        if (curveTime < (unsigned long)_points[i].time_ms)
+        {
+            double timePct = (double)(curveTime - _points[i - 1].time_ms) /
+                             (double)(_points[i].time_ms - _points[i - 1].time_ms);
+            return _points[i - 1].temp_c +
+                   ((_points[i].temp_c - _points[i - 1].temp_c) * timePct);
+        }
+    }
+
+    return 0.0;
+}
+
+inline double Profile::slopeAt(unsigned long curveTime) const
+{
+    for (int i = 1; i < _numPoints; i++)
+    {
+        if (curveTime < (unsigned long)_points[i].time_ms)
+        {
+            return (_points[i].temp_c - _points[i - 1].temp_c) * 1000.0 /
+                   (_points[i].time_ms - _points[i - 1].time_ms);
+        }
+    }
+
+    return 0.0;
+}
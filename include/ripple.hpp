@@ -0,0 +1,106 @@
+#pragma once
+
+#include <math.h>
+
+// Temperature ripple as seen by the
+// controller: each sample's residual
+// against a trailing moving average.
+// The spread (not the mean) of the
+// residual is reported, so a steady
+// ramp doesn't count as ripple.
+class RippleMeter
+{
+public:
+    static const int windowSize = 10;
+
+    RippleMeter();
+
+public:
+    void add(double temp);
+    void reset();
+
+    long getCount() const;
+    double getStdDev() const;
+    double getPeakToPeak() const;
+
+private:
+    double _window[windowSize];
+    int _idx;
+    int _filled;
+    double _windowSum;
+
+    long _count;
+    double _sum;
+    double _sumSq;
+    double _min;
+    double _max;
+};
+
+inline RippleMeter::RippleMeter()
+{
+    reset();
+}
+
+inline void RippleMeter::reset()
+{
+    _idx = 0;
+    _filled = 0;
+    _windowSum = 0.0;
+    _count = 0;
+    _sum = 0.0;
+    _sumSq = 0.0;
+    _min = 0.0;
+    _max = 0.0;
+}
+
+inline void RippleMeter::add(double temp)
+{
+    if (_filled == windowSize)
+    {
+        double residual = temp - _windowSum / windowSize;
+
+        if (_count == 0 || residual < _min)
+        {
+            _min = residual;
+        }
+        if (_count == 0 || residual > _max)
+        {
+            _max = residual;
+        }
+        _count++;
+        _sum += residual;
+        _sumSq += residual * residual;
+
+        _windowSum -= _window[_idx];
+    }
+    else
+    {
+        _filled++;
+    }
+
+    _window[_idx] = temp;
+    _windowSum += temp;
+    _idx = (_idx + 1) % windowSize;
+}
+
+inline long RippleMeter::getCount() const
+{
+    return _count;
+}
+
+inline double RippleMeter::getStdDev() const
+{
+    if (_count < 2)
+    {
+        return 0.0;
+    }
+
+    double mean = _sum / _count;
+    double variance = _sumSq / _count - mean * mean;
+    return variance > 0.0 ? sqrt(variance) : 0.0;
+}
+
+inline double RippleMeter::getPeakToPeak() const
+{
+    return _max - _min;
+}
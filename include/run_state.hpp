@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "profile.hpp"
+
+// Where a reflow run is. The running
+// phases follow the profile: preheat is
+// the first segment, reflow the ramp to
+// the peak, soak anything between them
+// and cooling everything after the peak.
+enum RunState
+{
+    RUN_IDLE,
+    RUN_PREHEAT,
+    RUN_SOAK,
+    RUN_REFLOW,
+    RUN_COOLING,
+    RUN_DONE,
+    RUN_FAULT,
+    RUN_STATE_COUNT
+};
+
+enum RunEventType
+{
+    // arg is how long it was held (ms)
+    EVENT_BUTTON,
+    EVENT_START,
+    EVENT_CANCEL,
+    EVENT_FAULT,
+    EVENT_FAULT_CLEARED,
+};
+
+// Stamped with esp_timer_get_time() by
+// whoever posts it
+struct RunEvent
+{
+    RunEventType type;
+    int64_t time_us;
+    int32_t arg;
+};
+
+// Run state transitions. Only the
+// control loop changes the state;
+// everything else posts events to it.
+class RunStateMachine
+{
+public:
+    RunStateMachine();
+
+public:
+    RunState getState() const;
+    bool isRunning() const;
+
+    // Each returns false, leaving the
+    // state alone, if the transition
+    // isn't allowed from the current one
+    bool start();
+    bool cancel();
+    bool fault();
+    bool clearFault();
+
+    // Moves to the phase for curveTime
+    // ms into profile, or to RUN_DONE
+    // once it is over; true if the state
+    // changed
+    bool advance(const Profile &profile, unsigned long curveTime);
+
+    static RunState phaseAt(const Profile &profile, unsigned long curveTime);
+    static const char *getStateName(RunState state);
+    static const char *getEventName(RunEventType type);
+
+private:
+    volatile RunState _state;
+};
+
+inline RunStateMachine::RunStateMachine()
+    : _state(RUN_IDLE) {}
+
+inline RunState RunStateMachine::getState() const
+{
+    return _state;
+}
+
+inline bool RunStateMachine::isRunning() const
+{
+    RunState state = _state;
+    return state >= RUN_PREHEAT && state <= RUN_COOLING;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <math.h>
+
+// Tracking error and controller cost
+// accumulated over one reflow run
+struct RunStats
+{
+    long ticks;
+    double sumSqError;
+    double maxOvershoot;
+    double maxUndershoot;
+    long long totalCompute_us;
+    long maxCompute_us;
+
+    void reset();
+    void add(double setpoint, double input, long compute_us);
+    double getRmsError() const;
+    double getAvgCompute_us() const;
+};
+
+inline void RunStats::reset()
+{
+    ticks = 0;
+    sumSqError = 0.0;
+    maxOvershoot = 0.0;
+    maxUndershoot = 0.0;
+    totalCompute_us = 0;
+    maxCompute_us = 0;
+}
+
+inline void RunStats::add(double setpoint, double input, long compute_us)
+{
+    double error = input - setpoint;
+
+    ticks++;
+    sumSqError += error * error;
+    if (error > maxOvershoot)
+    {
+        maxOvershoot = error;
+    }
+    if (-error > maxUndershoot)
+    {
+        maxUndershoot = -error;
+    }
+    totalCompute_us += compute_us;
+    if (compute_us > maxCompute_us)
+    {
+        maxCompute_us = compute_us;
+    }
+}
+
+inline double RunStats::getRmsError() const
+{
+    return ticks > 0 ? sqrt(sumSqError / ticks) : 0.0;
+}
+
+inline double RunStats::getAvgCompute_us() const
+{
+    return ticks > 0 ? (double)totalCompute_us / ticks : 0.0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+// Moving average over the last N
+// samples
+template <typename T, int N>
+class SampleAverage
+{
+public:
+    SampleAverage();
+
+public:
+    void add(T sample);
+
+    // True once N samples have been
+    // added
+    bool isFull() const;
+    T average() const;
+
+private:
+    T _samples[N];
+    int _idx;
+    int _count;
+};
+
+template <typename T, int N>
+inline SampleAverage<T, N>::SampleAverage()
+    : _idx(0),
+      _count(0) {}
+
+template <typename T, int N>
+inline void SampleAverage<T, N>::add(T sample)
+{
+    _samples[_idx] = sample;
+    _idx = (_idx + 1) % N;
+
+    if (_count < N)
+    {
+        _count++;
+    }
+}
+
+template <typename T, int N>
+inline bool SampleAverage<T, N>::isFull() const
+{
+    return _count == N;
+}
+
+template <typename T, int N>
+inline T SampleAverage<T, N>::average() const
+{
+    T sum = 0;
+    for (int i = 0; i < N; i++)
+    {
+        sum += _samples[i];
+    }
+
+    return sum / N;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+
+// Fixed size, lock-free queue for one
+// producer and one consumer, which may
+// be on different tasks or cores. Holds
+// up to N - 1 items; push() fails when
+// full rather than blocking, so it is
+// safe from a timer callback.
+template <typename T, int N>
+class SpscQueue
+{
+public:
+    SpscQueue();
+
+public:
+    // Producer side only
+    bool push(const T &item);
+
+    // Consumer side only
+    bool pop(T &item);
+
+    bool isEmpty() const;
+
+private:
+    T _items[N];
+
+    // _head is only written by the
+    // consumer, _tail by the producer
+    std::atomic<int> _head;
+    std::atomic<int> _tail;
+};
+
+template <typename T, int N>
+inline SpscQueue<T, N>::SpscQueue()
+    : _head(0),
+      _tail(0) {}
+
+template <typename T, int N>
+inline bool SpscQueue<T, N>::push(const T &item)
+{
+    int tail = _tail.load(std::memory_order_relaxed);
+    int next = (tail + 1) % N;
+    if (next == _head.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    _items[tail] = item;
+    _tail.store(next, std::memory_order_release);
+
+    return true;
+}
+
+template <typename T, int N>
+inline bool SpscQueue<T, N>::pop(T &item)
+{
+    int head = _head.load(std::memory_order_relaxed);
+    if (head == _tail.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    item = _items[head];
+    _head.store((head + 1) % N, std::memory_order_release);
+
+    return true;
+}
+
+template <typename T, int N>
+inline bool SpscQueue<T, N>::isEmpty() const
+{
+    return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Sensor channels watched for
+// sample age
+enum SupervisorChannel
+{
+    SUPERVISOR_TC1,
+    SUPERVISOR_TC2,
+    SUPERVISOR_LMT85,
+    SUPERVISOR_CHANNEL_COUNT
+};
+
+// Fault bits; a latched fault keeps
+// every bit that was seen until it
+// is cleared
+enum SupervisorFault
+{
+    FAULT_NONE = 0,
+    FAULT_TC1_STALE = 1 << SUPERVISOR_TC1,
+    FAULT_TC2_STALE = 1 << SUPERVISOR_TC2,
+    FAULT_LMT85_STALE = 1 << SUPERVISOR_LMT85,
+    FAULT_OVER_TEMP = 1 << 3,
+    FAULT_DISAGREEMENT = 1 << 4,
+    FAULT_RUNAWAY = 1 << 5,
+    FAULT_INJECTED = 1 << 6,
+};
+
+struct SupervisorLimits
+{
+    // Bit per SupervisorChannel that
+    // must keep producing samples
+    uint32_t requiredChannels;
+
+    // Oldest usable sample (ms)
+    int maxSampleAge_ms;
+
+    // Absolute limit on any plate
+    // sensor (C)
+    double maxTemp;
+
+    // Largest allowed |TC1 - TC2| (C);
+    // 0 disables the check
+    double maxDisagreement;
+
+    // Runaway: at or above runawayDuty for
+    // runawayWindow_ms the plate must rise
+    // at least runawayMinRise; with the
+    // heater off it must not rise more
+    // than runawayMinRise
+    double runawayDuty;
+    int runawayWindow_ms;
+    double runawayMinRise;
+
+    // The rise is only required while the
+    // plate is this far (C) below where
+    // the model says the duty would
+    // settle it; a steady hold needs high
+    // duty without rising
+    double runawayMargin;
+};
+
+const SupervisorLimits defaultSupervisorLimits = {
+    (1 << SUPERVISOR_TC1) | (1 << SUPERVISOR_LMT85),
+    500,
+    260.0,
+    0.0,
+    0.5,
+    30000,
+    2.0,
+    20.0,
+};
+
+// Latest reading of each channel and
+// when it was captured
+struct SupervisorInputs
+{
+    double temp[SUPERVISOR_CHANNEL_COUNT];
+    int64_t timestamp_us[SUPERVISOR_CHANNEL_COUNT];
+    double duty;
+
+    // Steady state plate temperature at
+    // duty, from the plate model (C)
+    double steadyTemp;
+};
+
+// Pure checking logic for the thermal
+// safety supervisor. The caller runs
+// check() at a fixed period and turns
+// the heaters off whenever it returns
+// a fault, so the worst case reaction
+// latency is two check periods: one to
+// notice the condition and one more to
+// re-assert the heaters off in case a
+// controller write raced the first.
+class Supervisor
+{
+public:
+    Supervisor();
+
+public:
+    void begin(const SupervisorLimits &limits);
+
+    // Returns the latched fault bits
+    uint32_t check(const SupervisorInputs &inputs, int64_t now_us);
+
+    // Call right after the heaters have
+    // been forced off for a fault
+    void heatersOff(int64_t now_us);
+
+    bool isFaulted() const;
+    uint32_t getFaults() const;
+
+    const SupervisorLimits &getLimits() const;
+
+    // Clears the latch; fails while
+    // any fault is still present
+    bool clear(const SupervisorInputs &inputs, int64_t now_us);
+
+    // Simulates a fault starting now so
+    // the reaction latency can be
+    // measured; safe to call from another
+    // task
+    void inject(int64_t now_us);
+
+    // Time from fault onset to heaters
+    // off for the last fault and the
+    // worst seen
+    int64_t getLastLatency_us() const;
+    int64_t getMaxLatency_us() const;
+
+private:
+    uint32_t evaluate(const SupervisorInputs &inputs, int64_t now_us, int64_t *onset_us);
+
+    SupervisorLimits _limits;
+    uint32_t _faults;
+    int64_t _onset_us;
+    bool _reacted;
+    // Written by inject() from another
+    // task: the time first, then the flag
+    // is published
+    std::atomic<bool> _injected;
+    int64_t _injectedAt_us;
+    int64_t _lastLatency_us;
+    int64_t _maxLatency_us;
+
+    // Runaway window start
+    int64_t _windowStart_us;
+    double _windowStartTemp;
+    bool _windowHeating;
+};
+
+inline bool Supervisor::isFaulted() const
+{
+    return _faults != FAULT_NONE;
+}
+
+inline uint32_t Supervisor::getFaults() const
+{
+    return _faults;
+}
+
+inline const SupervisorLimits &Supervisor::getLimits() const
+{
+    return _limits;
+}
+
+inline int64_t Supervisor::getLastLatency_us() const
+{
+    return _lastLatency_us;
+}
+
+inline int64_t Supervisor::getMaxLatency_us() const
+{
+    return _maxLatency_us;
+}
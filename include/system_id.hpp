@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "plate_model.hpp"
+
+enum SysIdExcitation
+{
+    SYSID_STEP,
+    SYSID_PRBS,
+};
+
+struct SysIdConfig
+{
+    SysIdExcitation excitation;
+
+    // Heater duty (0.0 - 1.0) the
+    // excitation switches between
+    double low;
+    double high;
+
+    // PRBS bit length (s)
+    int bitTime;
+
+    // Run length (s); the run also ends
+    // once TC1 reaches maxTemp (C)
+    int duration;
+    double maxTemp;
+};
+
+const SysIdConfig defaultSysIdConfig = {SYSID_PRBS, 0.1, 0.5, 20, 900, 180.0};
+
+enum SysIdChannel
+{
+    SYSID_TC1,
+    SYSID_LMT85,
+    SYSID_CHANNEL_COUNT
+};
+
+// Identifies a first order plus dead time
+// model of the plate from a duty step or
+// PRBS. Readings are averaged over 1s
+// samples and fed, as they arrive, to a
+// bank of recursive least squares fits
+// of
+//
+//   y[k+1] = a y[k] + b u[k-d] + c
+//
+// one per candidate dead time d. The fit
+// with the lowest prediction error wins.
+// Nothing but the fits is stored.
+class SystemId
+{
+public:
+    static const int sampleMs = 1000;
+    static const int maxDelay = 15;
+
+    SystemId();
+
+public:
+    void begin(const SysIdConfig &config);
+
+    // Starts a run at time ms
+    void start(unsigned long ms);
+
+    // Heater duty to apply at time ms
+    double dutyAt(unsigned long ms) const;
+
+    // Feeds one tick's readings and the
+    // duty applied over it; NaN readings
+    // are skipped
+    void addSample(unsigned long ms, double duty, double tc1, double lmt85);
+
+    // True once the run should end
+    bool isDone(unsigned long ms, double tc1) const;
+
+    // Fills model from the best fit for
+    // channel; false if the fit isn't a
+    // stable, heating plate
+    bool getModel(SysIdChannel channel, PlateModel &model, double &rmsError) const;
+
+    long getSamples() const;
+
+private:
+    struct Fit
+    {
+        double theta[3];
+        double p[3][3];
+        double sumSqError;
+        long count;
+
+        void reset();
+        void update(const double phi[3], double y);
+    };
+
+    void addWindow(const double mean[SYSID_CHANNEL_COUNT], double duty);
+
+    SysIdConfig _config;
+    unsigned long _start;
+
+    // One period of a 7 bit maximal
+    // length sequence
+    static const int prbsLength = 127;
+    uint8_t _prbs[prbsLength];
+
+    // Current 1s window
+    unsigned long _windowEnd;
+    double _sum[SYSID_CHANNEL_COUNT];
+    int _count[SYSID_CHANNEL_COUNT];
+    double _dutySum;
+    int _dutyCount;
+
+    // Last window means, and duties back
+    // to maxDelay windows before the last
+    double _lastMean[SYSID_CHANNEL_COUNT];
+    double _dutyHistory[maxDelay + 2];
+    long _samples;
+
+    Fit _fits[SYSID_CHANNEL_COUNT][maxDelay + 1];
+};
+
+inline long SystemId::getSamples() const
+{
+    return _samples;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One row of the CSV telemetry stream,
+// less the time column: the capture time
+// of the control sample relative to each
+// client's connect time
+struct TelemetryRow
+{
+    static const int maxOutputs = 8;
+
+    double setpoint;
+    double tc1Temp;
+    double tc2Temp;
+    double lmt85Temp;
+    double estimateTemp;
+    double estimateRate;
+
+    // Control sample capture to heater
+    // write, and to this row being sent
+    double sensorToActuation_us;
+    double sampleToClient_us;
+
+    // Heater energy this run, all zones
+    // (J)
+    double energy_J;
+
+    // Heater output per zone (%)
+    int numOutputs;
+    double outputs[maxOutputs];
+
+    // Run state name, last column
+    const char *phase;
+};
+
+// Columns after time, in order; a client
+// can subscribe to any set of them
+enum TelemetryColumn
+{
+    COLUMN_SETPOINT,
+    COLUMN_TC1,
+    COLUMN_TC2,
+    COLUMN_LMT85,
+    COLUMN_ESTIMATE,
+    COLUMN_RATE,
+    COLUMN_SENSOR_TO_ACTUATION,
+    COLUMN_SAMPLE_TO_CLIENT,
+    COLUMN_ENERGY,
+    // One per zone
+    COLUMN_OUTPUTS,
+    COLUMN_PHASE,
+    COLUMN_COUNT
+};
+
+const uint32_t csvAllColumns = (1u << COLUMN_COUNT) - 1;
+
+// Space to leave ahead of a row body
+// for prependCsvTime()
+const int csvTimePrefixSize = 12;
+
+// Longest string formatFixed() writes
+const int fixedMaxLength = 32;
+
+// Writes value with the given number
+// of decimals (0 - 3), rounded half away
+// from zero, using integer arithmetic;
+// buf needs fixedMaxLength bytes.
+// Returns the length.
+int formatFixed(char *buf, double value, int decimals);
+
+// Formats everything after the time
+// column, starting with its comma and
+// ending with a newline; returns the
+// length
+int formatCsvBody(char *buf, size_t size, const TelemetryRow &row, uint32_t columns = csvAllColumns);
+
+// Writes the quoted column titles, less
+// the newline; returns the length
+int formatCsvHeader(char *buf, size_t size, uint32_t columns, const char *const *outputNames, int numOutputs);
+
+// Column set from comma separated names
+// ("tc1,tc2,phase") or "all"; 0 if any
+// name is unknown
+uint32_t parseCsvColumns(const char *names);
+
+// Writes the time column (seconds, two
+// decimals) into the csvTimePrefixSize
+// bytes before body and returns the
+// start of the row
+char *prependCsvTime(char *body, unsigned long time_ms);
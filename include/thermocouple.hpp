@@ -0,0 +1,31 @@
+#pragma once
+
+// K-type thermocouple linearization
+// (NIST ITS-90)
+
+// Corrects a MAX31855 reading. The chip
+// reports cold junction + V / 41.276
+// uV/C, a straight line; this recovers V,
+// adds the cold junction's own EMF and
+// looks the sum up on the NIST curve.
+// NaN (a faulted read) passes through.
+//
+// Both lookups are linear interpolation
+// in tables built from the NIST
+// polynomials at compile time. Against
+// the forward polynomial the result is
+// within 0.06 C from -40 C to 1372 C
+// (0.05 C up to 300 C), most of it the
+// error NIST gives for its inverse
+// polynomials; the bench sees 0.05 C
+// against the NIST reference table.
+double correctKType(double tc_c, double coldJunction_c);
+
+// The NIST polynomials themselves, in
+// double; the reference the tables are
+// checked against
+double getKTypeEmf_mV(double temp_c);
+double getKTypeTemp_c(double emf_mV);
+
+// MAX31855 gain (mV/C)
+const double max31855Gain_mV = 0.041276;
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "plate_model.hpp"
+#include "profile.hpp"
+
+struct TrajectoryConfig
+{
+    // Shape the setpoint to what the
+    // plate can follow; when off the
+    // table holds the profile as given
+    bool enabled;
+
+    // Fraction of full duty that heating
+    // is planned at; the rest is left for
+    // the controller to correct with
+    double headroom;
+
+    // Width the corners are rounded over
+    // (s)
+    double cornerTime;
+
+    // Table step (ms); profiles too long
+    // for the table get a longer one
+    int step_ms;
+};
+
+const TrajectoryConfig defaultTrajectoryConfig = {true, 0.8, 15.0, 250};
+
+// A profile segment that asks for more
+// than the plate can do at its hardest
+// end
+struct InfeasibleSegment
+{
+    // Index of the segment's end point
+    int point;
+
+    // Asked and achievable rate (C/s),
+    // negative when cooling
+    double slope;
+    double limit;
+};
+
+// A profile compiled against the plate
+// model when it's loaded: segments are
+// checked against the heating rate at
+// the planned duty and the passive
+// cooling rate, and the setpoint is
+// rate limited to what the plate can
+// follow, rounded at the corners but
+// not across a peak, and stored as a
+// table. Looking up a tick's
+// setpoint is an index and one
+// interpolation.
+class Trajectory
+{
+public:
+    static const int maxSamples = 1200;
+    static const int maxCornerSamples = 121;
+
+    Trajectory();
+
+public:
+    bool compile(const Profile &profile, const PlateModel &model, const TrajectoryConfig &config);
+
+    // False until compile() succeeds, and
+    // after one fails; setpointAt() is 0
+    // throughout
+    bool isCompiled() const;
+
+    // Setpoint at curveTime ms into the
+    // curve; 0.0 once the curve is over,
+    // as with Profile
+    double setpointAt(unsigned long curveTime) const;
+
+    // Slope (C/s) of the table step at
+    // curveTime; 0.0 once the curve is
+    // over
+    double slopeAt(unsigned long curveTime) const;
+
+    int getNumInfeasible() const;
+    const InfeasibleSegment &getInfeasible(int i) const;
+
+    int getStep() const;
+    double getPeak() const;
+
+    // Largest difference from the profile
+    // as given (C)
+    double getMaxDeviation() const;
+
+    // Fastest the plate can heat or cool
+    // at temp (C/s), both positive
+    static double maxHeatRate(const PlateModel &model, double headroom, double temp);
+    static double maxCoolRate(const PlateModel &model, double temp);
+
+private:
+    float _table[maxSamples];
+    int _numSamples;
+    int _step_ms;
+    unsigned long _duration;
+
+    InfeasibleSegment _infeasible[Profile::maxPoints];
+    int _numInfeasible;
+
+    double _peak;
+    double _maxDeviation;
+};
+
+inline int Trajectory::getNumInfeasible() const
+{
+    return _numInfeasible;
+}
+
+inline const InfeasibleSegment &Trajectory::getInfeasible(int i) const
+{
+    return _infeasible[i];
+}
+
+inline bool Trajectory::isCompiled() const
+{
+    return _numSamples > 0;
+}
+
+inline int Trajectory::getStep() const
+{
+    return _step_ms;
+}
+
+inline double Trajectory::getPeak() const
+{
+    return _peak;
+}
+
+inline double Trajectory::getMaxDeviation() const
+{
+    return _maxDeviation;
+}
+
+inline double Trajectory::setpointAt(unsigned long curveTime) const
+{
+    if (curveTime >= _duration || _numSamples == 0)
+    {
+        return 0.0;
+    }
+
+    unsigned long i = curveTime / _step_ms;
+    if (i + 1 >= (unsigned long)_numSamples)
+    {
+        return _table[_numSamples - 1];
+    }
+    float frac = (float)(curveTime - i * _step_ms) / _step_ms;
+    return _table[i] + (_table[i + 1] - _table[i]) * frac;
+}
+
+inline double Trajectory::slopeAt(unsigned long curveTime) const
+{
+    if (curveTime >= _duration || _numSamples < 2)
+    {
+        return 0.0;
+    }
+
+    unsigned long i = curveTime / _step_ms;
+    if (i + 1 >= (unsigned long)_numSamples)
+    {
+        i = _numSamples - 2;
+    }
+    return (_table[i + 1] - _table[i]) * 1000.0 / _step_ms;
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <Arduino.h>
+#include <PID_v1.h>
+
+#include "gain_schedule.hpp"
+#include "heater.hpp"
+
+// Sensor a heater zone uses as
+// its PID input
+enum ZoneSensor
+{
+    ZONE_SENSOR_TC1,
+    ZONE_SENSOR_TC2,
+    ZONE_SENSOR_LMT85,
+    // Kalman estimate fusing all three
+    // sensors; falls back to TC1 when
+    // the estimator is disabled
+    ZONE_SENSOR_FUSED,
+    ZONE_SENSOR_COUNT
+};
+
+// Algorithm that computes zone
+// heater duty
+enum ControllerMode
+{
+    CONTROLLER_PID,
+    CONTROLLER_MPC,
+};
+
+// One independently controlled heater:
+// its FET pin and output channel, the
+// sensor it regulates on, an offset
+// from the active profile and its
+// own PID state
+class Zone
+{
+public:
+    Zone(const char *name,
+         int fetPin,
+         int pwmChannel,
+         ZoneSensor sensor,
+         double profileOffset,
+         double kp,
+         double ki,
+         double kd);
+
+public:
+    // PID output runs from 0 to
+    // maxOutput; phase is a fraction of
+    // the heater output period
+    bool begin(int maxOutput, int sampleTime, double phase);
+
+    // Drives the FET pin low before the
+    // heater output is configured
+    void holdOff();
+    void update(double input, double setpoint);
+    void updateManual(double input, double setpoint, double output);
+    void off();
+
+    // Takes effect, bumplessly, on the next
+    // update
+    void setGains(const PidGains &gains);
+
+    // Caps PID output at a fraction
+    // (above 0.0, up to 1.0) of full duty;
+    // the integral is clamped with it, so
+    // it doesn't wind up while capped
+    void setTrim(double trim);
+
+    // Writes zero duty without touching
+    // controller state; safe to call from
+    // another task
+    void forceOff();
+
+    const char *getName() const;
+    ZoneSensor getSensor() const;
+    double getProfileOffset() const;
+    int getMaxDuty() const;
+    const HeaterOutput &getHeater() const;
+    double getInput() const;
+    double getOutput() const;
+    double getSetpoint() const;
+
+    // esp_timer_get_time() when the last
+    // output was computed
+    int64_t getComputed_us() const;
+
+    // PID terms behind the last output,
+    // on the output scale. PID_v1 keeps
+    // them private, so they are rebuilt
+    // from the gains and the error; the
+    // integral is what's left of the
+    // output.
+    void getPidTerms(double &p, double &i, double &d);
+
+private:
+    const char *_name;
+    int _fetPin;
+    int _pwmChannel;
+    ZoneSensor _sensor;
+    double _profileOffset;
+    int _maxDuty;
+    HeaterOutput _heater;
+
+    // Must be declared before _pid,
+    // which keeps pointers to them
+    double _input;
+    double _output;
+    double _setpoint;
+    PID _pid;
+
+    PidGains _pendingGains;
+    bool _gainsPending;
+    double _trim;
+
+    int64_t _computed_us;
+    int _sampleTime;
+    double _lastInput;
+    double _dInput;
+};
+
+inline const char *Zone::getName() const
+{
+    return _name;
+}
+
+inline ZoneSensor Zone::getSensor() const
+{
+    return _sensor;
+}
+
+inline double Zone::getProfileOffset() const
+{
+    return _profileOffset;
+}
+
+inline int Zone::getMaxDuty() const
+{
+    return _maxDuty;
+}
+
+inline const HeaterOutput &Zone::getHeater() const
+{
+    return _heater;
+}
+
+inline double Zone::getInput() const
+{
+    return _input;
+}
+
+inline double Zone::getOutput() const
+{
+    return _output;
+}
+
+inline double Zone::getSetpoint() const
+{
+    return _setpoint;
+}
+
+inline int64_t Zone::getComputed_us() const
+{
+    return _computed_us;
+}
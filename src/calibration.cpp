@@ -0,0 +1,231 @@
+#include "calibration.hpp"
+
+Calibration::Calibration()
+    : _numPoints(0),
+      _active(0),
+      _enabled(true)
+{
+    for (int s = 0; s < CAL_SENSOR_COUNT; s++)
+    {
+        for (int i = 0; i < tableSize; i++)
+        {
+            _tables[0][s][i] = 0.0f;
+        }
+    }
+}
+
+bool Calibration::set(const CalibrationPoint *points, int numPoints)
+{
+    if (numPoints < 0 || numPoints > maxPoints)
+    {
+        return false;
+    }
+    for (int i = 0; i < numPoints; i++)
+    {
+        if (isnan(points[i].reference))
+        {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < numPoints; i++)
+    {
+        _points[i] = points[i];
+    }
+    _numPoints = numPoints;
+
+    int idle = 1 - _active.load(std::memory_order_relaxed);
+    for (int s = 0; s < CAL_SENSOR_COUNT; s++)
+    {
+        buildTable((CalSensor)s, _tables[idle][s]);
+    }
+    _active.store(idle, std::memory_order_release);
+
+    return true;
+}
+
+const char *Calibration::getSensorName(CalSensor sensor)
+{
+    switch (sensor)
+    {
+    case CAL_SENSOR_TC1:
+        return "tc1";
+    case CAL_SENSOR_TC2:
+        return "tc2";
+    case CAL_SENSOR_LMT85:
+        return "lmt85";
+    default:
+        return "unknown";
+    }
+}
+
+void Calibration::buildTable(CalSensor sensor, float *table) const
+{
+    // This sensor's points, sorted by
+    // its raw reading
+    double raw[maxPoints];
+    double offset[maxPoints];
+    int n = 0;
+    for (int i = 0; i < _numPoints; i++)
+    {
+        double r = _points[i].raw[sensor];
+        if (isnan(r))
+        {
+            continue;
+        }
+
+        int j = n++;
+        while (j > 0 && raw[j - 1] > r)
+        {
+            raw[j] = raw[j - 1];
+            offset[j] = offset[j - 1];
+            j--;
+        }
+        raw[j] = r;
+        offset[j] = _points[i].reference - r;
+    }
+
+    int segment = 0;
+    for (int i = 0; i < tableSize; i++)
+    {
+        double x = tableMin + i * tableStep;
+        if (n == 0)
+        {
+            table[i] = 0.0f;
+        }
+        else if (x <= raw[0])
+        {
+            table[i] = offset[0];
+        }
+        else if (x >= raw[n - 1])
+        {
+            table[i] = offset[n - 1];
+        }
+        else
+        {
+            while (x >= raw[segment + 1])
+            {
+                segment++;
+            }
+            double t = (x - raw[segment]) / (raw[segment + 1] - raw[segment]);
+            table[i] = offset[segment] + (offset[segment + 1] - offset[segment]) * t;
+        }
+    }
+}
+
+Calibrator::Calibrator()
+    : _config(defaultCalibrationConfig),
+      _step(0),
+      _stepStart_ms(0),
+      _numPoints(0)
+{
+    resetWindow();
+}
+
+void Calibrator::start(const CalibrationConfig &config, unsigned long now_ms)
+{
+    _config = config;
+    _step = 0;
+    _stepStart_ms = now_ms;
+    _numPoints = 0;
+    resetWindow();
+}
+
+CalibrationStep Calibrator::addSample(unsigned long now_ms, const double *temps)
+{
+    if (_step >= _config.numSetpoints)
+    {
+        return CAL_STEP_DONE;
+    }
+    if (now_ms - _stepStart_ms < settleTime_ms)
+    {
+        return CAL_STEP_WAITING;
+    }
+
+    for (int s = 0; s < CAL_SENSOR_COUNT; s++)
+    {
+        double t = temps[s];
+        if (isnan(t))
+        {
+            continue;
+        }
+        if (_valid[s] == 0 || t < _min[s])
+        {
+            _min[s] = t;
+        }
+        if (_valid[s] == 0 || t > _max[s])
+        {
+            _max[s] = t;
+        }
+        _sum[s] += t;
+        _valid[s]++;
+    }
+    if (++_windowCount < windowSamples)
+    {
+        return CAL_STEP_WAITING;
+    }
+
+    // Only sensors in range for the whole
+    // window count, and all of them must
+    // have held still
+    bool stable = false;
+    for (int s = 0; s < CAL_SENSOR_COUNT; s++)
+    {
+        if (_valid[s] == windowSamples)
+        {
+            stable = true;
+        }
+    }
+    for (int s = 0; s < CAL_SENSOR_COUNT; s++)
+    {
+        if (_valid[s] == windowSamples && _max[s] - _min[s] > stableBand)
+        {
+            stable = false;
+        }
+    }
+
+    if (!stable)
+    {
+        resetWindow();
+        return now_ms - _stepStart_ms > pointTimeout_ms ? CAL_STEP_TIMED_OUT : CAL_STEP_WAITING;
+    }
+
+    CalibrationPoint &point = _points[_numPoints];
+    double refSum = 0.0;
+    int refCount = 0;
+    for (int s = 0; s < CAL_SENSOR_COUNT; s++)
+    {
+        point.raw[s] = _valid[s] == windowSamples ? _sum[s] / windowSamples : NAN;
+        if (!isnan(point.raw[s]) && (_config.reference == s || _config.reference == CAL_SENSOR_COUNT))
+        {
+            refSum += point.raw[s];
+            refCount++;
+        }
+    }
+
+    // A point the reference sensor can't
+    // read is dropped
+    point.reference = refCount > 0 ? refSum / refCount : NAN;
+    if (refCount > 0)
+    {
+        _numPoints++;
+    }
+
+    _step++;
+    _stepStart_ms = now_ms;
+    resetWindow();
+
+    return _step >= _config.numSetpoints ? CAL_STEP_DONE : CAL_STEP_RECORDED;
+}
+
+void Calibrator::resetWindow()
+{
+    _windowCount = 0;
+    for (int s = 0; s < CAL_SENSOR_COUNT; s++)
+    {
+        _valid[s] = 0;
+        _min[s] = 0.0;
+        _max[s] = 0.0;
+        _sum[s] = 0.0;
+    }
+}
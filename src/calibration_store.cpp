@@ -0,0 +1,88 @@
+#include <LittleFS.h>
+#include <ArduinoJson.h>
+#include "calibration_store.hpp"
+
+typedef StaticJsonDocument<1024> CalibrationDoc;
+
+static bool applyCalibration(const CalibrationDoc &doc, Calibration &calibration)
+{
+    JsonArrayConst array = doc["points"];
+    if (array.isNull() || array.size() > (size_t)Calibration::maxPoints)
+    {
+        return false;
+    }
+
+    CalibrationPoint points[Calibration::maxPoints];
+    int numPoints = 0;
+    for (JsonVariantConst p : array)
+    {
+        CalibrationPoint &point = points[numPoints++];
+        point.reference = p["reference"] | NAN;
+        for (int s = 0; s < CAL_SENSOR_COUNT; s++)
+        {
+            point.raw[s] = p[Calibration::getSensorName((CalSensor)s)] | NAN;
+        }
+    }
+
+    return calibration.set(points, numPoints);
+}
+
+bool loadCalibration(const char *path, Calibration &calibration)
+{
+    File file = LittleFS.open(path, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    CalibrationDoc doc;
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error)
+    {
+        return false;
+    }
+
+    return applyCalibration(doc, calibration);
+}
+
+bool saveCalibration(const char *path, const Calibration &calibration)
+{
+    File file = LittleFS.open(path, "w", true);
+    if (!file)
+    {
+        return false;
+    }
+
+    CalibrationDoc doc;
+    JsonArray array = doc.createNestedArray("points");
+    for (int i = 0; i < calibration.getNumPoints(); i++)
+    {
+        const CalibrationPoint &point = calibration.getPoint(i);
+        JsonObject p = array.createNestedObject();
+        p["reference"] = point.reference;
+        for (int s = 0; s < CAL_SENSOR_COUNT; s++)
+        {
+            if (!isnan(point.raw[s]))
+            {
+                p[Calibration::getSensorName((CalSensor)s)] = point.raw[s];
+            }
+        }
+    }
+    bool ok = serializeJson(doc, file) > 0;
+    file.close();
+
+    return ok;
+}
+
+bool importCalibration(const char *json, size_t length, Calibration &calibration)
+{
+    CalibrationDoc doc;
+    DeserializationError error = deserializeJson(doc, json, length);
+    if (error)
+    {
+        return false;
+    }
+
+    return applyCalibration(doc, calibration);
+}
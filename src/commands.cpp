@@ -0,0 +1,103 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "commands.hpp"
+#include "telemetry.hpp"
+
+bool parseCommand(const char *line, Command &command)
+{
+    char verb[16];
+    char arg[commandMaxLength];
+    double values[3];
+
+    command.type = CMD_INVALID;
+    int fields = sscanf(line, "%15s %63s", verb, arg);
+    if (fields < 1)
+    {
+        return false;
+    }
+
+    if (strcmp(verb, "start") == 0 && fields == 1)
+    {
+        command.type = CMD_START;
+    }
+    else if (strcmp(verb, "cancel") == 0 && fields == 1)
+    {
+        command.type = CMD_CANCEL;
+    }
+    else if (strcmp(verb, "calibrate") == 0 && fields == 1)
+    {
+        command.type = CMD_CALIBRATE;
+    }
+    else if (strcmp(verb, "profile") == 0 && fields == 2 && strlen(arg) < sizeof(command.name))
+    {
+        command.type = CMD_PROFILE;
+        strcpy(command.name, arg);
+    }
+    else if (strcmp(verb, "setpoint") == 0 && sscanf(line, "%*s %lf", &values[0]) == 1 &&
+             isfinite(values[0]))
+    {
+        command.type = CMD_SETPOINT;
+        command.values[0] = values[0];
+    }
+    else if ((strcmp(verb, "coast") == 0 || strcmp(verb, "idle") == 0) &&
+             sscanf(line, "%*s %lf", &values[0]) == 1 && (values[0] == 0.0 || values[0] == 1.0))
+    {
+        command.type = verb[0] == 'c' ? CMD_COAST : CMD_IDLE;
+        command.values[0] = values[0];
+    }
+    else if (strcmp(verb, "gains") == 0 &&
+             sscanf(line, "%*s %lf %lf %lf", &values[0], &values[1], &values[2]) == 3 &&
+             isfinite(values[0]) && isfinite(values[1]) && isfinite(values[2]))
+    {
+        command.type = CMD_GAINS;
+        for (int i = 0; i < 3; i++)
+        {
+            command.values[i] = values[i];
+        }
+    }
+    else if (strcmp(verb, "subscribe") == 0 && fields == 2)
+    {
+        int period_ms = 0;
+        command.columns = parseCsvColumns(arg);
+        if (command.columns != 0 && sscanf(line, "%*s %*s %d", &period_ms) != 1)
+        {
+            period_ms = 0;
+        }
+        if (command.columns != 0 && period_ms >= 0)
+        {
+            command.type = CMD_SUBSCRIBE;
+            command.period_ms = period_ms;
+        }
+    }
+
+    return command.type != CMD_INVALID;
+}
+
+const char *getCommandName(CommandType type)
+{
+    switch (type)
+    {
+    case CMD_START:
+        return "start";
+    case CMD_CANCEL:
+        return "cancel";
+    case CMD_PROFILE:
+        return "profile";
+    case CMD_SETPOINT:
+        return "setpoint";
+    case CMD_GAINS:
+        return "gains";
+    case CMD_SUBSCRIBE:
+        return "subscribe";
+    case CMD_CALIBRATE:
+        return "calibrate";
+    case CMD_COAST:
+        return "coast";
+    case CMD_IDLE:
+        return "idle";
+    default:
+        return "invalid";
+    }
+}
@@ -3,26 +3,384 @@
 #include "config.hpp"
 
 Config::Config()
-    : _doc(1024) {}
+    : _estimatorEnabled(false),
+      _tc2Lag(30.0),
+      _lmt85Lag(60.0),
+      _plateModel(defaultPlateModel),
+      _sysIdConfig(defaultSysIdConfig),
+      _trajectoryConfig(defaultTrajectoryConfig),
+      _controllerMode(CONTROLLER_PID),
+      _mpcConfig(defaultMpcConfig),
+      _ilcConfig(defaultIlcConfig),
+      _heaterConfig(defaultHeaterConfig),
+      _energyConfig(defaultEnergyConfig),
+      _idleConfig(defaultIdleConfig),
+      _calibrationConfig(defaultCalibrationConfig),
+      _supervisorLimits(defaultSupervisorLimits),
+      _supervisorSelfTest(false),
+      _memoryReportPeriod(60),
+      _csvMaxClients(10)
+{
+    _ssid[0] = '\0';
+    _key[0] = '\0';
+    _mdns[0] = '\0';
+    copyString(_profileName, sizeof(_profileName), "chipquik");
+}
 
 bool Config::readConfig(File configFile)
 {
-    DeserializationError error = deserializeJson(_doc, configFile);
+    // The document only lives on the
+    // stack while the file is read
+    StaticJsonDocument<2048> doc;
+    DeserializationError error = deserializeJson(doc, configFile);
+    if (error)
+    {
+        return false;
+    }
+
+    copyString(_ssid, sizeof(_ssid), doc["ssid"] | "");
+    copyString(_key, sizeof(_key), doc["key"] | "");
+    copyString(_mdns, sizeof(_mdns), doc["mdns"] | "");
+
+    _estimatorEnabled = doc["estimator"] | false;
+    _tc2Lag = doc["estimatorLag"]["tc2"] | _tc2Lag;
+    _lmt85Lag = doc["estimatorLag"]["lmt85"] | _lmt85Lag;
+    readPlateModel(doc["model"]);
+    readSysIdConfig(doc["sysid"]);
+
+    copyString(_profileName, sizeof(_profileName), doc["profile"] | "chipquik");
+    readTrajectoryConfig(doc["trajectory"]);
+    const char *mode = doc["controller"] | "pid";
+    _controllerMode = strcmp(mode, "mpc") == 0 ? CONTROLLER_MPC : CONTROLLER_PID;
+    readMpcConfig(doc["mpc"]);
+    readIlcConfig(doc["ilc"]);
+    readGainSchedule(doc["gainSchedule"]);
+
+    readHeaterConfig(doc["heater"]);
+    readEnergyConfig(doc["energy"]);
+    readIdleConfig(doc["idle"]);
+    readCalibrationConfig(doc["calibration"]);
+
+    readSupervisorLimits(doc["supervisor"]);
+    _supervisorSelfTest = doc["supervisorSelfTest"] | false;
 
-    return !error;
+    _memoryReportPeriod = doc["memoryReportPeriod"] | _memoryReportPeriod;
+
+    _csvMaxClients = doc["csvMaxClients"] | _csvMaxClients;
+
+    return true;
 }
 
 const char *Config::getSSID()
 {
-    return _doc["ssid"];
+    return _ssid;
 }
 
 const char *Config::getKey()
 {
-    return _doc["key"];
+    return _key;
 }
 
 const char *Config::getMDNS()
 {
-    return _doc["mdns"];
+    return _mdns;
+}
+
+bool Config::getEstimatorEnabled()
+{
+    return _estimatorEnabled;
+}
+
+double Config::getTc2Lag()
+{
+    return _tc2Lag;
+}
+
+double Config::getLmt85Lag()
+{
+    return _lmt85Lag;
+}
+
+PlateModel Config::getPlateModel()
+{
+    return _plateModel;
+}
+
+const char *Config::getProfileName()
+{
+    return _profileName;
+}
+
+TrajectoryConfig Config::getTrajectoryConfig()
+{
+    return _trajectoryConfig;
+}
+
+ControllerMode Config::getControllerMode()
+{
+    return _controllerMode;
+}
+
+SysIdConfig Config::getSysIdConfig()
+{
+    return _sysIdConfig;
+}
+
+MpcConfig Config::getMpcConfig()
+{
+    return _mpcConfig;
+}
+
+IlcConfig Config::getIlcConfig()
+{
+    return _ilcConfig;
+}
+
+GainSchedule Config::getGainSchedule()
+{
+    return _gainSchedule;
+}
+
+HeaterConfig Config::getHeaterConfig()
+{
+    return _heaterConfig;
+}
+
+EnergyConfig Config::getEnergyConfig()
+{
+    return _energyConfig;
+}
+
+IdleConfig Config::getIdleConfig()
+{
+    return _idleConfig;
+}
+
+CalibrationConfig Config::getCalibrationConfig()
+{
+    return _calibrationConfig;
+}
+
+SupervisorLimits Config::getSupervisorLimits()
+{
+    return _supervisorLimits;
+}
+
+bool Config::getSupervisorSelfTest()
+{
+    return _supervisorSelfTest;
+}
+
+int Config::getMemoryReportPeriod()
+{
+    return _memoryReportPeriod;
+}
+
+int Config::getCsvMaxClients()
+{
+    return _csvMaxClients;
+}
+
+void Config::readPlateModel(JsonVariant m)
+{
+    _plateModel.gain = m["gain"] | _plateModel.gain;
+    _plateModel.tau = m["tau"] | _plateModel.tau;
+    _plateModel.deadTime = m["deadTime"] | _plateModel.deadTime;
+    _plateModel.ambient = m["ambient"] | _plateModel.ambient;
+}
+
+void Config::readSysIdConfig(JsonVariant s)
+{
+    const char *excitation = s["excitation"] | "prbs";
+    _sysIdConfig.excitation = strcmp(excitation, "step") == 0 ? SYSID_STEP : SYSID_PRBS;
+    _sysIdConfig.low = s["low"] | _sysIdConfig.low;
+    _sysIdConfig.high = s["high"] | _sysIdConfig.high;
+    _sysIdConfig.bitTime = s["bitTime"] | _sysIdConfig.bitTime;
+    _sysIdConfig.duration = s["duration"] | _sysIdConfig.duration;
+    _sysIdConfig.maxTemp = s["maxTemp"] | _sysIdConfig.maxTemp;
+}
+
+void Config::readTrajectoryConfig(JsonVariant t)
+{
+    _trajectoryConfig.enabled = t["enabled"] | _trajectoryConfig.enabled;
+    _trajectoryConfig.cornerTime = t["cornerTime"] | _trajectoryConfig.cornerTime;
+
+    // Each lookup divides by the step
+    int step_ms = t["step"] | _trajectoryConfig.step_ms;
+    if (step_ms > 0)
+    {
+        _trajectoryConfig.step_ms = step_ms;
+    }
+
+    // Planning at no duty would leave
+    // nothing to heat with
+    double headroom = t["headroom"] | _trajectoryConfig.headroom;
+    if (headroom > 0.0 && headroom <= 1.0)
+    {
+        _trajectoryConfig.headroom = headroom;
+    }
+}
+
+void Config::readMpcConfig(JsonVariant m)
+{
+    _mpcConfig.horizon = m["horizon"] | _mpcConfig.horizon;
+    _mpcConfig.step = m["step"] | _mpcConfig.step;
+    _mpcConfig.blocks = m["blocks"] | _mpcConfig.blocks;
+    _mpcConfig.moveWeight = m["moveWeight"] | _mpcConfig.moveWeight;
+}
+
+void Config::readIlcConfig(JsonVariant l)
+{
+    _ilcConfig.enabled = l["enabled"] | _ilcConfig.enabled;
+    _ilcConfig.gain = l["gain"] | _ilcConfig.gain;
+    _ilcConfig.lead = l["lead"] | _ilcConfig.lead;
+    _ilcConfig.maxCorrection = l["maxCorrection"] | _ilcConfig.maxCorrection;
+}
+
+void Config::readGainSchedule(JsonArray g)
+{
+    // e.g. "gainSchedule": [
+    //   {"upTo": 150, "phase": "rising",
+    //    "kp": 600, "ki": 0.5, "kd": 1}]
+    _gainSchedule.clear();
+    for (JsonVariant e : g)
+    {
+        GainScheduleEntry entry;
+        entry.upTo = e["upTo"] | 1000.0;
+        const char *phase = e["phase"] | "any";
+        entry.phase = PHASE_ANY;
+        if (strcmp(phase, "rising") == 0)
+        {
+            entry.phase = PHASE_RISING;
+        }
+        else if (strcmp(phase, "holding") == 0)
+        {
+            entry.phase = PHASE_HOLDING;
+        }
+        else if (strcmp(phase, "falling") == 0)
+        {
+            entry.phase = PHASE_FALLING;
+        }
+        entry.gains.kp = e["kp"] | 0.0;
+        entry.gains.ki = e["ki"] | 0.0;
+        entry.gains.kd = e["kd"] | 0.0;
+        if (!_gainSchedule.add(entry))
+        {
+            break;
+        }
+    }
+}
+
+void Config::readHeaterConfig(JsonVariant h)
+{
+    const char *mode = h["mode"] | "pwm";
+    if (strcmp(mode, "burst") == 0)
+    {
+        _heaterConfig.mode = HEATER_BURST;
+    }
+    else if (strcmp(mode, "sigmadelta") == 0)
+    {
+        _heaterConfig.mode = HEATER_SIGMA_DELTA;
+    }
+    _heaterConfig.freq = h["freq"] | _heaterConfig.freq;
+    _heaterConfig.resolution = h["resolution"] | _heaterConfig.resolution;
+    _heaterConfig.window_ms = h["window"] | _heaterConfig.window_ms;
+    _heaterConfig.tick_ms = h["tick"] | _heaterConfig.tick_ms;
+}
+
+void Config::readEnergyConfig(JsonVariant e)
+{
+    _energyConfig.supplyVoltage = e["supplyVoltage"] | _energyConfig.supplyVoltage;
+    _energyConfig.heaterResistance = e["heaterResistance"] | _energyConfig.heaterResistance;
+    _energyConfig.coast = e["coast"] | _energyConfig.coast;
+    _energyConfig.coastLookahead = e["coastLookahead"] | _energyConfig.coastLookahead;
+    _energyConfig.coastSlopeDrop = e["coastSlopeDrop"] | _energyConfig.coastSlopeDrop;
+
+    // A cap of zero would stop the PID
+    // limits from being set
+    double scale = e["coastScale"] | _energyConfig.coastScale;
+    if (scale > 0.0 && scale <= 1.0)
+    {
+        _energyConfig.coastScale = scale;
+    }
+}
+
+void Config::readIdleConfig(JsonVariant i)
+{
+    _idleConfig.enabled = i["enabled"] | _idleConfig.enabled;
+    _idleConfig.lightSleep = i["lightSleep"] | _idleConfig.lightSleep;
+    _idleConfig.tcPeriod_ms = i["tcPeriod"] | _idleConfig.tcPeriod_ms;
+    _idleConfig.lmt85Period_ms = i["lmt85Period"] | _idleConfig.lmt85Period_ms;
+    _idleConfig.displayPeriod_ms = i["displayPeriod"] | _idleConfig.displayPeriod_ms;
+    _idleConfig.loopPeriod_ms = i["loopPeriod"] | _idleConfig.loopPeriod_ms;
+}
+
+void Config::readCalibrationConfig(JsonVariant c)
+{
+    // e.g. "calibration": {
+    //   "setpoints": [60, 100, 150, 200],
+    //   "reference": "mean"}
+    // reference is "tc1", "tc2", "lmt85"
+    // or "mean"
+    if (!c["setpoints"].isNull())
+    {
+        _calibrationConfig.numSetpoints = 0;
+        for (JsonVariant setpoint : c["setpoints"].as<JsonArray>())
+        {
+            if (_calibrationConfig.numSetpoints == Calibration::maxPoints)
+            {
+                break;
+            }
+            _calibrationConfig.setpoints[_calibrationConfig.numSetpoints++] = setpoint | 0.0;
+        }
+    }
+
+    const char *reference = c["reference"] | "mean";
+    _calibrationConfig.reference = CAL_SENSOR_COUNT;
+    for (int s = 0; s < CAL_SENSOR_COUNT; s++)
+    {
+        if (strcmp(reference, Calibration::getSensorName((CalSensor)s)) == 0)
+        {
+            _calibrationConfig.reference = s;
+        }
+    }
+}
+
+void Config::readSupervisorLimits(JsonVariant sv)
+{
+    _supervisorLimits.maxSampleAge_ms = sv["maxSampleAge"] | _supervisorLimits.maxSampleAge_ms;
+    _supervisorLimits.maxTemp = sv["maxTemp"] | _supervisorLimits.maxTemp;
+    _supervisorLimits.maxDisagreement = sv["maxDisagreement"] | _supervisorLimits.maxDisagreement;
+    _supervisorLimits.runawayDuty = sv["runawayDuty"] | _supervisorLimits.runawayDuty;
+    _supervisorLimits.runawayWindow_ms = sv["runawayWindow"] | _supervisorLimits.runawayWindow_ms;
+    _supervisorLimits.runawayMinRise = sv["runawayMinRise"] | _supervisorLimits.runawayMinRise;
+    _supervisorLimits.runawayMargin = sv["runawayMargin"] | _supervisorLimits.runawayMargin;
+
+    // e.g. "channels": ["tc1", "tc2", "lmt85"]
+    if (!sv["channels"].isNull())
+    {
+        _supervisorLimits.requiredChannels = 0;
+        for (JsonVariant channel : sv["channels"].as<JsonArray>())
+        {
+            const char *name = channel | "";
+            if (strcmp(name, "tc1") == 0)
+            {
+                _supervisorLimits.requiredChannels |= 1 << SUPERVISOR_TC1;
+            }
+            else if (strcmp(name, "tc2") == 0)
+            {
+                _supervisorLimits.requiredChannels |= 1 << SUPERVISOR_TC2;
+            }
+            else if (strcmp(name, "lmt85") == 0)
+            {
+                _supervisorLimits.requiredChannels |= 1 << SUPERVISOR_LMT85;
+            }
+        }
+    }
+}
+
+void Config::copyString(char *dest, size_t size, const char *src)
+{
+    strncpy(dest, src, size - 1);
+    dest[size - 1] = '\0';
 }
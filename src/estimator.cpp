@@ -0,0 +1,229 @@
+#include <math.h>
+#include "estimator.hpp"
+
+Estimator::Estimator()
+    : _model(defaultPlateModel),
+      _a(1.0f),
+      _b(0.0f),
+      _tc2Lag(30.0),
+      _lmt85Lag(60.0),
+      _delaySteps(0),
+      _dutyIdx(0),
+      _delayedDuty(0.0f),
+      _tc1Var(0.25f),
+      _tc2Var(1.0f),
+      _lmt85Var(1.0f),
+      _tempVar(0.0025f),
+      _biasVar(0.01f)
+{
+    begin(defaultPlateModel, 1.0, NAN);
+}
+
+void Estimator::begin(const PlateModel &model, double dt, double initialTemp)
+{
+    _model = model;
+
+    // Discretize the first order model
+    // over one control period
+    _a = expf(-dt / _model.tau);
+    _b = 1.0f - _a;
+    _lagDecay[TEMP] = 0.0f;
+    _lagDecay[BIAS] = 0.0f;
+    _lagDecay[TC2_NODE] = _tc2Lag > 0.0 ? expf(-dt / _tc2Lag) : 0.0f;
+    _lagDecay[LMT85_NODE] = _lmt85Lag > 0.0 ? expf(-dt / _lmt85Lag) : 0.0f;
+
+    _delaySteps = (int)(_model.deadTime / dt + 0.5);
+    if (_delaySteps >= maxDelaySteps)
+    {
+        _delaySteps = maxDelaySteps - 1;
+    }
+    for (int i = 0; i < maxDelaySteps; i++)
+    {
+        _dutyHistory[i] = 0.0f;
+    }
+    _dutyIdx = 0;
+    _delayedDuty = 0.0f;
+
+    float temp = isnan(initialTemp) ? _model.ambient : initialTemp;
+    _x[TEMP] = temp;
+    _x[BIAS] = 0.0f;
+    _x[TC2_NODE] = temp;
+    _x[LMT85_NODE] = temp;
+    for (int i = 0; i < STATES; i++)
+    {
+        for (int j = 0; j < STATES; j++)
+        {
+            _p[i][j] = i == j ? 100.0f : 0.0f;
+        }
+    }
+
+    resetNoiseStats();
+}
+
+void Estimator::setNoise(double tc1Var, double tc2Var, double lmt85Var, double tempVar, double biasVar)
+{
+    _tc1Var = tc1Var;
+    _tc2Var = tc2Var;
+    _lmt85Var = lmt85Var;
+    _tempVar = tempVar;
+    _biasVar = biasVar;
+}
+
+void Estimator::setLags(double tc2Lag, double lmt85Lag)
+{
+    _tc2Lag = tc2Lag;
+    _lmt85Lag = lmt85Lag;
+}
+
+void Estimator::update(double duty, double tc1, double tc2, double lmt85)
+{
+    // Delay the duty by the model's
+    // dead time
+    _dutyHistory[_dutyIdx] = duty;
+    _delayedDuty = _dutyHistory[(_dutyIdx + maxDelaySteps - _delaySteps) % maxDelaySteps];
+    _dutyIdx = (_dutyIdx + 1) % maxDelaySteps;
+
+    // Predict. F is the plate model in
+    // the first row, the bias held, and
+    // each node moving towards the plate:
+    //
+    //   [a b 0  0 ]
+    //   [0 1 0  0 ]
+    //   [c 0 d2 0 ]
+    //   [c 0 0  d3]
+    //
+    // with c = 1 - d for its node
+    float f[STATES][STATES] = {};
+    f[TEMP][TEMP] = _a;
+    f[TEMP][BIAS] = _b;
+    f[BIAS][BIAS] = 1.0f;
+    for (int n = TC2_NODE; n < STATES; n++)
+    {
+        f[n][TEMP] = 1.0f - _lagDecay[n];
+        f[n][n] = _lagDecay[n];
+    }
+
+    float x[STATES];
+    for (int i = 0; i < STATES; i++)
+    {
+        x[i] = 0.0f;
+        for (int k = 0; k < STATES; k++)
+        {
+            x[i] += f[i][k] * _x[k];
+        }
+    }
+    x[TEMP] += _b * (_model.ambient + _model.gain * _delayedDuty);
+
+    // P = F P F' + Q
+    float fp[STATES][STATES];
+    for (int i = 0; i < STATES; i++)
+    {
+        for (int j = 0; j < STATES; j++)
+        {
+            fp[i][j] = 0.0f;
+            for (int k = 0; k < STATES; k++)
+            {
+                fp[i][j] += f[i][k] * _p[k][j];
+            }
+        }
+    }
+    for (int i = 0; i < STATES; i++)
+    {
+        _x[i] = x[i];
+        for (int j = 0; j < STATES; j++)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < STATES; k++)
+            {
+                sum += fp[i][k] * f[j][k];
+            }
+            _p[i][j] = sum;
+        }
+    }
+    _p[TEMP][TEMP] += _tempVar;
+    _p[BIAS][BIAS] += _biasVar;
+    _p[TC2_NODE][TC2_NODE] += _tempVar;
+    _p[LMT85_NODE][LMT85_NODE] += _tempVar;
+
+    // Correct with each sensor in turn:
+    // TC1 measures the plate, the others
+    // their node
+    if (!isnan(tc1))
+    {
+        correct(TEMP, tc1, _tc1Var);
+    }
+    if (!isnan(tc2))
+    {
+        correct(TC2_NODE, tc2, _tc2Var);
+    }
+    if (!isnan(lmt85))
+    {
+        correct(LMT85_NODE, lmt85, _lmt85Var);
+    }
+
+    // Track noise of TC1 against the
+    // estimate
+    if (!isnan(tc1))
+    {
+        if (!isnan(_lastRaw))
+        {
+            double rawDiff = tc1 - _lastRaw;
+            double estDiff = _x[TEMP] - _lastEst;
+
+            _noiseCount++;
+            double delta = rawDiff - _rawMean;
+            _rawMean += delta / _noiseCount;
+            _rawM2 += delta * (rawDiff - _rawMean);
+            delta = estDiff - _estMean;
+            _estMean += delta / _noiseCount;
+            _estM2 += delta * (estDiff - _estMean);
+        }
+        _lastRaw = tc1;
+        _lastEst = _x[TEMP];
+    }
+}
+
+void Estimator::correct(int state, double measurement, double variance)
+{
+    // H picks out one state, so the gain
+    // is that state's column of P
+    float y = measurement - _x[state];
+    float s = _p[state][state] + variance;
+    float k[STATES];
+    float row[STATES];
+    for (int i = 0; i < STATES; i++)
+    {
+        k[i] = _p[i][state] / s;
+        row[i] = _p[state][i];
+    }
+
+    for (int i = 0; i < STATES; i++)
+    {
+        _x[i] += k[i] * y;
+        for (int j = 0; j < STATES; j++)
+        {
+            _p[i][j] -= k[i] * row[j];
+        }
+    }
+}
+
+double Estimator::getNoiseReduction() const
+{
+    if (_noiseCount < 2 || _estM2 <= 0.0)
+    {
+        return 1.0;
+    }
+
+    return sqrt(_rawM2 / _estM2);
+}
+
+void Estimator::resetNoiseStats()
+{
+    _lastRaw = NAN;
+    _lastEst = NAN;
+    _noiseCount = 0;
+    _rawMean = 0.0;
+    _rawM2 = 0.0;
+    _estMean = 0.0;
+    _estM2 = 0.0;
+}
@@ -0,0 +1,77 @@
+#include "gain_schedule.hpp"
+
+bool GainSchedule::add(const GainScheduleEntry &entry)
+{
+    if (_numEntries >= maxEntries)
+    {
+        return false;
+    }
+
+    _entries[_numEntries++] = entry;
+
+    return true;
+}
+
+int GainSchedule::select(double setpoint, double slope) const
+{
+    ProfilePhase phase = phaseOf(slope);
+    for (int i = 0; i < _numEntries; i++)
+    {
+        const GainScheduleEntry &entry = _entries[i];
+        if (setpoint <= entry.upTo && (entry.phase == PHASE_ANY || entry.phase == phase))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+ProfilePhase GainSchedule::phaseOf(double slope)
+{
+    if (slope > holdingSlope)
+    {
+        return PHASE_RISING;
+    }
+    if (slope < -holdingSlope)
+    {
+        return PHASE_FALLING;
+    }
+
+    return PHASE_HOLDING;
+}
+
+const char *GainSchedule::getPhaseName(ProfilePhase phase)
+{
+    switch (phase)
+    {
+    case PHASE_RISING:
+        return "rising";
+    case PHASE_HOLDING:
+        return "holding";
+    case PHASE_FALLING:
+        return "falling";
+    default:
+        return "any";
+    }
+}
+
+void switchGains(PID &pid, double &output, double input, double setpoint, const PidGains &gains)
+{
+    if (pid.GetMode() != AUTOMATIC)
+    {
+        pid.SetTunings(gains.kp, gains.ki, gains.kd);
+        return;
+    }
+
+    // Re-initializing seeds the integral
+    // from output; seed it with whatever
+    // makes the next Compute() land on the
+    // current output under the new Kp
+    double lastOutput = output;
+    pid.SetMode(MANUAL);
+    pid.SetTunings(gains.kp, gains.ki, gains.kd);
+    output = lastOutput - gains.kp * (setpoint - input);
+    pid.SetMode(AUTOMATIC);
+    output = lastOutput;
+}
@@ -0,0 +1,280 @@
+#include <Arduino.h>
+#include <driver/ledc.h>
+#include "heater.hpp"
+
+// PWM outputs all run off one LEDC
+// timer
+static const ledc_mode_t heaterSpeedMode = LEDC_HIGH_SPEED_MODE;
+static const ledc_timer_t heaterTimer = LEDC_TIMER_0;
+
+// Sigma-delta duty scale
+static const uint32_t sigmaDeltaOne = 1 << 16;
+
+HeaterConfig HeaterOutput::_config = defaultHeaterConfig;
+volatile bool HeaterOutput::_inhibit = false;
+HeaterOutput *HeaterOutput::_outputs[HeaterOutput::maxOutputs];
+int HeaterOutput::_numOutputs = 0;
+esp_timer_handle_t HeaterOutput::_timer = NULL;
+bool HeaterOutput::_timerStopped = false;
+uint32_t HeaterOutput::_tickCount = 0;
+
+HeaterOutput::HeaterOutput()
+    : _pin(-1),
+      _channel(0),
+      _phase(0),
+      _duty(0.0),
+      _lastWrite_us(0),
+      _pinOn(false),
+      _level(0),
+      _accumulator(0) {}
+
+bool HeaterOutput::beginShared(const HeaterConfig &config)
+{
+    _config = config;
+
+    if (_config.mode == HEATER_PWM)
+    {
+        ledc_timer_config_t timerConfig = {};
+        timerConfig.speed_mode = heaterSpeedMode;
+        timerConfig.duty_resolution = (ledc_timer_bit_t)_config.resolution;
+        timerConfig.timer_num = heaterTimer;
+        timerConfig.freq_hz = _config.freq;
+        timerConfig.clk_cfg = LEDC_AUTO_CLK;
+
+        return ledc_timer_config(&timerConfig) == ESP_OK;
+    }
+
+    // Burst and sigma-delta outputs are
+    // stepped from a periodic timer
+    if (_config.tick_ms <= 0 ||
+        (_config.mode == HEATER_BURST && _config.window_ms < _config.tick_ms))
+    {
+        return false;
+    }
+
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = onTick;
+    timerArgs.name = "heater";
+    if (esp_timer_create(&timerArgs, &_timer) != ESP_OK)
+    {
+        return false;
+    }
+
+    return esp_timer_start_periodic(_timer, _config.tick_ms * 1000) == ESP_OK;
+}
+
+const char *HeaterOutput::getModeName()
+{
+    switch (_config.mode)
+    {
+    case HEATER_BURST:
+        return "burst";
+    case HEATER_SIGMA_DELTA:
+        return "sigma-delta";
+    default:
+        return "pwm";
+    }
+}
+
+long HeaterOutput::getDutyLevels(int period_ms)
+{
+    switch (_config.mode)
+    {
+    case HEATER_BURST:
+        return _config.window_ms / _config.tick_ms + 1;
+    case HEATER_SIGMA_DELTA:
+        return period_ms / _config.tick_ms + 1;
+    default:
+        return (1L << _config.resolution) + 1;
+    }
+}
+
+int64_t HeaterOutput::getApplyDelay_us()
+{
+    if (_config.mode == HEATER_PWM)
+    {
+        return 1000000LL / _config.freq;
+    }
+    return _config.tick_ms * 1000LL;
+}
+
+void HeaterOutput::setIdle(bool idle)
+{
+    if (_timer == NULL || idle == _timerStopped)
+    {
+        return;
+    }
+
+    if (idle)
+    {
+        // Only once every output is at 0;
+        // the pins are left off, as the tick
+        // would leave them
+        for (int i = 0; i < _numOutputs; i++)
+        {
+            if (_outputs[i]->_level != 0)
+            {
+                return;
+            }
+        }
+        esp_timer_stop(_timer);
+        for (int i = 0; i < _numOutputs; i++)
+        {
+            _outputs[i]->writePin(false);
+        }
+        _timerStopped = true;
+        return;
+    }
+
+    _timerStopped = false;
+    esp_timer_start_periodic(_timer, _config.tick_ms * 1000);
+}
+
+bool HeaterOutput::begin(int pin, int channel, double phase)
+{
+    // Ensure heater is off before the
+    // pin is handed to the output
+    _pin = pin;
+    _channel = channel;
+    pinMode(_pin, OUTPUT);
+    digitalWrite(_pin, LOW);
+    _pinOn = false;
+
+    if (_config.mode == HEATER_PWM)
+    {
+        _phase = phase * (1 << _config.resolution);
+
+        ledc_channel_config_t channelConfig = {};
+        channelConfig.gpio_num = _pin;
+        channelConfig.speed_mode = heaterSpeedMode;
+        channelConfig.channel = (ledc_channel_t)_channel;
+        channelConfig.intr_type = LEDC_INTR_DISABLE;
+        channelConfig.timer_sel = heaterTimer;
+        channelConfig.duty = 0;
+        channelConfig.hpoint = _phase;
+
+        return ledc_channel_config(&channelConfig) == ESP_OK;
+    }
+
+    if (_numOutputs == maxOutputs)
+    {
+        return false;
+    }
+
+    // Burst phase is an offset in ticks
+    // into the window; sigma-delta phase
+    // seeds the accumulator so outputs
+    // don't fire on the same tick
+    if (_config.mode == HEATER_BURST)
+    {
+        _phase = phase * (_config.window_ms / _config.tick_ms);
+    }
+    else
+    {
+        _accumulator = phase * sigmaDeltaOne;
+    }
+    _outputs[_numOutputs++] = this;
+
+    return true;
+}
+
+void HeaterOutput::setDuty(double duty)
+{
+    if (duty < 0.0)
+    {
+        duty = 0.0;
+    }
+    else if (duty > 1.0)
+    {
+        duty = 1.0;
+    }
+    _duty = duty;
+
+    if (_inhibit)
+    {
+        duty = 0.0;
+    }
+
+    switch (_config.mode)
+    {
+    case HEATER_BURST:
+        _level = duty * (_config.window_ms / _config.tick_ms) + 0.5;
+        break;
+    case HEATER_SIGMA_DELTA:
+        _level = duty * sigmaDeltaOne + 0.5;
+        break;
+    default:
+    {
+        // A duty of the full period keeps
+        // the output high continuously
+        uint32_t counts = duty * (1 << _config.resolution) + 0.5;
+        ledc_set_duty_with_hpoint(heaterSpeedMode, (ledc_channel_t)_channel, counts, _phase);
+        ledc_update_duty(heaterSpeedMode, (ledc_channel_t)_channel);
+        break;
+    }
+    }
+    if (_level != 0)
+    {
+        setIdle(false);
+    }
+
+    _lastWrite_us = esp_timer_get_time();
+}
+
+void HeaterOutput::forceOff()
+{
+    if (_config.mode == HEATER_PWM)
+    {
+        ledc_set_duty_with_hpoint(heaterSpeedMode, (ledc_channel_t)_channel, 0, _phase);
+        ledc_update_duty(heaterSpeedMode, (ledc_channel_t)_channel);
+    }
+    else
+    {
+        _level = 0;
+        digitalWrite(_pin, LOW);
+        _pinOn = false;
+    }
+}
+
+void HeaterOutput::onTick(void *)
+{
+    _tickCount++;
+    for (int i = 0; i < _numOutputs; i++)
+    {
+        _outputs[i]->tick(_tickCount);
+    }
+}
+
+void HeaterOutput::tick(uint32_t tickCount)
+{
+    bool on = false;
+
+    if (!_inhibit)
+    {
+        if (_config.mode == HEATER_BURST)
+        {
+            uint32_t windowTicks = _config.window_ms / _config.tick_ms;
+            on = ((tickCount + _phase) % windowTicks) < _level;
+        }
+        else
+        {
+            _accumulator += _level;
+            if (_accumulator >= sigmaDeltaOne)
+            {
+                _accumulator -= sigmaDeltaOne;
+                on = true;
+            }
+        }
+    }
+
+    writePin(on);
+}
+
+void HeaterOutput::writePin(bool on)
+{
+    if (on != _pinOn)
+    {
+        digitalWrite(_pin, on ? HIGH : LOW);
+        _pinOn = on;
+    }
+}
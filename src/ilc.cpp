@@ -0,0 +1,153 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "ilc.hpp"
+
+// File layout: header, then numBins
+// floats of correction
+struct IlcFileHeader
+{
+    uint32_t magic;
+    int32_t binMs;
+    int32_t numBins;
+    int32_t runs;
+    float rmsError;
+};
+
+static const uint32_t ilcMagic = 0x31434c49; // "ILC1"
+
+Ilc::Ilc()
+    : _config(defaultIlcConfig),
+      _numBins(0),
+      _runs(0),
+      _prevRmsError(0.0),
+      _sumSqError(0.0),
+      _ticks(0)
+{
+    _path[0] = '\0';
+}
+
+void Ilc::begin(const IlcConfig &config)
+{
+    _config = config;
+}
+
+void Ilc::load(const char *profileName, const char *zoneName, unsigned long duration)
+{
+    snprintf(_path, sizeof(_path), "/ilc/%s-%s.bin", profileName, zoneName);
+    _numBins = (duration + binMs - 1) / binMs;
+    if (_numBins > maxBins)
+    {
+        _numBins = maxBins;
+    }
+
+    _runs = 0;
+    _prevRmsError = 0.0;
+    for (int i = 0; i < _numBins; i++)
+    {
+        _correction[i] = 0.0;
+        _errorSum[i] = 0.0;
+        _errorCount[i] = 0;
+    }
+    _sumSqError = 0.0;
+    _ticks = 0;
+
+    File file = LittleFS.open(_path, "r");
+    if (!file)
+    {
+        return;
+    }
+
+    // A correction learned against a
+    // different time base is useless;
+    // start over
+    IlcFileHeader header;
+    size_t correctionSize = _numBins * sizeof(float);
+    if (file.readBytes((char *)&header, sizeof(header)) == sizeof(header) &&
+        header.magic == ilcMagic &&
+        header.binMs == binMs &&
+        header.numBins == _numBins &&
+        file.readBytes((char *)_correction, correctionSize) == correctionSize)
+    {
+        _runs = header.runs;
+        _prevRmsError = header.rmsError;
+    }
+    else
+    {
+        for (int i = 0; i < _numBins; i++)
+        {
+            _correction[i] = 0.0;
+        }
+    }
+    file.close();
+}
+
+bool Ilc::save()
+{
+    File file = LittleFS.open(_path, "w", true);
+    if (!file)
+    {
+        return false;
+    }
+
+    IlcFileHeader header;
+    header.magic = ilcMagic;
+    header.binMs = binMs;
+    header.numBins = _numBins;
+    header.runs = _runs;
+    header.rmsError = getRmsError();
+
+    size_t correctionSize = _numBins * sizeof(float);
+    bool ok = file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+              file.write((const uint8_t *)_correction, correctionSize) == correctionSize;
+    file.close();
+
+    return ok;
+}
+
+void Ilc::learn()
+{
+    int leadBins = _config.lead * 1000 / binMs + 0.5;
+
+    // Add the error the plate shows lead
+    // seconds later to each bin; bins the
+    // run never reached keep their
+    // correction
+    for (int i = 0; i < _numBins; i++)
+    {
+        int e = i + leadBins < _numBins ? i + leadBins : _numBins - 1;
+        if (_errorCount[e] > 0)
+        {
+            _correction[i] += _config.gain * _errorSum[e] / _errorCount[e];
+        }
+    }
+
+    // Low pass the correction so bin to
+    // bin noise doesn't build up over
+    // runs, then clamp it. prev holds the
+    // unfiltered neighbour.
+    float prev = _correction[0];
+    for (int i = 0; i < _numBins; i++)
+    {
+        float next = i + 1 < _numBins ? _correction[i + 1] : _correction[i];
+        float current = _correction[i];
+        float filtered = 0.25 * prev + 0.5 * current + 0.25 * next;
+        prev = current;
+
+        if (filtered > _config.maxCorrection)
+        {
+            filtered = _config.maxCorrection;
+        }
+        else if (filtered < -_config.maxCorrection)
+        {
+            filtered = -_config.maxCorrection;
+        }
+        _correction[i] = filtered;
+    }
+
+    _runs++;
+}
+
+double Ilc::getRmsError() const
+{
+    return _ticks > 0 ? sqrt(_sumSqError / _ticks) : 0.0;
+}
@@ -0,0 +1,233 @@
+#include "lmt85.hpp"
+
+const int lmt85Lookup[] = {301, 150,
+                           310, 149,
+                           319, 148,
+                           328, 147,
+                           337, 146,
+                           346, 145,
+                           354, 144,
+                           363, 143,
+                           372, 142,
+                           381, 141,
+                           390, 140,
+                           399, 139,
+                           408, 138,
+                           416, 137,
+                           425, 136,
+                           434, 135,
+                           443, 134,
+                           452, 133,
+                           460, 132,
+                           469, 131,
+                           478, 130,
+                           487, 129,
+                           495, 128,
+                           504, 127,
+                           513, 126,
+                           521, 125,
+                           530, 124,
+                           539, 123,
+                           547, 122,
+                           556, 121,
+                           565, 120,
+                           573, 119,
+                           582, 118,
+                           591, 117,
+                           599, 116,
+                           608, 115,
+                           617, 114,
+                           625, 113,
+                           634, 112,
+                           642, 111,
+                           651, 110,
+                           660, 109,
+                           668, 108,
+                           677, 107,
+                           685, 106,
+                           694, 105,
+                           702, 104,
+                           711, 103,
+                           720, 102,
+                           728, 101,
+                           737, 100,
+                           745, 99,
+                           754, 98,
+                           762, 97,
+                           771, 96,
+                           779, 95,
+                           788, 94,
+                           797, 93,
+                           805, 92,
+                           814, 91,
+                           822, 90,
+                           831, 89,
+                           839, 88,
+                           848, 87,
+                           856, 86,
+                           865, 85,
+                           873, 84,
+                           881, 83,
+                           890, 82,
+                           898, 81,
+                           907, 80,
+                           915, 79,
+                           924, 78,
+                           932, 77,
+                           941, 76,
+                           949, 75,
+                           957, 74,
+                           966, 73,
+                           974, 72,
+                           983, 71,
+                           991, 70,
+                           1000, 69,
+                           1008, 68,
+                           1017, 67,
+                           1025, 66,
+                           1034, 65,
+                           1042, 64,
+                           1051, 63,
+                           1059, 62,
+                           1067, 61,
+                           1076, 60,
+                           1084, 59,
+                           1093, 58,
+                           1101, 57,
+                           1109, 56,
+                           1118, 55,
+                           1126, 54,
+                           1134, 53,
+                           1143, 52,
+                           1151, 51,
+                           1159, 50,
+                           1167, 49,
+                           1176, 48,
+                           1184, 47,
+                           1192, 46,
+                           1201, 45,
+                           1209, 44,
+                           1217, 43,
+                           1225, 42,
+                           1234, 41,
+                           1242, 40,
+                           1250, 39,
+                           1258, 38,
+                           1267, 37,
+                           1275, 36,
+                           1283, 35,
+                           1291, 34,
+                           1299, 33,
+                           1308, 32,
+                           1316, 31,
+                           1324, 30,
+                           1332, 29,
+                           1340, 28,
+                           1348, 27,
+                           1356, 26,
+                           1365, 25,
+                           1373, 24,
+                           1381, 23,
+                           1389, 22,
+                           1397, 21,
+                           1405, 20,
+                           1413, 19,
+                           1421, 18,
+                           1430, 17,
+                           1438, 16,
+                           1446, 15,
+                           1454, 14,
+                           1462, 13,
+                           1470, 12,
+                           1478, 11,
+                           1486, 10,
+                           1494, 9,
+                           1502, 8,
+                           1511, 7,
+                           1519, 6,
+                           1527, 5,
+                           1535, 4,
+                           1543, 3,
+                           1551, 2,
+                           1559, 1,
+                           1567, 0,
+                           1575, -1,
+                           1583, -2,
+                           1591, -3,
+                           1599, -4,
+                           1607, -5,
+                           1615, -6,
+                           1623, -7,
+                           1631, -8,
+                           1639, -9,
+                           1648, -10,
+                           1656, -11,
+                           1663, -12,
+                           1671, -13,
+                           1679, -14,
+                           1687, -15,
+                           1695, -16,
+                           1703, -17,
+                           1711, -18,
+                           1719, -19,
+                           1727, -20,
+                           1735, -21,
+                           1743, -22,
+                           1751, -23,
+                           1759, -24,
+                           1767, -25,
+                           1775, -26,
+                           1783, -27,
+                           1790, -28,
+                           1798, -29,
+                           1806, -30,
+                           1814, -31,
+                           1822, -32,
+                           1830, -33,
+                           1838, -34,
+                           1845, -35,
+                           1853, -36,
+                           1861, -37,
+                           1869, -38,
+                           1877, -39,
+                           1885, -40,
+                           1892, -41,
+                           1900, -42,
+                           1908, -43,
+                           1915, -44,
+                           1921, -45,
+                           1928, -46,
+                           1935, -47,
+                           1942, -48,
+                           1949, -49,
+                           1955, -50,
+                           0, 0};
+
+double getLMT85Temp(double lmt85_mV)
+{
+    int idx = -1;
+    int lastValue = -10000;
+    for (int i = 0; lmt85Lookup[i] != 0; i += 2)
+    {
+        lastValue = lmt85Lookup[i + 1];
+        if (lmt85Lookup[i] > lmt85_mV)
+        {
+            idx = i;
+            break;
+        }
+    }
+
+    if (idx == 0)
+    {
+        // Too low; return lowest value
+        return lmt85Lookup[1];
+    }
+
+    if (idx == -1)
+    {
+        // Too high; return highest value
+        return lastValue;
+    }
+
+    return lmt85Lookup[idx - 1] - ((lmt85_mV - lmt85Lookup[idx - 2]) / (lmt85Lookup[idx] - lmt85Lookup[idx - 2]));
+}
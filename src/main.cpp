@@ -9,15 +9,44 @@
 #include <ESPAsyncWebServer.h>
 #include <Adafruit_MAX31855.h>
 #include <LittleFS.h>
+#include <lwip/sockets.h>
+#include <esp_heap_caps.h>
+#include <esp_pm.h>
 
+#include "calibration.hpp"
+#include "calibration_store.hpp"
+#include "commands.hpp"
 #include "config.hpp"
+#include "connections.hpp"
 #include "data.hpp"
-
-struct ReflowCurvePoint
-{
-    int time_ms;
-    int temp_c;
-};
+#include "decimator.hpp"
+#include "energy.hpp"
+#include "estimator.hpp"
+#include "heater.hpp"
+#include "idle.hpp"
+#include "ilc.hpp"
+#include "gain_schedule.hpp"
+#include "latency.hpp"
+#include "lmt85.hpp"
+#include "max31855.hpp"
+#include "metrics.hpp"
+#include "model_store.hpp"
+#include "mpc.hpp"
+#include "profile.hpp"
+#include "ripple.hpp"
+#include "run_state.hpp"
+#include "run_stats.hpp"
+#include "sample_average.hpp"
+#include "spsc_queue.hpp"
+#include "supervisor.hpp"
+#include "system_id.hpp"
+#include "telemetry.hpp"
+#include "thermocouple.hpp"
+#include "trajectory.hpp"
+#include "zone.hpp"
+
+// Built-in profile; others can be
+// loaded from /profiles/<name>.json
 ReflowCurvePoint chipQuikCurve[] = {
     {0, 25},
     {90000, 90},
@@ -27,11 +56,29 @@ ReflowCurvePoint chipQuikCurve[] = {
     {270000, 138},
     {-1, -1},
 };
-volatile bool startReflowCurve = false;
-volatile bool cancelReflowCurve = false;
-bool reflowCurveRunning = false;
+Profile profile("chipquik", chipQuikCurve);
 unsigned long reflowStartMillis = 0;
 
+// The profile compiled against the plate
+// model; loop() takes its setpoint from
+// here. Recompiled whenever the profile
+// or model changes.
+TrajectoryConfig trajectoryConfig = defaultTrajectoryConfig;
+Trajectory trajectory;
+
+// Run state, changed only by loop().
+// The button and the supervisor each
+// post timestamped events to their own
+// queue and notify the loop task, which
+// handles them as they arrive rather
+// than on its next tick.
+RunStateMachine runState;
+TaskHandle_t loopTaskHandle;
+const int runEventQueueSize = 8;
+SpscQueue<RunEvent, runEventQueueSize> buttonEvents;
+SpscQueue<RunEvent, runEventQueueSize> safetyEvents;
+int64_t eventLatencyMax_us = 0;
+
 // Pin definitions
 #define TC_DO_PIN 19
 #define TC_CLK_PIN 18
@@ -66,11 +113,16 @@ Data data;
 // to the i2c bus
 SemaphoreHandle_t i2cMutex;
 
-// Objects to communicate with
-// thermocouple amplifiers
-// (MAX31855) via SPI
-Adafruit_MAX31855 thermocouple1(TC_CLK_PIN, TC1_CS_PIN, TC_DO_PIN);
-Adafruit_MAX31855 thermocouple2(TC_CLK_PIN, TC2_CS_PIN, TC_DO_PIN);
+// Thermocouple amplifiers (MAX31855)
+// on the VSPI bus
+SPIClass tcSpi(VSPI);
+Max31855Bus tcBus(tcSpi, TC_CLK_PIN, TC_DO_PIN);
+int tc1Chip;
+int tc2Chip;
+
+// Time taken by the last read of both
+// thermocouples
+volatile int32_t tcRead_us = 0;
 
 // The delay between each iteration
 // of the loop() function. This
@@ -78,25 +130,43 @@ Adafruit_MAX31855 thermocouple2(TC_CLK_PIN, TC2_CS_PIN, TC_DO_PIN);
 // PID controller (ms)
 const int loopDelay = 100;
 
-// Thermocouple reader task
+// Thermocouple reader task. Its stack
+// holds the SPI read, two averages, the
+// K-type correction, calibration and
+// idle bookkeeping; the memory report
+// shows how much of it is left.
 TaskHandle_t tcTaskHandle;
+const int tcTaskStack = 2048;
 const int tcNumSamplesToAvg = 4;
 const int tcDelay = loopDelay / tcNumSamplesToAvg;
 
-// LMT85 reader task
+// LMT85 reader task. The ADC scans
+// AIN0 eight times per read; eight of
+// those bursts per control tick are
+// decimated into one reading with 3
+// more bits (0.5 mV / 8 per count)
 TaskHandle_t lmt85TaskHandle;
-const int lmt85NumSamplesToAvg = 4;
-const int lmt85Delay = loopDelay / lmt85NumSamplesToAvg;
+const int lmt85BurstSize = 8;
+const int lmt85BurstsPerReading = 8;
+const int lmt85Delay = loopDelay / lmt85BurstsPerReading;
+
+// Readings between reports of the noise
+// and I2C time behind them (1 min)
+const int lmt85ReportReadings = 600;
 
 // OLED display
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, -1);
 TaskHandle_t updateDisplayTaskHandle;
 int displayRefreshPeriod = 500;
 
-// GPIO0 button
+// GPIO0 button. Presses act on release
+// so a long press can start plate
+// characterization.
 esp_timer_handle_t btnTimer;
 esp_timer_create_args_t btnTimerArgs;
 const int debounceTime_us = 25000;
+const int64_t longPressTime_us = 2000000;
+volatile int64_t btnPressTime_us = 0;
 const int lowTemp = 0;
 const int highTemp = 150;
 
@@ -105,35 +175,267 @@ volatile double pendingSetpoint = lowTemp;
 double Kp = 500.0;
 double Ki = 0.625;
 double Kd = 1.0;
-double pidInput = 0.0;
-double pidOutput = 0.0;
-double pidSetpoint = 0.0;
-PID pid(&pidInput, &pidOutput, &pidSetpoint, Kp, Ki, Kd, DIRECT);
 
-// setting PWM properties
-const int freq = 15;
-const int ledChannel = 0;
-const int resolution = 12;
-
-// CSV server
+// PID output range. The heater output
+// mode, frequency and resolution come
+// from "heater" in config.json; the
+// PID always works on this scale.
+const int pidOutputMax = 4095;
+
+// Heater zones. Each zone has its own
+// FET pin, output channel (0-7), input
+// sensor, offset from the reflow curve
+// and PID state
+Zone zones[] = {
+    {"Plate", FET_PIN, 0, ZONE_SENSOR_FUSED, 0.0, Kp, Ki, Kd},
+};
+const int numZones = sizeof(zones) / sizeof(zones[0]);
+
+// Temperature ripple per zone, reported
+// with the heater output's duty
+// resolution
+RippleMeter zoneRipple[numZones];
+const int rippleReportTicks = 300;
+int rippleTicks = 0;
+
+// Optional sensor fusion; enabled with
+// "estimator": true in config.json.
+// Zones mapped to ZONE_SENSOR_FUSED read
+// TC1 directly when it is disabled.
+bool estimatorEnabled = false;
+PlateModel plateModel = defaultPlateModel;
+Estimator estimator;
+volatile float heaterDuty = 0.0;
+
+// Where the plate model says that duty
+// would settle the plate, for the
+// supervisor's runaway check
+volatile float heaterSteadyTemp = 0.0;
+
+// Plate characterization: drives the
+// heaters with a step or PRBS and fits
+// the plate model, which then replaces
+// the configured one
+SystemId systemId;
+volatile bool startCharacterization = false;
+volatile bool cancelCharacterization = false;
+volatile bool characterizationRunning = false;
+
+// Sensor calibration: holds the plate at
+// each configured setpoint and corrects
+// every sensor to the reference reading
+// taken there. The mutex serializes
+// updates from loop() and HTTP imports.
+Calibration calibration;
+Calibrator calibrator;
+CalibrationConfig calibrationConfig;
+SemaphoreHandle_t calibrationMutex;
+volatile bool calibrationRunning = false;
+volatile bool cancelCalibration = false;
+char calibrationImport[1024];
+
+// The LMT85 lookup table tops out here
+// (C)
+const double lmt85MaxTemp = 150.0;
+const int estimatorReportTicks = 100;
+int estimatorTicks = 0;
+int64_t estimatorTotal_us = 0;
+int64_t estimatorMax_us = 0;
+
+// Controller selection. MPC matrices
+// are precomputed for every zone when
+// a run starts, so the mode can be
+// switched at any time.
+ControllerMode controllerMode = CONTROLLER_PID;
+MpcConfig mpcConfig = defaultMpcConfig;
+Mpc zoneMpcs[numZones];
+RunStats zoneRunStats[numZones];
+LatencyStats zoneLatency[numZones];
+
+// Optional learning of a setpoint
+// correction per profile and zone from
+// the error of previous runs
+Ilc zoneIlcs[numZones];
+
+// Optional PID gains by setpoint and
+// profile phase; zones fall back to
+// Kp, Ki and Kd outside the schedule.
+// Index -1 is the fixed gains.
+GainSchedule gainSchedule;
+int zoneGainIdx[numZones];
+
+// Heater energy per zone, from duty and
+// the configured supply voltage and
+// heater resistance. Coast mode caps PID
+// output ahead of a profile's peaks and
+// is switched with "coast" on the CSV
+// port, so runs can be compared either
+// way.
+EnergyConfig energyConfig = defaultEnergyConfig;
+EnergyMeter zoneEnergy[numZones];
+volatile float runEnergy_J = 0.0;
+
+// Last completed run per zone with
+// coast mode off ([0]) and on ([1])
+struct EnergyRecord
+{
+    char profile[Profile::maxNameLength];
+    double energy;
+    double rmsError;
+};
+EnergyRecord lastRunEnergy[numZones][2];
+
+// Idle mode: while nothing is running,
+// the sensors, display and control loop
+// slow down and the chip may light-sleep
+// between samples. Leaving idle wakes
+// the reader tasks at once, so full rate
+// is back within one control period.
+// "idle 0" on the CSV port holds full
+// rate, to compare supply current.
+IdleConfig idleConfig = defaultIdleConfig;
+IdleTracker idleTracker;
+bool freqScalingAvailable = false;
+bool lightSleepAvailable = false;
+int cpuFreq_MHz = 240;
+
+// Lowest CPU clock WiFi runs at
+const int idleCpuFreq_MHz = 80;
+
+// Forces the next scheduleGains() to
+// apply gains, whatever it selects
+const int noGainIdx = -2;
+
+// Thermal safety supervisor. Runs at a
+// higher priority than everything else
+// and forces the heaters off within two
+// supervisor periods of a fault. Idle,
+// with the heaters off, it checks once
+// per idle thermocouple period instead.
+Supervisor supervisor;
+TaskHandle_t supervisorTaskHandle;
+const int supervisorPeriod = 10;
+volatile bool supervisorFaulted = false;
+volatile bool supervisorClearRequested = false;
+
+// CSV server. Connections are plain
+// lwIP sockets in a list sized at boot,
+// and frames are formatted into a buffer
+// reserved at boot. Each tick's row is
+// formatted once, after room for the
+// per-client time column.
 const int csvServerPort = 2112;
 TaskHandle_t csvServerTaskHandle;
 const int csvReportingDelay = loopDelay;
-struct Connection
-{
-    WiFiClient client;
-    unsigned long zeroMillis;
-};
+ConnectionList csvConns;
+char csvFrame[512];
+
+// Clients can send line commands (see
+// commands.hpp). Those that need loop()
+// go through netCommands and are
+// answered through netReplies;
+// subscriptions are handled by the CSV
+// task itself. Between ticks the task
+// waits on the client sockets so
+// commands are read as they arrive,
+// polling for replies every
+// replyPollPeriod ms while any are
+// awaited. No more commands are in
+// flight than netReplies holds, so
+// loop() never drops a reply.
+SpscQueue<CommandRequest, runEventQueueSize> netCommands;
+SpscQueue<CommandReply, runEventQueueSize> netReplies;
+const int replyPollPeriod = 5;
+int awaitingReplies = 0;
+char csvClientFrame[512];
+int commandCount = 0;
+int64_t commandTotal_us = 0;
+int64_t commandMax_us = 0;
+
+// The client limit from config is capped
+// by free heap, at roughly one full TCP
+// send buffer plus PCB per client, and
+// by the lwIP socket count less the
+// listening socket
+const size_t csvClientBytes = 6 * 1024;
+const size_t csvHeapReserve = 48 * 1024;
+
+// Counters and gauges for fleet
+// monitoring, served as OpenMetrics
+// text at /metrics. The text is built
+// in a buffer reserved at boot.
+Metrics metrics;
+const int httpServerPort = 80;
+AsyncWebServer httpServer(httpServerPort);
+SemaphoreHandle_t metricsMutex;
+char metricsText[4096];
+
+// Serial logging after setup() goes
+// through one static buffer, since
+// Print::printf() mallocs for lines
+// over 64 bytes
+SemaphoreHandle_t logMutex;
+char logBuffer[256];
+
+// Memory telemetry; allocated blocks are
+// compared against a baseline taken at
+// the end of setup()
+TaskHandle_t memoryReportTaskHandle;
+size_t baselineAllocatedBlocks = 0;
+
+// Parse buffer for profile files
+StaticJsonDocument<2048> profileDoc;
 
 // Prototypes
 double c2f(double celsius);
 void readThermocouples(void *);
+double timeLibraryReads();
+double timeBusReads();
+void countTcFaults(int tc, uint8_t faults, Counter open);
 void readLMT85(void *);
 void updateDisplay(void *);
 void csvServer(void *);
+int csvClientLimit(int configured);
+bool sendFrame(Connection &conn, const char *frame, int len);
+void dropConnection(int i);
+int formatHeader(char *buf, size_t size, uint32_t columns);
+void waitForCsvTick(unsigned long tickStart);
+bool readCommands(Connection &conn);
+bool handleCommand(Connection &conn, int64_t received_us);
+bool sendReply(Connection &conn, CommandType type, bool ok, int64_t received_us);
+void sendReplies();
+bool runCommand(const CommandRequest &request);
+void memoryReport(void *);
+void handleMetrics(AsyncWebServerRequest *request);
+void logPrintf(const char *format, ...);
+void superviseHeaters(void *);
+SupervisorInputs readSupervisorInputs();
+void printFaults(uint32_t faults);
 void IRAM_ATTR btnHandler();
 void IRAM_ATTR btnDebounce(void *);
-double getLMT85Temp(int lmt85_mV);
+void postEvent(SpscQueue<RunEvent, runEventQueueSize> &queue, RunEventType type, int32_t arg);
+bool handleEvents();
+bool handleEvent(const RunEvent &event);
+void waitForNextTick();
+void startRun();
+void endRun(const char *result, Counter counter);
+void finishCharacterization();
+bool beginCalibration();
+void endCalibration(const char *result);
+void finishCalibration();
+void handleCalibrationExport(AsyncWebServerRequest *request);
+void handleCalibrationImport(AsyncWebServerRequest *request);
+void handleCalibrationBody(AsyncWebServerRequest *request, uint8_t *bytes, size_t len, size_t index, size_t total);
+bool loadProfile(const char *name);
+void compileProfile();
+void setControllerMode(ControllerMode mode);
+void printRunSummary(const char *result);
+void learnFromRun();
+void scheduleGains(int zone, double target, double slope);
+bool idlePeriodsFit();
+bool updateIdle();
+void setIdlePower(bool idling);
+void waitForNextSample(int period_ms, int idlePeriod_ms);
 
 void setup()
 {
@@ -145,21 +447,16 @@ void setup()
 
     Serial.println("Solder Reflow Plate Controller V1.0");
 
-    // Set up heater pin and ensure
-    // heater is off to start
-    Serial.printf("Initializing heater to off...");
-    pinMode(FET_PIN, OUTPUT);
-    digitalWrite(FET_PIN, LOW);
-    if (ledcSetup(ledChannel, freq, resolution) == 0)
+    logMutex = xSemaphoreCreateMutex();
+
+    // Ensure heaters are off to start;
+    // the outputs are configured once
+    // the config file has been read
+    Serial.printf("Initializing heaters to off...");
+    for (int i = 0; i < numZones; i++)
     {
-        Serial.printf("ledcSetup failed!");
-        while (true)
-        {
-            delay(10);
-        }
+        zones[i].holdOff();
     }
-    ledcAttachPin(FET_PIN, ledChannel);
-    ledcWrite(ledChannel, pidOutput);
     Serial.printf("done.\n");
 
     // Start LittleFS
@@ -209,6 +506,150 @@ void setup()
         Serial.printf("done.\n");
     }
 
+    // Set up heater outputs. Zone phases
+    // are staggered across the period so
+    // the zones don't all switch on at
+    // once
+    Serial.printf("Initializing heater outputs...");
+    if (!HeaterOutput::beginShared(config.getHeaterConfig()))
+    {
+        Serial.printf("heater output setup failed!");
+        while (true)
+        {
+            delay(10);
+        }
+    }
+    for (int i = 0; i < numZones; i++)
+    {
+        if (!zones[i].begin(pidOutputMax, loopDelay, (double)i / numZones))
+        {
+            Serial.printf("heater output setup for zone %s failed!", zones[i].getName());
+            while (true)
+            {
+                delay(10);
+            }
+        }
+    }
+    Serial.printf("done.\n");
+    Serial.printf("Heater output: %s, %ld duty levels per %d ms, applied within %lld us\n",
+                  HeaterOutput::getModeName(),
+                  HeaterOutput::getDutyLevels(loopDelay),
+                  loopDelay,
+                  (long long)HeaterOutput::getApplyDelay_us());
+
+    // An identified model, if there is
+    // one, overrides the configured one
+    estimatorEnabled = config.getEstimatorEnabled();
+    plateModel = config.getPlateModel();
+    bool identified = loadPlateModel(identifiedModelPath, plateModel);
+    estimator.setLags(config.getTc2Lag(), config.getLmt85Lag());
+    estimator.begin(plateModel, loopDelay / 1000.0, NAN);
+    Serial.printf("Plate model: %s (gain %.1f C, tau %.1f s, dead time %.1f s)\n",
+                  identified ? "identified" : "configured",
+                  plateModel.gain, plateModel.tau, plateModel.deadTime);
+    Serial.printf("Estimator: %s (TC2 lag %.0f s, LMT85 lag %.0f s)\n",
+                  estimatorEnabled ? "enabled" : "disabled",
+                  config.getTc2Lag(),
+                  config.getLmt85Lag());
+    systemId.begin(config.getSysIdConfig());
+
+    calibrationConfig = config.getCalibrationConfig();
+    calibrationMutex = xSemaphoreCreateMutex();
+    if (calibrationMutex == NULL)
+    {
+        Serial.println("Failed to create calibration mutex");
+        while (true)
+        {
+            delay(10);
+        }
+    }
+    if (loadCalibration(calibrationPath, calibration))
+    {
+        Serial.printf("Calibration: %d points\n", calibration.getNumPoints());
+    }
+    else
+    {
+        Serial.println("Calibration: none");
+    }
+
+    // Load the configured profile; the
+    // built-in curve is used if it can't
+    // be read
+    if (strcmp(config.getProfileName(), profile.getName()) != 0 &&
+        !loadProfile(config.getProfileName()))
+    {
+        Serial.printf("Failed to load profile %s; using %s\n", config.getProfileName(), profile.getName());
+    }
+    Serial.printf("Profile: %s (%lu s)\n", profile.getName(), profile.getDuration() / 1000);
+    trajectoryConfig = config.getTrajectoryConfig();
+    compileProfile();
+
+    mpcConfig = config.getMpcConfig();
+    setControllerMode(config.getControllerMode());
+
+    IlcConfig ilcConfig = config.getIlcConfig();
+    for (int i = 0; i < numZones; i++)
+    {
+        zoneIlcs[i].begin(ilcConfig);
+    }
+    Serial.printf("Learning: %s (gain %.2f, lead %.1f s, max correction %.1f C)\n",
+                  ilcConfig.enabled ? "enabled" : "disabled",
+                  ilcConfig.gain, ilcConfig.lead, ilcConfig.maxCorrection);
+
+    gainSchedule = config.getGainSchedule();
+    for (int i = 0; i < numZones; i++)
+    {
+        zoneGainIdx[i] = -1;
+    }
+    Serial.printf("Gain schedule: %d entries\n", gainSchedule.getNumEntries());
+
+    // No supply sense input on the board,
+    // so the voltage is as configured
+    energyConfig = config.getEnergyConfig();
+    for (int i = 0; i < numZones; i++)
+    {
+        zoneEnergy[i].begin(energyConfig);
+        lastRunEnergy[i][0].profile[0] = '\0';
+        lastRunEnergy[i][1].profile[0] = '\0';
+    }
+    Serial.printf("Energy: %.1f V supply, %.2f ohm heaters (%.0f W each), coast %s\n",
+                  energyConfig.supplyVoltage,
+                  energyConfig.heaterResistance,
+                  energyConfig.supplyVoltage * energyConfig.supplyVoltage / energyConfig.heaterResistance,
+                  energyConfig.coast ? "on" : "off");
+
+    supervisor.begin(config.getSupervisorLimits());
+
+    // Frequency scaling needs a build with
+    // power management and light sleep one
+    // with tickless idle too; probe each so
+    // idle only asks for what the build has
+    idleConfig = config.getIdleConfig();
+    if (idleConfig.enabled && !idlePeriodsFit())
+    {
+        Serial.println("Idle: sensor periods exceed the supervisor's sample age; idle disabled");
+        idleConfig.enabled = false;
+    }
+    cpuFreq_MHz = getCpuFrequencyMhz();
+    esp_pm_config_esp32_t pm;
+    pm.max_freq_mhz = cpuFreq_MHz;
+    pm.min_freq_mhz = idleCpuFreq_MHz;
+    pm.light_sleep_enable = false;
+    freqScalingAvailable = esp_pm_configure(&pm) == ESP_OK;
+    pm.light_sleep_enable = true;
+    lightSleepAvailable = freqScalingAvailable && esp_pm_configure(&pm) == ESP_OK;
+    setIdlePower(false);
+    Serial.printf("Idle: %s, CPU clock %d MHz, %d MHz idle %s, light sleep %s, tc %d ms, LMT85 %d ms, display %d ms, loop %d ms\n",
+                  idleConfig.enabled ? "enabled" : "disabled",
+                  cpuFreq_MHz,
+                  idleCpuFreq_MHz,
+                  freqScalingAvailable ? "on" : "unavailable",
+                  !idleConfig.lightSleep ? "off" : lightSleepAvailable ? "on" : "unavailable",
+                  idleConfig.tcPeriod_ms,
+                  idleConfig.lmt85Period_ms * lmt85BurstsPerReading,
+                  idleConfig.displayPeriod_ms,
+                  idleConfig.loopPeriod_ms);
+
     WiFi.begin(config.getSSID(), config.getKey());
 
     Serial.printf("Connecting to WiFi...");
@@ -219,7 +660,7 @@ void setup()
     Serial.printf("done.\n");
 
     IPAddress localAddr = WiFi.localIP();
-    Serial.printf("IP: %s\n", localAddr.toString().c_str());
+    Serial.printf("IP: %u.%u.%u.%u\n", localAddr[0], localAddr[1], localAddr[2], localAddr[3]);
 
     if (!MDNS.begin(config.getMDNS()))
     {
@@ -230,19 +671,30 @@ void setup()
         Serial.printf("mDNS: %s\n", config.getMDNS());
     }
 
-    Serial.printf("Initializing thermocouple 1...");
-    if (!thermocouple1.begin())
+    // Metrics endpoint
+    metricsMutex = xSemaphoreCreateMutex();
+    if (metricsMutex == NULL)
     {
-        Serial.println("ERROR.");
+        Serial.println("Failed to create metrics mutex");
         while (true)
         {
             delay(10);
         }
     }
-    Serial.printf("done.\n");
-
-    Serial.printf("Initializing thermocouple 2...");
-    if (!thermocouple2.begin())
+    httpServer.on("/metrics", HTTP_GET, handleMetrics);
+    httpServer.on("/calibration", HTTP_GET, handleCalibrationExport);
+    httpServer.on("/calibration", HTTP_POST, handleCalibrationImport, NULL, handleCalibrationBody);
+    httpServer.begin();
+    Serial.printf("Metrics: http://%u.%u.%u.%u:%d/metrics\n",
+                  localAddr[0], localAddr[1], localAddr[2], localAddr[3], httpServerPort);
+
+    // Before the bus takes over the pins
+    double libraryRead_us = timeLibraryReads();
+
+    Serial.printf("Initializing thermocouples...");
+    tc1Chip = tcBus.addChip(TC1_CS_PIN);
+    tc2Chip = tcBus.addChip(TC2_CS_PIN);
+    if (!tcBus.begin())
     {
         Serial.println("ERROR.");
         while (true)
@@ -251,11 +703,13 @@ void setup()
         }
     }
     Serial.printf("done.\n");
+    Serial.printf("Thermocouple pair read: %.1f us (library), %.1f us (SPI)\n",
+                  libraryRead_us, timeBusReads());
 
     // Start thermocouple reader task
     if (xTaskCreate(readThermocouples,
                     "Read TCs",
-                    1024,
+                    tcTaskStack,
                     0,
                     1,
                     &tcTaskHandle) == pdPASS)
@@ -286,7 +740,9 @@ void setup()
     Wire.begin();
     Wire.beginTransmission((uint16_t)ADC_ADDR);
     Wire.write((uint8_t)0b10100000);
-    Wire.write((uint8_t)0b01100001);
+    // Config: convert AIN0 eight times
+    // per read (SCAN = 01)
+    Wire.write((uint8_t)0b00100001);
     Wire.endTransmission();
     Serial.printf("done.\n");
 
@@ -301,7 +757,7 @@ void setup()
     // Start lmt85 reader task
     if (xTaskCreate(readLMT85,
                     "Read LMT85",
-                    2048,
+                    3072,
                     &i2cMutex,
                     1,
                     &lmt85TaskHandle) == pdPASS)
@@ -336,6 +792,10 @@ void setup()
         }
     }
 
+    // Button and supervisor events wake
+    // the loop task
+    loopTaskHandle = xTaskGetCurrentTaskHandle();
+
     // Set up on board GPIO0 button
     // Note that its interrupt will
     // be attached in btnDebounce()
@@ -354,6 +814,15 @@ void setup()
     esp_timer_start_once(btnTimer, 2000);
 
     // Start CSV server task
+    if (!csvConns.begin(csvClientLimit(config.getCsvMaxClients())))
+    {
+        Serial.println("Failed to allocate CSV connections");
+        while (true)
+        {
+            delay(10);
+        }
+    }
+    Serial.printf("CSV server: up to %d clients\n", csvConns.getMax());
     if (xTaskCreate(csvServer,
                     "CSV Server",
                     4096,
@@ -372,72 +841,342 @@ void setup()
         }
     }
 
-    // Set PID output limits based on
-    // PWM resolution, sample time based on
-    // loop delay time, and automatic mode
-    int maxForResolution = (1 << resolution) - 1;
-    Serial.printf("resolution: %d maxLimit: %d\n", resolution, maxForResolution);
-    pid.SetOutputLimits(0, maxForResolution);
-    pid.SetSampleTime(loopDelay);
-    pid.SetMode(AUTOMATIC);
+    // Start the supervisor once the sensor
+    // tasks have had time to produce
+    // their first samples
+    delay(2 * loopDelay);
+    if (xTaskCreate(superviseHeaters,
+                    "Supervisor",
+                    4096,
+                    0,
+                    configMAX_PRIORITIES - 1,
+                    &supervisorTaskHandle) == pdPASS)
+    {
+        Serial.println("Supervisor task started");
+    }
+    else
+    {
+        Serial.println("Failed to start supervisor task");
+        while (true)
+        {
+            delay(10);
+        }
+    }
+
+    // Optionally measure the fault reaction
+    // latency with an injected fault
+    if (config.getSupervisorSelfTest())
+    {
+        supervisor.inject(esp_timer_get_time());
+        delay(10 * supervisorPeriod);
+        Serial.printf("Supervisor self test: reaction latency %lld us (bound %d us)\n",
+                      (long long)supervisor.getLastLatency_us(),
+                      2 * supervisorPeriod * 1000);
+        supervisorClearRequested = true;
+    }
+
+    Serial.printf("PID maxLimit: %d zones: %d\n", pidOutputMax, numZones);
+
+    // Everything steady state needs has
+    // been allocated; from here on the
+    // allocated block count should stay
+    // flat
+    multi_heap_info_t heapInfo;
+    heap_caps_get_info(&heapInfo, MALLOC_CAP_8BIT);
+    baselineAllocatedBlocks = heapInfo.allocated_blocks;
+
+    if (config.getMemoryReportPeriod() > 0)
+    {
+        if (xTaskCreate(memoryReport,
+                        "Memory Report",
+                        2048,
+                        0,
+                        1,
+                        &memoryReportTaskHandle) == pdPASS)
+        {
+            Serial.println("Memory report task started");
+        }
+        else
+        {
+            Serial.println("Failed to start memory report task");
+        }
+    }
 }
 
 void loop()
 {
-    if (reflowCurveRunning)
+    unsigned long curveTime = 0;
+
+    if (characterizationRunning)
+    {
+        if (supervisorFaulted || cancelCharacterization)
+        {
+            cancelCharacterization = false;
+            characterizationRunning = false;
+            for (int i = 0; i < numZones; i++)
+            {
+                zones[i].off();
+            }
+            logPrintf("Characterization %s after %ld samples; model unchanged\n",
+                      supervisorFaulted ? "aborted on fault" : "cancelled",
+                      systemId.getSamples());
+        }
+        else if (systemId.isDone(millis(), data.getTc1Temp()))
+        {
+            characterizationRunning = false;
+            for (int i = 0; i < numZones; i++)
+            {
+                zones[i].off();
+            }
+            finishCharacterization();
+        }
+    }
+    else if (startCharacterization)
+    {
+        startCharacterization = false;
+        if (supervisorFaulted || runState.isRunning() || calibrationRunning)
+        {
+            logPrintf("Not starting characterization; plate busy or faulted\n");
+        }
+        else
+        {
+            systemId.start(millis());
+            characterizationRunning = true;
+            logPrintf("Starting plate characterization\n");
+        }
+    }
+
+    if (calibrationRunning)
     {
-        if (cancelReflowCurve)
+        if (supervisorFaulted || cancelCalibration)
         {
-            cancelReflowCurve = false;
-            reflowCurveRunning = false;
-            data.setSetpoint(0.0);
-            Serial.println("Canceling reflow curve");
+            endCalibration(supervisorFaulted ? "aborted on fault" : "cancelled");
         }
         else
         {
-            unsigned long curveTime = millis() - reflowStartMillis;
-            double newSetpoint = 0.0;
-            for (int i = 0; chipQuikCurve[i].time_ms != -1; i++)
+            // Raw readings; the LMT85 is out
+            // of range above its table
+            double temps[CAL_SENSOR_COUNT] = {data.getTc1Temp(), data.getTc2Temp(), data.getLmt85Temp()};
+            if (temps[CAL_SENSOR_LMT85] >= lmt85MaxTemp)
             {
-                if (curveTime < chipQuikCurve[i].time_ms)
-                {
-                    if (i > 0)
-                    {
-                        double timePct = (double)(curveTime - chipQuikCurve[i - 1].time_ms) /
-                                         (double)(chipQuikCurve[i].time_ms - chipQuikCurve[i - 1].time_ms);
-                        newSetpoint = chipQuikCurve[i - 1].temp_c +
-                                      ((chipQuikCurve[i].temp_c - chipQuikCurve[i - 1].temp_c) * timePct);
-                        break;
-                    }
-                }
+                temps[CAL_SENSOR_LMT85] = NAN;
             }
-            data.setSetpoint(newSetpoint);
-            if (newSetpoint == 0.0)
+
+            int step = calibrator.getStep();
+            double held = calibrator.getSetpoint();
+            switch (calibrator.addSample(millis(), temps))
             {
-                reflowCurveRunning = false;
-                Serial.println("Reflow curve completed");
+            case CAL_STEP_RECORDED:
+                logPrintf("Calibration: step %d/%d done at %.0f C, holding %.0f C\n",
+                          step + 1, calibrator.getNumSteps(),
+                          held, calibrator.getSetpoint());
+                data.setSetpoint(calibrator.getSetpoint());
+                break;
+            case CAL_STEP_DONE:
+                endCalibration(NULL);
+                finishCalibration();
+                break;
+            case CAL_STEP_TIMED_OUT:
+                endCalibration("timed out");
+                break;
+            default:
+                break;
             }
         }
     }
-    else
+
+    if (runState.isRunning())
+    {
+        curveTime = millis() - reflowStartMillis;
+        RunState previous = runState.getState();
+        if (runState.advance(profile, curveTime))
+        {
+            logPrintf("Run: %s -> %s at %lu s\n",
+                      RunStateMachine::getStateName(previous),
+                      RunStateMachine::getStateName(runState.getState()),
+                      curveTime / 1000);
+        }
+
+        if (runState.getState() == RUN_DONE)
+        {
+            endRun("completed", COUNTER_RUNS_COMPLETED);
+            learnFromRun();
+        }
+        else
+        {
+            data.setSetpoint(trajectory.setpointAt(curveTime));
+        }
+    }
+
+    // Read each sensor once, then compute
+    // and apply output power for every
+    // zone based on its mapped sensor.
+    // Each reading keeps its capture time
+    // so latency can be traced per stage.
+    double sensors[ZONE_SENSOR_COUNT];
+    int64_t captured_us[ZONE_SENSOR_COUNT];
+    sensors[ZONE_SENSOR_TC1] = data.getTc1Temp();
+    sensors[ZONE_SENSOR_TC2] = data.getTc2Temp();
+    sensors[ZONE_SENSOR_LMT85] = data.getLmt85Temp();
+    sensors[ZONE_SENSOR_FUSED] = sensors[ZONE_SENSOR_TC1];
+    captured_us[ZONE_SENSOR_TC1] = data.getTc1Timestamp();
+    captured_us[ZONE_SENSOR_TC2] = data.getTc2Timestamp();
+    captured_us[ZONE_SENSOR_LMT85] = data.getLmt85Timestamp();
+    captured_us[ZONE_SENSOR_FUSED] = captured_us[ZONE_SENSOR_TC1];
+    int64_t read_us = esp_timer_get_time();
+    int64_t filtered_us = read_us;
+    if (estimatorEnabled && !idleTracker.isIdle())
+    {
+        // Fuse the sensors, using the duty
+        // applied over the last period as
+        // the model input. Past the top of
+        // its table the LMT85 only says the
+        // plate is hotter than that, so it
+        // is left out.
+        double lmt85 = data.getLmt85_mV() > lmt85Min_mV ? sensors[ZONE_SENSOR_LMT85] : NAN;
+        int64_t estimatorStart = esp_timer_get_time();
+        estimator.update(heaterDuty,
+                         sensors[ZONE_SENSOR_TC1],
+                         sensors[ZONE_SENSOR_TC2],
+                         lmt85);
+        filtered_us = esp_timer_get_time();
+        int64_t estimatorTime = filtered_us - estimatorStart;
+
+        // The estimate is only as fresh as
+        // the oldest reading fused into it
+        sensors[ZONE_SENSOR_FUSED] = estimator.getTemp();
+        captured_us[ZONE_SENSOR_FUSED] = std::min(captured_us[ZONE_SENSOR_TC1], captured_us[ZONE_SENSOR_TC2]);
+        if (!isnan(lmt85))
+        {
+            captured_us[ZONE_SENSOR_FUSED] = std::min(captured_us[ZONE_SENSOR_FUSED], captured_us[ZONE_SENSOR_LMT85]);
+        }
+        data.setEstimate(estimator.getTemp(), estimator.getRate());
+
+        // Report CPU cost and noise reduction
+        estimatorTotal_us += estimatorTime;
+        if (estimatorTime > estimatorMax_us)
+        {
+            estimatorMax_us = estimatorTime;
+        }
+        if (++estimatorTicks == estimatorReportTicks)
+        {
+            logPrintf("Estimator: %.1f us/tick avg, %lld us max, noise reduction %.2fx\n",
+                      (double)estimatorTotal_us / estimatorTicks,
+                      (long long)estimatorMax_us,
+                      estimator.getNoiseReduction());
+            estimator.resetNoiseStats();
+            estimatorTicks = 0;
+            estimatorTotal_us = 0;
+            estimatorMax_us = 0;
+        }
+    }
+
+    // Characterization overrides every
+    // zone with the excitation duty and
+    // feeds the fit
+    double excitation = 0.0;
+    if (characterizationRunning)
+    {
+        unsigned long now = millis();
+        excitation = systemId.dutyAt(now);
+        systemId.addSample(now, excitation, sensors[ZONE_SENSOR_TC1], sensors[ZONE_SENSOR_LMT85]);
+    }
+
+    double setpoint = data.getSetpoint();
+    double dutySum = 0.0;
+    double energySum = 0.0;
+    TickTiming slowest = {};
+    for (int i = 0; i < numZones; i++)
+    {
+        double input = sensors[zones[i].getSensor()];
+
+        // What the zone should track, and
+        // the learned correction applied on
+        // top of it during a run
+        double target = setpoint > 0.0 ? setpoint + zones[i].getProfileOffset() : 0.0;
+        bool running = runState.isRunning();
+        bool learning = running && setpoint > 0.0 && zoneIlcs[i].isEnabled();
+        double correction = learning ? zoneIlcs[i].correctionAt(curveTime) : 0.0;
+
+        int64_t computeStart = esp_timer_get_time();
+        if (characterizationRunning)
+        {
+            zones[i].updateManual(input, 0.0, excitation * zones[i].getMaxDuty());
+        }
+        else if (controllerMode == CONTROLLER_MPC && running)
+        {
+            double duty = zoneMpcs[i].compute(input, trajectory, curveTime, zones[i].getProfileOffset() + correction);
+            zones[i].updateManual(input, setpoint, duty * zones[i].getMaxDuty());
+        }
+        else
+        {
+            bool coasting = running && isCoasting(energyConfig, profile, curveTime);
+            zones[i].setTrim(coasting ? energyConfig.coastScale : 1.0);
+            scheduleGains(i, target, running ? trajectory.slopeAt(curveTime) : 0.0);
+            zones[i].update(input, setpoint + correction);
+        }
+        long computeTime = esp_timer_get_time() - computeStart;
+
+        // The supervisor's inhibit holds the
+        // FETs off whatever the duty
+        double applied = HeaterOutput::isInhibited() ? 0.0 : zones[i].getHeater().getDuty();
+        zoneEnergy[i].add(esp_timer_get_time(), applied);
+
+        TickTiming timing;
+        timing.capture_us = captured_us[zones[i].getSensor()];
+        timing.read_us = read_us;
+        timing.filtered_us = filtered_us;
+        timing.computed_us = zones[i].getComputed_us();
+        timing.actuated_us = zones[i].getHeater().getLastWrite_us();
+        if (i == 0 || timing.actuated_us - timing.capture_us > slowest.actuated_us - slowest.capture_us)
+        {
+            slowest = timing;
+        }
+
+        if (running)
+        {
+            zoneRunStats[i].add(target, input, computeTime);
+            zoneRipple[i].add(input);
+            zoneLatency[i].add(timing);
+        }
+        if (learning)
+        {
+            zoneIlcs[i].addError(curveTime, target - input);
+        }
+        dutySum += zones[i].getOutput();
+        energySum += zoneEnergy[i].getEnergy();
+    }
+    heaterDuty = dutySum / (numZones * pidOutputMax);
+    heaterSteadyTemp = plateModel.ambient + plateModel.gain * heaterDuty;
+    runEnergy_J = energySum;
+    data.setControlTiming(slowest.capture_us, slowest.actuated_us);
+
+    // Report ripple against the output
+    // mode's duty resolution
+    if (runState.isRunning() && ++rippleTicks >= rippleReportTicks)
     {
-        if (startReflowCurve)
+        rippleTicks = 0;
+        for (int i = 0; i < numZones; i++)
         {
-            startReflowCurve = false;
-            reflowCurveRunning = true;
-            reflowStartMillis = millis();
-            Serial.println("Starting reflow curve");
+            logPrintf("Heater %s: %s, %ld duty levels per %d ms, ripple %.3f C rms %.3f C p-p\n",
+                      zones[i].getName(),
+                      HeaterOutput::getModeName(),
+                      HeaterOutput::getDutyLevels(loopDelay),
+                      loopDelay,
+                      zoneRipple[i].getStdDev(),
+                      zoneRipple[i].getPeakToPeak());
+            zoneRipple[i].reset();
         }
     }
 
-    // Compute output power based on TC1
-    // input and apply it
-    pidInput = data.getTc1Temp();
-    pidSetpoint = data.getSetpoint();
-    pid.Compute();
-    ledcWrite(ledChannel, pidOutput);
+    updateIdle();
+    int32_t wake_us;
+    if (idleTracker.takeWakeLatency(wake_us))
+    {
+        logPrintf("Idle: full rate %ld us after waking\n", (long)wake_us);
+    }
 
-    delay(loopDelay);
+    waitForNextTick();
 }
 
 double c2f(double celsius)
@@ -447,158 +1186,212 @@ double c2f(double celsius)
 
 void readThermocouples(void *)
 {
-    double c;
-    double tc1Samples[tcNumSamplesToAvg];
-    double tc2Samples[tcNumSamplesToAvg];
-    int sampleIdx = 0;
-    int count = 0;
+    uint32_t frames[Max31855Bus::maxChips];
+    SampleAverage<double, tcNumSamplesToAvg> tc1Samples;
+    SampleAverage<double, tcNumSamplesToAvg> tc2Samples;
 
     while (true)
     {
-        // Read TC1 input
-        c = thermocouple1.readCelsius();
-        if (isnan(c))
+        // One transaction for both chips;
+        // each frame carries its own fault
+        // bits, so a fault costs no extra
+        // read
+        int64_t timestamp = esp_timer_get_time();
+        tcBus.read(frames);
+        tcRead_us = esp_timer_get_time() - timestamp;
+
+        // The chips' own conversion is
+        // linear; correct each sample to
+        // the NIST curve
+        Max31855Sample tc1 = decodeMax31855Frame(frames[tc1Chip]);
+        tc1.temp_c = calibration.apply(CAL_SENSOR_TC1, correctKType(tc1.temp_c, tc1.coldJunction_c));
+        if (isnan(tc1.temp_c))
         {
             Serial.println("Thermocouple 1 fault(s) detected!");
-            uint8_t e = thermocouple1.readError();
-            if (e & MAX31855_FAULT_OPEN)
-            {
-                Serial.println("FAULT: Thermocouple is open - no connections.");
-            }
-            if (e & MAX31855_FAULT_SHORT_GND)
-            {
-                Serial.println("FAULT: Thermocouple is short-circuited to GND.");
-            }
-            if (e & MAX31855_FAULT_SHORT_VCC)
-            {
-                Serial.println("FAULT: Thermocouple is short-circuited to VCC.");
-            }
+            countTcFaults(1, tc1.faults, COUNTER_TC1_FAULT_OPEN);
         }
         else
         {
-            tc1Samples[sampleIdx] = c;
+            metrics.add(COUNTER_TC1_SAMPLES);
+            tc1Samples.add(tc1.temp_c);
 
-            if (count == tcNumSamplesToAvg)
+            if (tc1Samples.isFull())
             {
-                double sum = 0.0;
-                for (int i = 0; i < tcNumSamplesToAvg; i++)
-                {
-                    sum += tc1Samples[i];
-                }
-
-                double avg = sum / tcNumSamplesToAvg;
-                data.setTc1Temp(avg);
+                data.setTc1Temp(tc1Samples.average(), timestamp);
             }
         }
 
-        // Read TC2 input
-        c = thermocouple2.readCelsius();
-        if (isnan(c))
+        Max31855Sample tc2 = decodeMax31855Frame(frames[tc2Chip]);
+        tc2.temp_c = calibration.apply(CAL_SENSOR_TC2, correctKType(tc2.temp_c, tc2.coldJunction_c));
+        if (isnan(tc2.temp_c))
         {
             Serial.println("Thermocouple 2 fault(s) detected!");
-            uint8_t e = thermocouple1.readError();
-            if (e & MAX31855_FAULT_OPEN)
-            {
-                Serial.println("FAULT: Thermocouple is open - no connections.");
-            }
-            if (e & MAX31855_FAULT_SHORT_GND)
-            {
-                Serial.println("FAULT: Thermocouple is short-circuited to GND.");
-            }
-            if (e & MAX31855_FAULT_SHORT_VCC)
-            {
-                Serial.println("FAULT: Thermocouple is short-circuited to VCC.");
-            }
+            countTcFaults(2, tc2.faults, COUNTER_TC2_FAULT_OPEN);
         }
         else
         {
-            tc2Samples[sampleIdx] = c;
+            metrics.add(COUNTER_TC2_SAMPLES);
+            tc2Samples.add(tc2.temp_c);
 
-            if (count == tcNumSamplesToAvg)
+            if (tc2Samples.isFull())
             {
-                double sum = 0.0;
-                for (int i = 0; i < tcNumSamplesToAvg; i++)
-                {
-                    sum += tc2Samples[i];
-                }
-
-                double avg = sum / tcNumSamplesToAvg;
-                data.setTc2Temp(avg);
+                data.setTc2Temp(tc2Samples.average(), timestamp);
             }
         }
+        idleTracker.sampled(IDLE_CHANNEL_TC, timestamp);
 
-        // Update count until we have
-        // enough samples to start averaging
-        if (count < tcNumSamplesToAvg)
-        {
-            count++;
-        }
+        // Wait for next sample interval
+        waitForNextSample(tcDelay, idleConfig.tcPeriod_ms);
+    }
+}
+
+// Logs and counts the faults in one
+// frame from thermocouple tc; open is
+// its first fault counter, the others
+// follow it
+void countTcFaults(int tc, uint8_t faults, Counter open)
+{
+    if (faults & TC_FAULT_OPEN)
+    {
+        logPrintf("FAULT: Thermocouple %d is open - no connections.\n", tc);
+        metrics.add(open);
+    }
+    if (faults & TC_FAULT_SHORT_GND)
+    {
+        logPrintf("FAULT: Thermocouple %d is short-circuited to GND.\n", tc);
+        metrics.add((Counter)(open + 1));
+    }
+    if (faults & TC_FAULT_SHORT_VCC)
+    {
+        logPrintf("FAULT: Thermocouple %d is short-circuited to VCC.\n", tc);
+        metrics.add((Counter)(open + 2));
+    }
+}
 
-        // Update sampleIdx
-        sampleIdx = (sampleIdx + 1) % tcNumSamplesToAvg;
+// Average time to read both
+// thermocouples through the Adafruit
+// library, which bit-bangs SPI and reads
+// a fresh frame for each value it
+// returns. Must run before tcBus.begin()
+// as it drives the same pins as GPIO.
+const int tcTimingReads = 20;
 
-        // Wait for next sample interval
-        vTaskDelay(tcDelay / portTICK_PERIOD_MS);
+double timeLibraryReads()
+{
+    Adafruit_MAX31855 thermocouple1(TC_CLK_PIN, TC1_CS_PIN, TC_DO_PIN);
+    Adafruit_MAX31855 thermocouple2(TC_CLK_PIN, TC2_CS_PIN, TC_DO_PIN);
+    thermocouple1.begin();
+    thermocouple2.begin();
+
+    volatile double sink = 0.0;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < tcTimingReads; i++)
+    {
+        sink = thermocouple1.readCelsius() + thermocouple2.readCelsius();
     }
+    (void)sink;
+
+    return (double)(esp_timer_get_time() - start) / tcTimingReads;
+}
+
+// Average time to read and decode both
+// thermocouples on tcBus
+double timeBusReads()
+{
+    uint32_t frames[Max31855Bus::maxChips];
+    volatile double sink = 0.0;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < tcTimingReads; i++)
+    {
+        tcBus.read(frames);
+        sink = decodeMax31855Frame(frames[tc1Chip]).temp_c + decodeMax31855Frame(frames[tc2Chip]).temp_c;
+    }
+    (void)sink;
+
+    return (double)(esp_timer_get_time() - start) / tcTimingReads;
 }
 
 void readLMT85(void *)
 {
-    double c;
-    double samples[lmt85NumSamplesToAvg];
-    int sampleIdx = 0;
-    int count = 0;
+    Decimator<lmt85BurstSize * lmt85BurstsPerReading> decimator;
+    int64_t bus_us = 0;
+    int64_t windowStart_us = esp_timer_get_time();
+    double noise = 0.0;
+    int readings = 0;
 
     while (true)
     {
-        // Read the value of the LMT85
-        uint16_t lmt85Counts = 0;
+        uint8_t burst[lmt85BurstSize * 2];
 
         // Take the mutex
         xSemaphoreTake(i2cMutex, portMAX_DELAY);
 
-        // Request 2 bytes from the external ADC
-        uint8_t bytesReceived = Wire.requestFrom(ADC_ADDR, 2);
-        if (bytesReceived == 2)
+        // One read returns a whole burst of
+        // conversions from the external ADC
+        int64_t timestamp = esp_timer_get_time();
+        uint8_t bytesReceived = Wire.requestFrom(ADC_ADDR, (int)sizeof(burst));
+        if (bytesReceived == sizeof(burst))
         {
-            uint8_t tmp[2];
-            Wire.readBytes(tmp, 2);
-            lmt85Counts = ((tmp[0] << 8) | tmp[1]) & 0x0fff;
+            Wire.readBytes(burst, sizeof(burst));
         }
+        bus_us += esp_timer_get_time() - timestamp;
 
         // Give the mutex back
         xSemaphoreGive(i2cMutex);
 
-        // Voltage reference is 2.048V, ADC is 12-bit
-        // (4096 counts); thus, each count represents
-        // 0.5mV
-        int tmp = lmt85Counts / 2;
-        samples[sampleIdx] = tmp;
-
-        if (count == lmt85NumSamplesToAvg)
+        // A failed read would look like a
+        // very hot plate; skip it and let
+        // the sample age show the failure
+        if (bytesReceived != sizeof(burst))
         {
-            int sum = 0.0;
-            for (int i = 0; i < tcNumSamplesToAvg; i++)
-            {
-                sum += samples[i];
-            }
-
-            int avg = sum / lmt85NumSamplesToAvg;
-            data.setLmt85_mV(avg);
+            metrics.add(COUNTER_I2C_FAILURES);
+            waitForNextSample(lmt85Delay, idleConfig.lmt85Period_ms);
+            continue;
         }
 
-        // Update count until we have
-        // enough samples to start averaging
-        if (count < lmt85NumSamplesToAvg)
+        metrics.add(COUNTER_LMT85_SAMPLES, lmt85BurstSize);
+        bool ready = false;
+        for (int i = 0; i < lmt85BurstSize; i++)
         {
-            count++;
+            uint16_t counts = ((burst[2 * i] << 8) | burst[2 * i + 1]) & 0x0fff;
+            ready = decimator.add(counts) || ready;
         }
 
-        // Update sampleIdx
-        sampleIdx = (sampleIdx + 1) % lmt85NumSamplesToAvg;
+        if (ready)
+        {
+            // Voltage reference is 2.048V, ADC is 12-bit
+            // (4096 counts); thus, each count represents
+            // 0.5mV
+            double mv = decimator.getReading() / 2;
+            data.setLmt85(mv, calibration.apply(CAL_SENSOR_LMT85, getLMT85Temp(mv)), timestamp);
+            idleTracker.sampled(IDLE_CHANNEL_LMT85, timestamp);
+
+            // Report what oversampling buys
+            // and what it costs the bus; the
+            // reading period stretches to
+            // lmt85Period_ms bursts when idle
+            noise += decimator.getNoise();
+            if (++readings == lmt85ReportReadings)
+            {
+                int64_t window_us = esp_timer_get_time() - windowStart_us;
+                logPrintf("LMT85: %d samples/reading, raw noise %.2f counts rms, output %.3f counts rms, +%.1f of %.1f bits, I2C %.0f us/reading (%.2f%% of reading period)\n",
+                          lmt85BurstSize * lmt85BurstsPerReading,
+                          noise / readings,
+                          decimator.getOutputNoise(),
+                          decimator.getBitsGained(),
+                          decimator.getNominalBitsGained(),
+                          (double)bus_us / readings,
+                          100.0 * bus_us / window_us);
+                decimator.restartStats();
+                windowStart_us += window_us;
+                bus_us = 0;
+                noise = 0.0;
+                readings = 0;
+            }
+        }
 
-        // Wait for next sample interval
-        vTaskDelay(lmt85Delay / portTICK_PERIOD_MS);
+        // Wait for next burst
+        waitForNextSample(lmt85Delay, idleConfig.lmt85Period_ms);
     }
 }
 
@@ -620,11 +1413,17 @@ void updateDisplay(void *)
     const int setpointY = 31;
     const int setpointWidth = SCREEN_WIDTH;
     const int setpointHeight = 8;
+    const int statusX = 0;
+    const int statusY = 41;
+    const int statusWidth = SCREEN_WIDTH;
+    const int statusHeight = 8;
 
     double currentTc1TempC = -1.0;
     double currentTc2TempC = -1.0;
-    int currentLmt85_mV = -1;
+    double currentLmt85Temp = -1.0;
     double currentSetpoint = -1.0;
+    uint32_t currentFaults = 0xffffffff;
+    RunState currentState = RUN_STATE_COUNT;
     bool displayNeedsRefresh = false;
 
     while (true)
@@ -656,13 +1455,11 @@ void updateDisplay(void *)
         }
 
         // LMT85
-        int tmp2 = data.getLmt85_mV();
-        if (tmp2 != currentLmt85_mV)
+        tmp = data.getLmt85Temp();
+        if (tmp != currentLmt85Temp)
         {
-            currentLmt85_mV = tmp2;
-
-            // Look up temp for this voltage
-            double c = getLMT85Temp(currentLmt85_mV);
+            currentLmt85Temp = tmp;
+            double c = currentLmt85Temp;
 
             display.fillRect(lmt85X, lmt85Y, lmt85Width, lmt85Height, SSD1306_BLACK);
             display.setCursor(lmt85X, lmt85Y);
@@ -684,6 +1481,29 @@ void updateDisplay(void *)
             displayNeedsRefresh = true;
         }
 
+        // Supervisor status, or the run
+        // state when there's no fault
+        uint32_t faults = supervisor.getFaults();
+        RunState state = runState.getState();
+        if (faults != currentFaults || state != currentState)
+        {
+            currentFaults = faults;
+            currentState = state;
+
+            display.fillRect(statusX, statusY, statusWidth, statusHeight, SSD1306_BLACK);
+            display.setCursor(statusX, statusY);
+            if (currentFaults != FAULT_NONE)
+            {
+                display.printf("FAULT: 0x%02x", (unsigned int)currentFaults);
+            }
+            else
+            {
+                display.printf("Run: %s", RunStateMachine::getStateName(currentState));
+            }
+
+            displayNeedsRefresh = true;
+        }
+
         // Actually update the display if anything
         // has changed
         if (displayNeedsRefresh)
@@ -695,347 +1515,1539 @@ void updateDisplay(void *)
 
             // Send updates to display via i2c
             display.display();
+            metrics.add(COUNTER_DISPLAY_REFRESHES);
 
             // Give the mutex back
             xSemaphoreGive(i2cMutex);
         }
 
         // Wait for the next refresh interval
-        vTaskDelay(displayRefreshPeriod / portTICK_PERIOD_MS);
+        waitForNextSample(displayRefreshPeriod, idleConfig.displayPeriod_ms);
     }
 }
 
 void csvServer(void *)
 {
-    // Accept up to 10 connections
-    const int maxConns = 10;
-    Connection conns[maxConns];
-
-    // Create a server object
-    WiFiServer server(csvServerPort);
+    // Create a non-blocking listening socket
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(csvServerPort);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (server < 0 ||
+        bind(server, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(server, 4) != 0)
+    {
+        Serial.println("Failed to start CSV server socket");
+        while (true)
+        {
+            vTaskDelay(1000 / portTICK_PERIOD_MS);
+        }
+    }
+    fcntl(server, F_SETFL, fcntl(server, F_GETFL, 0) | O_NONBLOCK);
 
-    // Start server
-    server.begin();
+    // One tick cost report a minute
+    const unsigned long csvTickReportTicks = 60000 / csvReportingDelay;
+    unsigned long csvTickCount = 0;
 
     while (true)
     {
         unsigned long loopStart = millis();
 
         // Handle new connections
-        while (server.hasClient())
+        int fd;
+        while ((fd = accept(server, NULL, NULL)) >= 0)
         {
-            bool connectionAccepted = false;
-            for (int i = 0; i < maxConns; i++)
+            int64_t acceptStart = esp_timer_get_time();
+            Connection *conn = csvConns.add(fd, acceptStart);
+            if (conn == NULL)
             {
-                if (!conns[i].client.connected())
-                {
-                    // Accept connection
-                    conns[i].client = server.available();
-                    conns[i].zeroMillis = loopStart;
+                // At the client limit; reject
+                // connection
+                close(fd);
+                continue;
+            }
 
-                    // Send CSV headers
-                    conns[i].client.printf("Time,\"Set Point\",\"Under Heater\",\"Target Board\",\"Built-In Temp\",\"PID Output\",\"Kp=%0.2f Ki=%0.2f Kd=%0.2f\"\n",
-                                           Kp, Ki, Kd);
+            // Accept connection
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
 
-                    // Set flag
-                    connectionAccepted = true;
-                }
+            // Send CSV headers; one output
+            // column per heater zone
+            int len = formatHeader(csvFrame, sizeof(csvFrame), csvAllColumns);
+            if (!sendFrame(*conn, csvFrame, len))
+            {
+                dropConnection(csvConns.getCount() - 1);
+                continue;
+            }
+
+            metrics.add(COUNTER_TELEMETRY_CONNECTS);
+            logPrintf("CSV client connected (%d/%d), accept took %lld us\n",
+                      csvConns.getCount(),
+                      csvConns.getMax(),
+                      (long long)(esp_timer_get_time() - acceptStart));
+        }
+
+        // Commands sent since the last wait
+        int i = 0;
+        while (i < csvConns.getCount())
+        {
+            if (!readCommands(csvConns.get(i)))
+            {
+                dropConnection(i);
+                continue;
             }
+            i++;
+        }
 
-            if (!connectionAccepted)
+        // Everything but the time column is
+        // the same for every client on all
+        // columns, so read and format it
+        // once per tick
+        int64_t tickStart = esp_timer_get_time();
+        int numClients = csvConns.getCount();
+        char *body = csvFrame + csvTimePrefixSize;
+        int bodyLen = 0;
+        int64_t sample_us = 0;
+        int64_t actuated_us = 0;
+        TelemetryRow row;
+        if (numClients > 0)
+        {
+            // Rows are stamped with the capture
+            // time of the sample the controller
+            // last acted on
+            data.getControlTiming(sample_us, actuated_us);
+            if (sample_us == 0)
             {
-                // No slots left; reject
-                // connection
-                server.available().stop();
+                sample_us = tickStart;
+                actuated_us = tickStart;
+            }
+
+            row.setpoint = data.getSetpoint();
+            row.tc1Temp = data.getTc1Temp();
+            row.tc2Temp = data.getTc2Temp();
+            row.lmt85Temp = data.getLmt85Temp();
+            row.estimateTemp = data.getEstimateTemp();
+            row.estimateRate = data.getEstimateRate();
+            row.sensorToActuation_us = actuated_us - sample_us;
+            row.sampleToClient_us = esp_timer_get_time() - sample_us;
+            row.energy_J = runEnergy_J;
+            row.numOutputs = numZones;
+            for (int z = 0; z < numZones; z++)
+            {
+                row.outputs[z] = zones[z].getOutput() * 100.0 / pidOutputMax;
             }
+            row.phase = RunStateMachine::getStateName(runState.getState());
+            bodyLen = formatCsvBody(body, sizeof(csvFrame) - csvTimePrefixSize, row);
         }
 
-        // Send CSV data to connected
-        // clients
-        for (int i = 0; i < maxConns; i++)
+        // Send CSV data to clients that are
+        // due, patching in each one's time
+        // ahead of the shared body; clients
+        // on fewer columns get their own
+        i = 0;
+        while (i < csvConns.getCount())
         {
-            if (conns[i].client.connected())
+            Connection &conn = csvConns.get(i);
+            if (conn.period_ms > 0)
+            {
+                if ((long)(loopStart - conn.nextSend_ms) < 0)
+                {
+                    i++;
+                    continue;
+                }
+                conn.nextSend_ms += conn.period_ms;
+                if ((long)(loopStart - conn.nextSend_ms) >= 0)
+                {
+                    conn.nextSend_ms = loopStart + conn.period_ms;
+                }
+            }
+
+            char *rowBody = body;
+            int rowBodyLen = bodyLen;
+            if (conn.columns != csvAllColumns)
+            {
+                rowBody = csvClientFrame + csvTimePrefixSize;
+                rowBodyLen = formatCsvBody(rowBody, sizeof(csvClientFrame) - csvTimePrefixSize, row, conn.columns);
+            }
+            int64_t reportTime_us = sample_us - conn.zero_us;
+            char *frame = prependCsvTime(rowBody, reportTime_us > 0 ? reportTime_us / 1000 : 0);
+            if (!sendFrame(conn, frame, rowBody + rowBodyLen - frame))
             {
-                unsigned long reportTime = loopStart - conns[i].zeroMillis;
-                conns[i].client.printf("%0.2f,%0.2f,%0.2f,%0.2f,%0.2f,%0.2f\n",
-                                       (double)reportTime / 1000.0,
-                                       data.getSetpoint(),
-                                       data.getTc1Temp(),
-                                       data.getTc2Temp(),
-                                       getLMT85Temp(data.getLmt85_mV()),
-                                       pidOutput / 40.95);
+                // The last connection moves
+                // into slot i
+                dropConnection(i);
+                continue;
             }
+            i++;
         }
 
-        // Wait for next reporting interval
-        int delay = csvReportingDelay - (millis() - loopStart);
-        if (delay > 0)
+        // Report the tick cost for the
+        // number of clients served
+        if (numClients > 0 && ++csvTickCount % csvTickReportTicks == 0)
         {
-            vTaskDelay(delay / portTICK_PERIOD_MS);
+            logPrintf("CSV tick: %d clients, %lld us\n",
+                      numClients,
+                      (long long)(esp_timer_get_time() - tickStart));
+            if (commandCount > 0)
+            {
+                logPrintf("CSV commands: %d, round trip %lld us avg, %lld us max\n",
+                          commandCount,
+                          (long long)(commandTotal_us / commandCount),
+                          (long long)commandMax_us);
+                commandCount = 0;
+                commandTotal_us = 0;
+                commandMax_us = 0;
+            }
         }
+
+        waitForCsvTick(loopStart);
     }
 }
 
-void IRAM_ATTR btnHandler()
+int formatHeader(char *buf, size_t size, uint32_t columns)
 {
-    // Software switch debounce:
+    const char *zoneNames[numZones];
+    for (int z = 0; z < numZones; z++)
+    {
+        zoneNames[z] = zones[z].getName();
+    }
+
+    int len = formatCsvHeader(buf, size, columns, zoneNames, numZones);
+    len += snprintf(buf + len, size - len, ",\"Kp=%0.2f Ki=%0.2f Kd=%0.2f\"\n", Kp, Ki, Kd);
+
+    return len < (int)size ? len : size - 1;
+}
+
+void waitForCsvTick(unsigned long tickStart)
+{
+    // Sleep in select() on the client
+    // sockets until the next tick, so a
+    // command is read as soon as it
+    // arrives; wake up every
+    // replyPollPeriod ms only while a
+    // reply is awaited, so an idle plate
+    // wakes once a tick
+    while (true)
+    {
+        sendReplies();
+
+        unsigned long elapsed = millis() - tickStart;
+        if (elapsed >= (unsigned long)csvReportingDelay)
+        {
+            return;
+        }
+        unsigned long wait_ms = csvReportingDelay - elapsed;
+        if (awaitingReplies > 0 && wait_ms > (unsigned long)replyPollPeriod)
+        {
+            wait_ms = replyPollPeriod;
+        }
+
+        fd_set readable;
+        FD_ZERO(&readable);
+        int maxFd = -1;
+        for (int i = 0; i < csvConns.getCount(); i++)
+        {
+            int fd = csvConns.get(i).fd;
+            FD_SET(fd, &readable);
+            maxFd = fd > maxFd ? fd : maxFd;
+        }
+        if (maxFd < 0)
+        {
+            vTaskDelay((wait_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+            continue;
+        }
+
+        struct timeval timeout;
+        timeout.tv_sec = 0;
+        timeout.tv_usec = wait_ms * 1000;
+        if (select(maxFd + 1, &readable, NULL, NULL, &timeout) <= 0)
+        {
+            continue;
+        }
+
+        int i = 0;
+        while (i < csvConns.getCount())
+        {
+            Connection &conn = csvConns.get(i);
+            if (FD_ISSET(conn.fd, &readable) && !readCommands(conn))
+            {
+                dropConnection(i);
+                continue;
+            }
+            i++;
+        }
+    }
+}
+
+bool readCommands(Connection &conn)
+{
+    // Returns false once the client has
+    // closed the connection or failed
+    char buf[64];
+    int received;
+    while ((received = recv(conn.fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    {
+        int64_t received_us = esp_timer_get_time();
+        for (int k = 0; k < received; k++)
+        {
+            char c = buf[k];
+            if (c == '\r')
+            {
+                continue;
+            }
+            if (c != '\n')
+            {
+                // Lines too long are dropped
+                // whole
+                if (conn.lineLength >= 0 && conn.lineLength < commandMaxLength - 1)
+                {
+                    conn.line[conn.lineLength++] = c;
+                }
+                else
+                {
+                    conn.lineLength = -1;
+                }
+                continue;
+            }
+
+            bool ok = true;
+            if (conn.lineLength < 0)
+            {
+                ok = sendReply(conn, CMD_INVALID, false, received_us);
+            }
+            else if (conn.lineLength > 0)
+            {
+                conn.line[conn.lineLength] = '\0';
+                ok = handleCommand(conn, received_us);
+            }
+            conn.lineLength = 0;
+            if (!ok)
+            {
+                return false;
+            }
+        }
+    }
+
+    return !(received == 0 || (received < 0 && errno != EWOULDBLOCK && errno != EAGAIN));
+}
+
+bool handleCommand(Connection &conn, int64_t received_us)
+{
+    Command command;
+    if (!parseCommand(conn.line, command))
+    {
+        return sendReply(conn, CMD_INVALID, false, received_us);
+    }
+
+    // Subscriptions only concern this
+    // client; the new header goes out
+    // with the reply
+    if (command.type == CMD_SUBSCRIBE)
+    {
+        conn.columns = command.columns;
+        conn.period_ms = command.period_ms;
+        conn.nextSend_ms = millis();
+        int len = formatHeader(csvClientFrame, sizeof(csvClientFrame), conn.columns);
+        return sendReply(conn, command.type, true, received_us) &&
+               sendFrame(conn, csvClientFrame, len);
+    }
+
+    // Everything else is up to loop(),
+    // which is woken for it
+    CommandRequest request = {conn.id, received_us, command};
+    if (awaitingReplies == runEventQueueSize - 1 || !netCommands.push(request))
+    {
+        return sendReply(conn, command.type, false, received_us);
+    }
+    awaitingReplies++;
+    xTaskNotifyGive(loopTaskHandle);
+
+    return true;
+}
+
+bool sendReply(Connection &conn, CommandType type, bool ok, int64_t received_us)
+{
+    // Replies are comment lines in the
+    // stream, with the round trip from
+    // the command line arriving
+    int64_t roundTrip_us = esp_timer_get_time() - received_us;
+    commandCount++;
+    commandTotal_us += roundTrip_us;
+    metrics.add(COUNTER_TELEMETRY_COMMANDS);
+    if (roundTrip_us > commandMax_us)
+    {
+        commandMax_us = roundTrip_us;
+    }
+
+    char reply[48];
+    int len = snprintf(reply, sizeof(reply), "# %s %s %lld us\n",
+                       ok ? "ok" : "error",
+                       getCommandName(type),
+                       (long long)roundTrip_us);
+
+    return sendFrame(conn, reply, len);
+}
+
+void sendReplies()
+{
+    // The client may have gone while
+    // loop() worked on its command
+    CommandReply reply;
+    while (netReplies.pop(reply))
+    {
+        awaitingReplies--;
+        int i = csvConns.find(reply.connId);
+        if (i >= 0 && !sendReply(csvConns.get(i), reply.type, reply.ok, reply.received_us))
+        {
+            dropConnection(i);
+        }
+    }
+}
+
+bool sendFrame(Connection &conn, const char *frame, int len)
+{
+    // A client that can't take a whole
+    // frame without blocking is dropped
+    // rather than stalling the others
+    int sent = send(conn.fd, frame, len, MSG_DONTWAIT);
+    if (sent > 0)
+    {
+        metrics.add(COUNTER_TELEMETRY_BYTES, sent);
+    }
+    if (sent != len)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void dropConnection(int i)
+{
+    close(csvConns.get(i).fd);
+    csvConns.remove(i);
+    metrics.add(COUNTER_TELEMETRY_DROPS);
+    logPrintf("CSV client disconnected (%d/%d)\n", csvConns.getCount(), csvConns.getMax());
+}
+
+int csvClientLimit(int configured)
+{
+    size_t freeHeap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    int byMemory = freeHeap > csvHeapReserve ? (freeHeap - csvHeapReserve) / csvClientBytes : 0;
+    int bySockets = CONFIG_LWIP_MAX_SOCKETS - 1;
+
+    int limit = configured;
+    if (byMemory < limit)
+    {
+        limit = byMemory;
+    }
+    if (bySockets < limit)
+    {
+        limit = bySockets;
+    }
+    if (limit < 1)
+    {
+        limit = 1;
+    }
+
+    return limit;
+}
+
+void superviseHeaters(void *)
+{
+    TickType_t lastWake = xTaskGetTickCount();
+
+    while (true)
+    {
+        SupervisorInputs inputs = readSupervisorInputs();
+        int64_t now = esp_timer_get_time();
+
+        if (supervisorClearRequested)
+        {
+            supervisorClearRequested = false;
+            if (supervisor.clear(inputs, now))
+            {
+                supervisorFaulted = false;
+                HeaterOutput::setInhibit(false);
+                postEvent(safetyEvents, EVENT_FAULT_CLEARED, 0);
+                Serial.println("Fault cleared");
+            }
+            else
+            {
+                Serial.println("Fault still present; not cleared");
+            }
+        }
+
+        uint32_t faults = supervisor.check(inputs, now);
+        if (faults != FAULT_NONE)
+        {
+            // Inhibit first so a controller
+            // write can't turn a zone back on,
+            // then force every zone off. This
+            // is repeated every period while
+            // the fault is latched.
+            HeaterOutput::setInhibit(true);
+            for (int i = 0; i < numZones; i++)
+            {
+                zones[i].forceOff();
+            }
+            supervisor.heatersOff(esp_timer_get_time());
+
+            if (!supervisorFaulted)
+            {
+                supervisorFaulted = true;
+                postEvent(safetyEvents, EVENT_FAULT, faults);
+                metrics.add(COUNTER_SUPERVISOR_FAULTS);
+                printFaults(faults);
+                logPrintf("Heaters off %lld us after fault onset (max %lld us)\n",
+                          (long long)supervisor.getLastLatency_us(),
+                          (long long)supervisor.getMaxLatency_us());
+            }
+        }
+
+        // Idle with nothing driven, no check
+        // finds more than the last until the
+        // thermocouples are read again;
+        // leaving idle wakes the task
+        if (idleTracker.isIdle() && inputs.duty == 0.0)
+        {
+            ulTaskNotifyTake(pdTRUE, idleConfig.tcPeriod_ms / portTICK_PERIOD_MS);
+            lastWake = xTaskGetTickCount();
+        }
+        else
+        {
+            vTaskDelayUntil(&lastWake, supervisorPeriod / portTICK_PERIOD_MS);
+        }
+    }
+}
+
+SupervisorInputs readSupervisorInputs()
+{
+    SupervisorInputs inputs;
+
+    inputs.temp[SUPERVISOR_TC1] = data.getTc1Temp();
+    inputs.timestamp_us[SUPERVISOR_TC1] = data.getTc1Timestamp();
+    inputs.temp[SUPERVISOR_TC2] = data.getTc2Temp();
+    inputs.timestamp_us[SUPERVISOR_TC2] = data.getTc2Timestamp();
+    inputs.temp[SUPERVISOR_LMT85] = data.getLmt85Temp();
+    inputs.timestamp_us[SUPERVISOR_LMT85] = data.getLmt85Timestamp();
+    inputs.duty = heaterDuty;
+    inputs.steadyTemp = heaterSteadyTemp;
+
+    return inputs;
+}
+
+void printFaults(uint32_t faults)
+{
+    logPrintf("FAULT: heaters latched off (0x%02x)\n", (unsigned int)faults);
+    if (faults & FAULT_TC1_STALE)
+    {
+        Serial.println("FAULT: Thermocouple 1 samples are stale.");
+    }
+    if (faults & FAULT_TC2_STALE)
+    {
+        Serial.println("FAULT: Thermocouple 2 samples are stale.");
+    }
+    if (faults & FAULT_LMT85_STALE)
+    {
+        Serial.println("FAULT: LMT85 samples are stale.");
+    }
+    if (faults & FAULT_OVER_TEMP)
+    {
+        Serial.println("FAULT: Plate over maximum temperature.");
+    }
+    if (faults & FAULT_DISAGREEMENT)
+    {
+        Serial.println("FAULT: Thermocouples 1 and 2 disagree.");
+    }
+    if (faults & FAULT_RUNAWAY)
+    {
+        Serial.println("FAULT: Thermal runaway.");
+    }
+    if (faults & FAULT_INJECTED)
+    {
+        Serial.println("FAULT: Injected (self test).");
+    }
+}
+
+void IRAM_ATTR btnHandler()
+{
+    // Software switch debounce:
     // detach interrupt and start a
     // timer to re-attach it after
     // debounceTime_us microseconds
     detachInterrupt(BTN_PIN);
+    btnPressTime_us = esp_timer_get_time();
     esp_timer_start_once(btnTimer, debounceTime_us);
+}
 
-    // Start or cancel the reflow curve
-    if (!reflowCurveRunning)
+void IRAM_ATTR btnDebounce(void *)
+{
+    if (digitalRead(BTN_PIN) == HIGH)
     {
-        startReflowCurve = true;
+        attachInterrupt(BTN_PIN, btnHandler, FALLING);
+
+        // Released; the first call after
+        // boot has no press behind it
+        if (btnPressTime_us != 0)
+        {
+            int64_t held_us = esp_timer_get_time() - btnPressTime_us;
+            btnPressTime_us = 0;
+            postEvent(buttonEvents, EVENT_BUTTON, held_us / 1000);
+        }
     }
     else
     {
-        cancelReflowCurve = true;
+        esp_timer_start_once(btnTimer, debounceTime_us);
     }
 }
 
-void IRAM_ATTR btnDebounce(void *)
+void postEvent(SpscQueue<RunEvent, runEventQueueSize> &queue, RunEventType type, int32_t arg)
 {
-    if (digitalRead(BTN_PIN) == HIGH)
+    // Dropped if loop() is that far
+    // behind; the source posts again on
+    // its next change
+    RunEvent event = {type, esp_timer_get_time(), arg};
+    if (queue.push(event))
     {
-        attachInterrupt(BTN_PIN, btnHandler, FALLING);
+        xTaskNotifyGive(loopTaskHandle);
     }
-    else
+}
+
+bool handleEvents()
+{
+    // Safety events first, so a fault
+    // posted alongside a button press
+    // wins. Returns true if the run state
+    // changed.
+    RunState previous = runState.getState();
+    RunEvent event;
+    while (safetyEvents.pop(event))
     {
-        esp_timer_start_once(btnTimer, debounceTime_us);
+        handleEvent(event);
     }
+    while (buttonEvents.pop(event))
+    {
+        handleEvent(event);
+    }
+
+    // Network commands; the CSV task
+    // keeps few enough in flight that
+    // there's always room for the reply
+    CommandRequest request;
+    while (netCommands.pop(request))
+    {
+        CommandReply reply = {request.connId, request.received_us, request.command.type, runCommand(request)};
+        netReplies.push(reply);
+    }
+
+    return runState.getState() != previous;
 }
 
-const int lmt85Lookup[] = {301, 150,
-                           310, 149,
-                           319, 148,
-                           328, 147,
-                           337, 146,
-                           346, 145,
-                           354, 144,
-                           363, 143,
-                           372, 142,
-                           381, 141,
-                           390, 140,
-                           399, 139,
-                           408, 138,
-                           416, 137,
-                           425, 136,
-                           434, 135,
-                           443, 134,
-                           452, 133,
-                           460, 132,
-                           469, 131,
-                           478, 130,
-                           487, 129,
-                           495, 128,
-                           504, 127,
-                           513, 126,
-                           521, 125,
-                           530, 124,
-                           539, 123,
-                           547, 122,
-                           556, 121,
-                           565, 120,
-                           573, 119,
-                           582, 118,
-                           591, 117,
-                           599, 116,
-                           608, 115,
-                           617, 114,
-                           625, 113,
-                           634, 112,
-                           642, 111,
-                           651, 110,
-                           660, 109,
-                           668, 108,
-                           677, 107,
-                           685, 106,
-                           694, 105,
-                           702, 104,
-                           711, 103,
-                           720, 102,
-                           728, 101,
-                           737, 100,
-                           745, 99,
-                           754, 98,
-                           762, 97,
-                           771, 96,
-                           779, 95,
-                           788, 94,
-                           797, 93,
-                           805, 92,
-                           814, 91,
-                           822, 90,
-                           831, 89,
-                           839, 88,
-                           848, 87,
-                           856, 86,
-                           865, 85,
-                           873, 84,
-                           881, 83,
-                           890, 82,
-                           898, 81,
-                           907, 80,
-                           915, 79,
-                           924, 78,
-                           932, 77,
-                           941, 76,
-                           949, 75,
-                           957, 74,
-                           966, 73,
-                           974, 72,
-                           983, 71,
-                           991, 70,
-                           1000, 69,
-                           1008, 68,
-                           1017, 67,
-                           1025, 66,
-                           1034, 65,
-                           1042, 64,
-                           1051, 63,
-                           1059, 62,
-                           1067, 61,
-                           1076, 60,
-                           1084, 59,
-                           1093, 58,
-                           1101, 57,
-                           1109, 56,
-                           1118, 55,
-                           1126, 54,
-                           1134, 53,
-                           1143, 52,
-                           1151, 51,
-                           1159, 50,
-                           1167, 49,
-                           1176, 48,
-                           1184, 47,
-                           1192, 46,
-                           1201, 45,
-                           1209, 44,
-                           1217, 43,
-                           1225, 42,
-                           1234, 41,
-                           1242, 40,
-                           1250, 39,
-                           1258, 38,
-                           1267, 37,
-                           1275, 36,
-                           1283, 35,
-                           1291, 34,
-                           1299, 33,
-                           1308, 32,
-                           1316, 31,
-                           1324, 30,
-                           1332, 29,
-                           1340, 28,
-                           1348, 27,
-                           1356, 26,
-                           1365, 25,
-                           1373, 24,
-                           1381, 23,
-                           1389, 22,
-                           1397, 21,
-                           1405, 20,
-                           1413, 19,
-                           1421, 18,
-                           1430, 17,
-                           1438, 16,
-                           1446, 15,
-                           1454, 14,
-                           1462, 13,
-                           1470, 12,
-                           1478, 11,
-                           1486, 10,
-                           1494, 9,
-                           1502, 8,
-                           1511, 7,
-                           1519, 6,
-                           1527, 5,
-                           1535, 4,
-                           1543, 3,
-                           1551, 2,
-                           1559, 1,
-                           1567, 0,
-                           1575, -1,
-                           1583, -2,
-                           1591, -3,
-                           1599, -4,
-                           1607, -5,
-                           1615, -6,
-                           1623, -7,
-                           1631, -8,
-                           1639, -9,
-                           1648, -10,
-                           1656, -11,
-                           1663, -12,
-                           1671, -13,
-                           1679, -14,
-                           1687, -15,
-                           1695, -16,
-                           1703, -17,
-                           1711, -18,
-                           1719, -19,
-                           1727, -20,
-                           1735, -21,
-                           1743, -22,
-                           1751, -23,
-                           1759, -24,
-                           1767, -25,
-                           1775, -26,
-                           1783, -27,
-                           1790, -28,
-                           1798, -29,
-                           1806, -30,
-                           1814, -31,
-                           1822, -32,
-                           1830, -33,
-                           1838, -34,
-                           1845, -35,
-                           1853, -36,
-                           1861, -37,
-                           1869, -38,
-                           1877, -39,
-                           1885, -40,
-                           1892, -41,
-                           1900, -42,
-                           1908, -43,
-                           1915, -44,
-                           1921, -45,
-                           1928, -46,
-                           1935, -47,
-                           1942, -48,
-                           1949, -49,
-                           1955, -50,
-                           0, 0};
-
-double getLMT85Temp(int lmt85_mV)
+bool handleEvent(const RunEvent &event)
 {
-    int idx = -1;
-    int lastValue = -10000;
-    for (int i = 0; lmt85Lookup[i] != 0; i += 2)
+    RunState previous = runState.getState();
+    bool wasRunning = runState.isRunning();
+
+    switch (event.type)
+    {
+    case EVENT_BUTTON:
+        // Clear a latched fault, cancel
+        // whatever is running, or start the
+        // reflow curve (short press) or
+        // characterization (long press)
+        if (previous == RUN_FAULT)
+        {
+            supervisorClearRequested = true;
+        }
+        else if (characterizationRunning)
+        {
+            cancelCharacterization = true;
+        }
+        else if (calibrationRunning)
+        {
+            cancelCalibration = true;
+        }
+        else if (runState.cancel())
+        {
+            endRun("cancelled", COUNTER_RUNS_CANCELLED);
+        }
+        else if (event.arg * 1000LL >= longPressTime_us)
+        {
+            startCharacterization = true;
+        }
+        else if (!trajectory.isCompiled())
+        {
+            logPrintf("Not starting reflow curve; profile %s isn't compiled\n", profile.getName());
+        }
+        else if (runState.start())
+        {
+            startRun();
+        }
+        break;
+
+    case EVENT_START:
+        if (supervisorFaulted || characterizationRunning || calibrationRunning)
+        {
+            logPrintf("Not starting reflow curve; plate busy or faulted\n");
+        }
+        else if (!trajectory.isCompiled())
+        {
+            logPrintf("Not starting reflow curve; profile %s isn't compiled\n", profile.getName());
+        }
+        else if (runState.start())
+        {
+            startRun();
+        }
+        break;
+
+    case EVENT_CANCEL:
+        if (runState.cancel())
+        {
+            endRun("cancelled", COUNTER_RUNS_CANCELLED);
+        }
+        break;
+
+    case EVENT_FAULT:
+        if (runState.fault() && wasRunning)
+        {
+            endRun("faulted", COUNTER_RUNS_FAULTED);
+        }
+        break;
+
+    case EVENT_FAULT_CLEARED:
+        runState.clearFault();
+        break;
+    }
+
+    // Time from the event to its
+    // transition, and for a cancel to the
+    // heaters being off
+    RunState state = runState.getState();
+    if (state != previous)
     {
-        lastValue = lmt85Lookup[i + 1];
-        if (lmt85Lookup[i] > lmt85_mV)
+        int64_t latency_us = esp_timer_get_time() - event.time_us;
+        if (latency_us > eventLatencyMax_us)
         {
-            idx = i;
-            break;
+            eventLatencyMax_us = latency_us;
         }
+        logPrintf("Run: %s -> %s on %s, %lld us after the event (max %lld us)\n",
+                  RunStateMachine::getStateName(previous),
+                  RunStateMachine::getStateName(state),
+                  RunStateMachine::getEventName(event.type),
+                  (long long)latency_us,
+                  (long long)eventLatencyMax_us);
     }
 
-    if (idx == 0)
+    return state != previous;
+}
+
+bool runCommand(const CommandRequest &request)
+{
+    // Start and cancel go through the run
+    // state machine like the button;
+    // the rest only apply while idle.
+    // Returns whether the command took.
+    const Command &command = request.command;
+    bool idle = !runState.isRunning() && !characterizationRunning && !calibrationRunning && !supervisorFaulted;
+
+    switch (command.type)
+    {
+    case CMD_START:
     {
-        // Too low; return lowest value
-        return lmt85Lookup[1];
+        RunEvent event = {EVENT_START, request.received_us, 0};
+        return handleEvent(event);
     }
 
-    if (idx == -1)
+    case CMD_CANCEL:
     {
-        // Too high; return highest value
-        return lastValue;
+        if (characterizationRunning)
+        {
+            cancelCharacterization = true;
+            return true;
+        }
+        if (calibrationRunning)
+        {
+            cancelCalibration = true;
+            return true;
+        }
+        RunEvent event = {EVENT_CANCEL, request.received_us, 0};
+        return handleEvent(event);
     }
 
-    return lmt85Lookup[idx - 1] - (((double)(lmt85_mV - lmt85Lookup[idx - 2])) / (lmt85Lookup[idx] - lmt85Lookup[idx - 2]));
-}
\ No newline at end of file
+    case CMD_PROFILE:
+        if (!idle || !loadProfile(command.name))
+        {
+            return false;
+        }
+        logPrintf("Profile: %s (%lu s)\n", profile.getName(), profile.getDuration() / 1000);
+        compileProfile();
+        return true;
+
+    case CMD_SETPOINT:
+        // Nothing the supervisor would trip
+        // on
+        if (!idle || command.values[0] < 0.0 || command.values[0] > supervisor.getLimits().maxTemp)
+        {
+            return false;
+        }
+        data.setSetpoint(command.values[0]);
+        logPrintf("Setpoint: %.2f C\n", command.values[0]);
+        return true;
+
+    case CMD_GAINS:
+        if (!idle || command.values[0] < 0.0 || command.values[1] < 0.0 || command.values[2] < 0.0)
+        {
+            return false;
+        }
+        // Zones pick them up, bumplessly,
+        // unless the gain schedule covers
+        // where they are
+        Kp = command.values[0];
+        Ki = command.values[1];
+        Kd = command.values[2];
+        for (int i = 0; i < numZones; i++)
+        {
+            zoneGainIdx[i] = noGainIdx;
+        }
+        return true;
+
+    case CMD_CALIBRATE:
+        return idle && beginCalibration();
+
+    case CMD_IDLE:
+        if (command.values[0] != 0.0 && !idlePeriodsFit())
+        {
+            return false;
+        }
+        idleConfig.enabled = command.values[0] != 0.0;
+        logPrintf("Idle mode: %s\n", idleConfig.enabled ? "allowed" : "off");
+        return true;
+
+    case CMD_COAST:
+        if (!idle)
+        {
+            return false;
+        }
+        energyConfig.coast = command.values[0] != 0.0;
+        logPrintf("Coast: %s\n", energyConfig.coast ? "on" : "off");
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+void waitForNextTick()
+{
+    // Same period as delay(loopDelay),
+    // or the idle period, but events are
+    // handled as they arrive, and one that
+    // changes the run state, or leaves
+    // idle, ends the wait so the next tick
+    // acts on it at once
+    unsigned long start = millis();
+    while (true)
+    {
+        unsigned long period = idleTracker.isIdle() ? idleConfig.loopPeriod_ms : loopDelay;
+        unsigned long waited = millis() - start;
+        if (waited >= period)
+        {
+            return;
+        }
+
+        TickType_t ticks = (period - waited + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+        if (ulTaskNotifyTake(pdTRUE, ticks) > 0)
+        {
+            bool changed = handleEvents();
+            if (updateIdle() || changed)
+            {
+                return;
+            }
+        }
+    }
+}
+
+void waitForNextSample(int period_ms, int idlePeriod_ms)
+{
+    // Leaving idle notifies the reader
+    // tasks, which cuts an idle wait short
+    int wait_ms = idleTracker.isIdle() ? idlePeriod_ms : period_ms;
+    ulTaskNotifyTake(pdTRUE, wait_ms / portTICK_PERIOD_MS);
+}
+
+bool idlePeriodsFit()
+{
+    // Readings must keep arriving faster
+    // than the supervisor calls them
+    // stale; an LMT85 reading takes a
+    // full set of bursts
+    int maxAge_ms = config.getSupervisorLimits().maxSampleAge_ms;
+    return idleConfig.tcPeriod_ms < maxAge_ms &&
+           idleConfig.lmt85Period_ms * lmt85BurstsPerReading < maxAge_ms;
+}
+
+bool updateIdle()
+{
+    // Idle whenever nothing needs the
+    // heaters; returns true on leaving it
+    bool active = !idleConfig.enabled ||
+                  runState.isRunning() ||
+                  characterizationRunning ||
+                  startCharacterization ||
+                  calibrationRunning ||
+                  data.getSetpoint() > 0.0 ||
+                  heaterDuty > 0.0f;
+    if (active != idleTracker.isIdle())
+    {
+        return false;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (!active)
+    {
+        idleTracker.enter(now);
+        setIdlePower(true);
+        logPrintf("Idle: entered\n");
+        return false;
+    }
+
+    idleTracker.exit(now);
+    setIdlePower(false);
+    xTaskNotifyGive(supervisorTaskHandle);
+    xTaskNotifyGive(tcTaskHandle);
+    xTaskNotifyGive(lmt85TaskHandle);
+    xTaskNotifyGive(updateDisplayTaskHandle);
+
+    // The estimator was skipped while idle
+    // and restarts from the next readings
+    if (estimatorEnabled)
+    {
+        estimator.begin(plateModel, loopDelay / 1000.0, NAN);
+    }
+    logPrintf("Idle: left (%.0f s idle since boot)\n", idleTracker.getIdleTime_us(now) / 1e6);
+
+    return true;
+}
+
+void setIdlePower(bool idling)
+{
+    // Full clock whenever active; idle
+    // lets the power manager drop the
+    // clock and light-sleep while every
+    // task is blocked, and stops the
+    // heater tick
+    HeaterOutput::setIdle(idling);
+    if (!freqScalingAvailable)
+    {
+        return;
+    }
+
+    esp_pm_config_esp32_t pm;
+    pm.max_freq_mhz = cpuFreq_MHz;
+    pm.min_freq_mhz = idling ? idleCpuFreq_MHz : cpuFreq_MHz;
+    pm.light_sleep_enable = idling && idleConfig.lightSleep && lightSleepAvailable;
+    if (esp_pm_configure(&pm) != ESP_OK)
+    {
+        logPrintf("Idle: failed to set power management for %s\n", idling ? "idle" : "full rate");
+    }
+}
+
+void startRun()
+{
+    reflowStartMillis = millis();
+    logPrintf("Starting reflow curve %s\n", profile.getName());
+
+    // Profile load time: solve the MPC
+    // for each zone against the current
+    // plate model
+    int64_t precomputeStart = esp_timer_get_time();
+    for (int i = 0; i < numZones; i++)
+    {
+        if (!zoneMpcs[i].begin(plateModel, mpcConfig))
+        {
+            logPrintf("MPC setup for zone %s failed\n", zones[i].getName());
+        }
+        zoneMpcs[i].reset(zones[i].getOutput() / zones[i].getMaxDuty());
+        zoneRunStats[i].reset();
+        zoneRipple[i].reset();
+        zoneLatency[i].reset();
+        zoneEnergy[i].reset();
+        if (zoneIlcs[i].isEnabled())
+        {
+            zoneIlcs[i].load(profile.getName(), zones[i].getName(), profile.getDuration());
+        }
+    }
+    rippleTicks = 0;
+    logPrintf("MPC precompute: %lld us\n", (long long)(esp_timer_get_time() - precomputeStart));
+}
+
+void endRun(const char *result, Counter counter)
+{
+    // Heaters go off now rather than on
+    // the next tick
+    data.setSetpoint(0.0);
+    for (int i = 0; i < numZones; i++)
+    {
+        zones[i].off();
+        zoneEnergy[i].stop();
+    }
+    logPrintf("Reflow curve %s\n", result);
+    printRunSummary(result);
+    metrics.add(counter);
+}
+
+// Profile load time: flag segments the
+// plate can't follow and build the
+// setpoint table
+void compileProfile()
+{
+    int64_t compileStart = esp_timer_get_time();
+    bool compiled = trajectory.compile(profile, plateModel, trajectoryConfig);
+    long compileTime = esp_timer_get_time() - compileStart;
+    if (!compiled)
+    {
+        logPrintf("Profile %s: can't be compiled; runs refused until it is\n", profile.getName());
+        return;
+    }
+
+    logPrintf("Profile %s: compiled in %ld us, %s, peak %.1f C, up to %.1f C from the profile\n",
+              profile.getName(),
+              compileTime,
+              trajectoryConfig.enabled ? "shaped" : "as given",
+              trajectory.getPeak(),
+              trajectory.getMaxDeviation());
+    for (int i = 0; i < trajectory.getNumInfeasible(); i++)
+    {
+        const InfeasibleSegment &s = trajectory.getInfeasible(i);
+        logPrintf("Profile %s: %d-%d s asks %.2f C/s, the plate manages %.2f C/s\n",
+                  profile.getName(),
+                  profile.getPoint(s.point - 1).time_ms / 1000,
+                  profile.getPoint(s.point).time_ms / 1000,
+                  s.slope,
+                  s.limit);
+    }
+}
+
+bool loadProfile(const char *name)
+{
+    char path[Profile::maxNameLength + 16];
+    snprintf(path, sizeof(path), "/profiles/%s.json", name);
+
+    File profileFile = LittleFS.open(path, "r");
+    if (!profileFile)
+    {
+        return false;
+    }
+
+    // Profile files look like
+    // {"points": [[0, 25], [90000, 90], ...]}
+    StaticJsonDocument<2048> &doc = profileDoc;
+    DeserializationError error = deserializeJson(doc, profileFile);
+    profileFile.close();
+    if (error)
+    {
+        return false;
+    }
+
+    ReflowCurvePoint points[Profile::maxPoints + 1];
+    int numPoints = 0;
+    for (JsonVariant point : doc["points"].as<JsonArray>())
+    {
+        if (numPoints == Profile::maxPoints)
+        {
+            return false;
+        }
+        // Times must be increasing; a
+        // repeated one would be a zero
+        // length segment
+        points[numPoints].time_ms = point[0] | -1;
+        points[numPoints].temp_c = point[1] | 0;
+        if (points[numPoints].time_ms < 0 ||
+            (numPoints > 0 && points[numPoints].time_ms <= points[numPoints - 1].time_ms))
+        {
+            logPrintf("Profile %s: point %d time isn't after the one before\n", name, numPoints);
+            return false;
+        }
+        numPoints++;
+    }
+    points[numPoints].time_ms = -1;
+    points[numPoints].temp_c = -1;
+
+    if (numPoints < 2 || runState.isRunning())
+    {
+        return false;
+    }
+
+    return profile.set(name, points);
+}
+
+void setControllerMode(ControllerMode mode)
+{
+    // Zones switch over on their next
+    // update; the PID re-initializes from
+    // the MPC output and the MPC starts
+    // from the PID output
+    if (mode == CONTROLLER_MPC && controllerMode != CONTROLLER_MPC)
+    {
+        for (int i = 0; i < numZones; i++)
+        {
+            zoneMpcs[i].reset(zones[i].getOutput() / zones[i].getMaxDuty());
+        }
+    }
+    controllerMode = mode;
+
+    logPrintf("Controller: %s\n", controllerMode == CONTROLLER_MPC ? "MPC" : "PID");
+}
+
+void printRunSummary(const char *result)
+{
+    for (int i = 0; i < numZones; i++)
+    {
+        const RunStats &stats = zoneRunStats[i];
+        logPrintf("Run %s: zone %s, %s, RMS error %.2f C, overshoot %.2f C, undershoot %.2f C, compute %.1f us avg %ld us max\n",
+                  result,
+                  zones[i].getName(),
+                  controllerMode == CONTROLLER_MPC ? "MPC" : "PID",
+                  stats.getRmsError(),
+                  stats.maxOvershoot,
+                  stats.maxUndershoot,
+                  stats.getAvgCompute_us(),
+                  stats.maxCompute_us);
+
+        const LatencyStats &latency = zoneLatency[i];
+        // Actuation here is the duty write;
+        // the output can take up to one PWM
+        // period or tick more to follow
+        logPrintf("Run %s: zone %s latency avg/max us: sample age %.0f/%ld, filter %.0f/%ld, compute %.0f/%ld, write %.0f/%ld, sensor to actuation %.0f/%ld, plus up to %lld to apply\n",
+                  result,
+                  zones[i].getName(),
+                  latency.getAvg_us(LATENCY_SAMPLE_AGE),
+                  latency.max_us[LATENCY_SAMPLE_AGE],
+                  latency.getAvg_us(LATENCY_FILTER),
+                  latency.max_us[LATENCY_FILTER],
+                  latency.getAvg_us(LATENCY_COMPUTE),
+                  latency.max_us[LATENCY_COMPUTE],
+                  latency.getAvg_us(LATENCY_WRITE),
+                  latency.max_us[LATENCY_WRITE],
+                  latency.getAvgEndToEnd_us(),
+                  latency.maxEndToEnd_us,
+                  (long long)HeaterOutput::getApplyDelay_us());
+
+        double energy = zoneEnergy[i].getEnergy();
+        logPrintf("Run %s: zone %s energy %.1f kJ (%.2f Wh), coast %s\n",
+                  result,
+                  zones[i].getName(),
+                  energy / 1000.0,
+                  energy / 3600.0,
+                  energyConfig.coast ? "on" : "off");
+
+        // Completed runs are compared with
+        // the last completed run of the same
+        // profile in the other coast mode
+        if (strcmp(result, "completed") != 0)
+        {
+            continue;
+        }
+        EnergyRecord &record = lastRunEnergy[i][energyConfig.coast ? 1 : 0];
+        strcpy(record.profile, profile.getName());
+        record.energy = energy;
+        record.rmsError = stats.getRmsError();
+
+        const EnergyRecord &off = lastRunEnergy[i][0];
+        const EnergyRecord &on = lastRunEnergy[i][1];
+        if (strcmp(off.profile, on.profile) == 0 && off.energy > 0.0)
+        {
+            logPrintf("Run %s: zone %s coast saves %.1f kJ (%.1f%%) for %+.2f C RMS error on %s\n",
+                      result,
+                      zones[i].getName(),
+                      (off.energy - on.energy) / 1000.0,
+                      100.0 * (off.energy - on.energy) / off.energy,
+                      on.rmsError - off.rmsError,
+                      on.profile);
+        }
+    }
+}
+
+void finishCharacterization()
+{
+    PlateModel model = plateModel;
+    double rmsError = 0.0;
+
+    // The LMT85 sits on the board, a
+    // second, slower node; its fit is only
+    // reported, with the lag it implies
+    PlateModel boardModel = plateModel;
+    double boardRmsError = 0.0;
+    bool boardFit = systemId.getModel(SYSID_LMT85, boardModel, boardRmsError);
+    if (boardFit)
+    {
+        logPrintf("Characterization: LMT85 gain %.1f C, tau %.1f s, dead time %.1f s, ambient %.1f C, fit %.2f C rms\n",
+                  boardModel.gain, boardModel.tau, boardModel.deadTime, boardModel.ambient, boardRmsError);
+    }
+
+    if (!systemId.getModel(SYSID_TC1, model, rmsError))
+    {
+        logPrintf("Characterization: no usable TC1 fit after %ld samples; model unchanged\n", systemId.getSamples());
+        return;
+    }
+    logPrintf("Characterization: TC1 gain %.1f C, tau %.1f s, dead time %.1f s, ambient %.1f C, fit %.2f C rms\n",
+              model.gain, model.tau, model.deadTime, model.ambient, rmsError);
+
+    // Two lags in series fit as roughly
+    // one with their sum; the difference
+    // is what "estimatorLag" wants
+    if (boardFit && boardModel.tau > model.tau)
+    {
+        logPrintf("Characterization: LMT85 lags the plate by about %.0f s\n", boardModel.tau - model.tau);
+    }
+
+    // The estimator and the profile pick
+    // the new model up now and the MPC at
+    // the next run
+    plateModel = model;
+    estimator.begin(plateModel, loopDelay / 1000.0, NAN);
+    compileProfile();
+    if (!savePlateModel(identifiedModelPath, plateModel, rmsError))
+    {
+        logPrintf("Characterization: failed to save %s\n", identifiedModelPath);
+    }
+
+    // SIMC PI tuning for the fitted model
+    // with the closed loop time constant
+    // set to the dead time, in PID output
+    // counts
+    double tauC = model.deadTime > 1.0 ? model.deadTime : 1.0;
+    double kc = model.tau / (model.gain * (tauC + model.deadTime));
+    double ti = model.tau < 4.0 * (tauC + model.deadTime) ? model.tau : 4.0 * (tauC + model.deadTime);
+    logPrintf("Characterization: suggested PID Kp=%.2f Ki=%.3f Kd=0\n",
+              kc * pidOutputMax,
+              kc * pidOutputMax / ti);
+}
+
+bool beginCalibration()
+{
+    if (calibrationConfig.numSetpoints == 0)
+    {
+        return false;
+    }
+
+    // Record what the sensors read
+    // uncorrected
+    calibration.setEnabled(false);
+    calibrator.start(calibrationConfig, millis());
+    calibrationRunning = true;
+    data.setSetpoint(calibrator.getSetpoint());
+    logPrintf("Starting sensor calibration, %d setpoints, first %.0f C\n",
+              calibrator.getNumSteps(), calibrator.getSetpoint());
+
+    return true;
+}
+
+// Stops heating and puts the stored
+// correction back; result is logged
+// unless NULL
+void endCalibration(const char *result)
+{
+    calibrationRunning = false;
+    cancelCalibration = false;
+    data.setSetpoint(0);
+    for (int i = 0; i < numZones; i++)
+    {
+        zones[i].off();
+    }
+    calibration.setEnabled(true);
+
+    if (result != NULL)
+    {
+        logPrintf("Calibration %s at step %d/%d; calibration unchanged\n",
+                  result, calibrator.getStep() + 1, calibrator.getNumSteps());
+    }
+}
+
+void finishCalibration()
+{
+    int numPoints = calibrator.getNumPoints();
+    const CalibrationPoint *points = calibrator.getPoints();
+    if (numPoints == 0)
+    {
+        logPrintf("Calibration: no usable points; calibration unchanged\n");
+        return;
+    }
+
+    for (int i = 0; i < numPoints; i++)
+    {
+        logPrintf("Calibration: reference %.2f C, TC1 %+.2f C, TC2 %+.2f C, LMT85 %+.2f C\n",
+                  points[i].reference,
+                  points[i].raw[CAL_SENSOR_TC1] - points[i].reference,
+                  points[i].raw[CAL_SENSOR_TC2] - points[i].reference,
+                  points[i].raw[CAL_SENSOR_LMT85] - points[i].reference);
+    }
+
+    xSemaphoreTake(calibrationMutex, portMAX_DELAY);
+    bool ok = calibration.set(points, numPoints) && saveCalibration(calibrationPath, calibration);
+    xSemaphoreGive(calibrationMutex);
+    if (!ok)
+    {
+        logPrintf("Calibration: failed to save %s\n", calibrationPath);
+    }
+}
+
+void handleCalibrationExport(AsyncWebServerRequest *request)
+{
+    if (!LittleFS.exists(calibrationPath))
+    {
+        request->send(404, "text/plain", "No calibration\n");
+        return;
+    }
+    request->send(LittleFS, calibrationPath, "application/json");
+}
+
+// Import bodies arrive in chunks;
+// anything too big is refused once the
+// request completes
+void handleCalibrationBody(AsyncWebServerRequest *, uint8_t *bytes, size_t len, size_t index, size_t total)
+{
+    if (total < sizeof(calibrationImport))
+    {
+        memcpy(calibrationImport + index, bytes, len);
+    }
+}
+
+void handleCalibrationImport(AsyncWebServerRequest *request)
+{
+    size_t length = request->contentLength();
+    if (length == 0 || length >= sizeof(calibrationImport))
+    {
+        request->send(413, "text/plain", "Calibration too large\n");
+        return;
+    }
+    if (calibrationRunning)
+    {
+        request->send(409, "text/plain", "Calibration in progress\n");
+        return;
+    }
+
+    xSemaphoreTake(calibrationMutex, portMAX_DELAY);
+    bool ok = importCalibration(calibrationImport, length, calibration);
+    bool saved = ok && saveCalibration(calibrationPath, calibration);
+    xSemaphoreGive(calibrationMutex);
+
+    if (!ok)
+    {
+        request->send(400, "text/plain", "Invalid calibration\n");
+        return;
+    }
+    logPrintf("Calibration: imported %d points\n", calibration.getNumPoints());
+    if (!saved)
+    {
+        logPrintf("Calibration: failed to save %s\n", calibrationPath);
+    }
+    request->send(200, "text/plain", "Calibration imported\n");
+}
+
+void learnFromRun()
+{
+    for (int i = 0; i < numZones; i++)
+    {
+        Ilc &ilc = zoneIlcs[i];
+        if (!ilc.isEnabled())
+        {
+            continue;
+        }
+
+        // Report tracking error run over
+        // run; the first run has nothing
+        // to compare against
+        ilc.learn();
+        if (ilc.getRuns() > 1)
+        {
+            logPrintf("Learning: zone %s, profile %s, run %d, RMS error %.2f C (previous run %.2f C)\n",
+                      zones[i].getName(),
+                      profile.getName(),
+                      ilc.getRuns(),
+                      ilc.getRmsError(),
+                      ilc.getPrevRmsError());
+        }
+        else
+        {
+            logPrintf("Learning: zone %s, profile %s, first run, RMS error %.2f C\n",
+                      zones[i].getName(),
+                      profile.getName(),
+                      ilc.getRmsError());
+        }
+        if (!ilc.save())
+        {
+            logPrintf("Learning: failed to save correction for zone %s\n", zones[i].getName());
+        }
+    }
+}
+
+void scheduleGains(int zone, double target, double slope)
+{
+    // Off or idle zones run on the fixed
+    // gains
+    int idx = target > 0.0 ? gainSchedule.select(target, slope) : -1;
+    if (idx == zoneGainIdx[zone])
+    {
+        return;
+    }
+
+    zoneGainIdx[zone] = idx;
+    if (idx < 0)
+    {
+        PidGains gains = {Kp, Ki, Kd};
+        zones[zone].setGains(gains);
+        logPrintf("Gains: zone %s, fixed Kp=%.2f Ki=%.3f Kd=%.2f\n", zones[zone].getName(), Kp, Ki, Kd);
+        return;
+    }
+
+    const GainScheduleEntry &entry = gainSchedule.getEntry(idx);
+    zones[zone].setGains(entry.gains);
+    logPrintf("Gains: zone %s, up to %.0f C %s, Kp=%.2f Ki=%.3f Kd=%.2f\n",
+              zones[zone].getName(),
+              entry.upTo,
+              GainSchedule::getPhaseName(entry.phase),
+              entry.gains.kp,
+              entry.gains.ki,
+              entry.gains.kd);
+}
+
+void handleMetrics(AsyncWebServerRequest *request)
+{
+    // Counters are read without locking;
+    // the mutex only guards the text
+    // buffer. The response reads the
+    // buffer as it goes out, so it stays
+    // held until the request is freed; a
+    // scrape that overlaps is turned away
+    // rather than left waiting on the
+    // task that sends the first
+    if (xSemaphoreTake(metricsMutex, 0) != pdTRUE)
+    {
+        request->send(503, "text/plain", "Metrics busy\n");
+        return;
+    }
+    MetricsWriter w(metricsText, sizeof(metricsText));
+    w.counters(metrics);
+
+    char labels[64];
+    w.family("reflow_temperature_celsius", "gauge", "Latest sensor readings");
+    w.gauge("sensor=\"tc1\"", data.getTc1Temp());
+    w.gauge("sensor=\"tc2\"", data.getTc2Temp());
+    w.gauge("sensor=\"lmt85\"", data.getLmt85Temp());
+    if (estimatorEnabled)
+    {
+        w.gauge("sensor=\"estimate\"", data.getEstimateTemp());
+    }
+    w.family("reflow_setpoint_celsius", "gauge", "Current setpoint; 0 is off");
+    w.gauge(NULL, data.getSetpoint());
+
+    w.family("reflow_heater_duty_ratio", "gauge", "Heater duty per zone");
+    for (int z = 0; z < numZones; z++)
+    {
+        snprintf(labels, sizeof(labels), "zone=\"%s\"", zones[z].getName());
+        w.gauge(labels, zones[z].getOutput() / zones[z].getMaxDuty());
+    }
+    w.family("reflow_heater_energy_joules", "counter", "Heater energy per zone since boot");
+    for (int z = 0; z < numZones; z++)
+    {
+        snprintf(labels, sizeof(labels), "zone=\"%s\"", zones[z].getName());
+        w.counter(labels, (uint32_t)zoneEnergy[z].getTotal());
+    }
+    w.family("reflow_run_energy_joules", "gauge", "Heater energy this run or the last, all zones");
+    w.gauge(NULL, runEnergy_J);
+    w.family("reflow_pid_term", "gauge", "PID terms behind the last output, on the 0 - 4095 output scale");
+    for (int z = 0; z < numZones; z++)
+    {
+        double terms[3];
+        const char *const termNames[3] = {"p", "i", "d"};
+        zones[z].getPidTerms(terms[0], terms[1], terms[2]);
+        for (int t = 0; t < 3; t++)
+        {
+            snprintf(labels, sizeof(labels), "zone=\"%s\",term=\"%s\"", zones[z].getName(), termNames[t]);
+            w.gauge(labels, terms[t]);
+        }
+    }
+
+    w.family("reflow_run_state", "stateset", "Reflow run state");
+    RunState state = runState.getState();
+    for (int s = 0; s < RUN_STATE_COUNT; s++)
+    {
+        w.state(RunStateMachine::getStateName((RunState)s), s == state);
+    }
+    w.family("reflow_supervisor_fault_flags", "gauge", "Latched supervisor fault bits");
+    w.gauge(NULL, supervisor.getFaults());
+
+    w.family("reflow_thermocouple_read_seconds", "gauge", "Time taken by the last read of both thermocouples");
+    w.gauge(NULL, tcRead_us / 1e6);
+
+    w.family("reflow_idle", "gauge", "1 while sensors and control run at idle rates");
+    w.gauge(NULL, idleTracker.isIdle() ? 1 : 0);
+    w.family("reflow_idle_seconds", "counter", "Time spent idle");
+    w.counter(NULL, (uint32_t)(idleTracker.getIdleTime_us(esp_timer_get_time()) / 1000000));
+    w.family("reflow_idle_wake_seconds", "gauge", "Time the last wake from idle took to get every sensor back to full rate");
+    w.gauge(NULL, idleTracker.getWakeLatency_us() / 1e6);
+
+    w.family("reflow_telemetry_clients", "gauge", "Connected CSV clients");
+    w.gauge(NULL, csvConns.getCount());
+    w.family("reflow_heap_free_bytes", "gauge", "Free heap");
+    w.gauge(NULL, heap_caps_get_free_size(MALLOC_CAP_8BIT));
+    w.family("reflow_uptime_seconds", "gauge", "Time since boot");
+    w.gauge(NULL, millis() / 1000.0);
+
+    int len = w.end();
+    if (w.isTruncated())
+    {
+        logPrintf("Metrics: families past %u bytes dropped\n", (unsigned int)sizeof(metricsText));
+    }
+    // Sent from the buffer itself, with no
+    // String copy on the heap
+    request->onDisconnect([]() { xSemaphoreGive(metricsMutex); });
+    request->send(request->beginResponse_P(200,
+                                           "application/openmetrics-text; version=1.0.0; charset=utf-8",
+                                           (const uint8_t *)metricsText,
+                                           len));
+}
+
+void memoryReport(void *)
+{
+    while (true)
+    {
+        vTaskDelay(config.getMemoryReportPeriod() * 1000 / portTICK_PERIOD_MS);
+
+        multi_heap_info_t heapInfo;
+        heap_caps_get_info(&heapInfo, MALLOC_CAP_8BIT);
+        logPrintf("Memory: uptime %lu s, free %u, min free %u, largest block %u, allocated blocks %u (%+d since boot)\n",
+                  millis() / 1000,
+                  (unsigned int)heapInfo.total_free_bytes,
+                  (unsigned int)heapInfo.minimum_free_bytes,
+                  (unsigned int)heapInfo.largest_free_block,
+                  (unsigned int)heapInfo.allocated_blocks,
+                  (int)(heapInfo.allocated_blocks - baselineAllocatedBlocks));
+
+        // Least stack each task has had free
+        // since it started (bytes)
+        logPrintf("Stack free: TCs %u, LMT85 %u, display %u, CSV %u, supervisor %u, loop %u\n",
+                  (unsigned int)uxTaskGetStackHighWaterMark(tcTaskHandle),
+                  (unsigned int)uxTaskGetStackHighWaterMark(lmt85TaskHandle),
+                  (unsigned int)uxTaskGetStackHighWaterMark(updateDisplayTaskHandle),
+                  (unsigned int)uxTaskGetStackHighWaterMark(csvServerTaskHandle),
+                  (unsigned int)uxTaskGetStackHighWaterMark(supervisorTaskHandle),
+                  (unsigned int)uxTaskGetStackHighWaterMark(loopTaskHandle));
+    }
+}
+
+void logPrintf(const char *format, ...)
+{
+    va_list args;
+
+    xSemaphoreTake(logMutex, portMAX_DELAY);
+    va_start(args, format);
+    vsnprintf(logBuffer, sizeof(logBuffer), format, args);
+    va_end(args);
+    Serial.print(logBuffer);
+    xSemaphoreGive(logMutex);
+}
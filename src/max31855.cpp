@@ -0,0 +1,61 @@
+#include <Arduino.h>
+#include <SPI.h>
+#include "max31855.hpp"
+
+Max31855Bus::Max31855Bus(SPIClass &spi, int sckPin, int misoPin)
+    : _spi(spi),
+      _sckPin(sckPin),
+      _misoPin(misoPin),
+      _numChips(0) {}
+
+int Max31855Bus::addChip(int csPin)
+{
+    if (_numChips >= maxChips)
+    {
+        return -1;
+    }
+
+    _csPins[_numChips] = csPin;
+
+    return _numChips++;
+}
+
+bool Max31855Bus::begin()
+{
+    for (int i = 0; i < _numChips; i++)
+    {
+        pinMode(_csPins[i], OUTPUT);
+        digitalWrite(_csPins[i], HIGH);
+    }
+
+    // Receive only; no MOSI or hardware
+    // chip select
+    _spi.begin(_sckPin, _misoPin, -1, -1);
+
+    // Let a conversion complete
+    delay(100);
+
+    uint32_t frames[maxChips];
+    read(frames);
+    for (int i = 0; i < _numChips; i++)
+    {
+        if (!isMax31855FrameValid(frames[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void Max31855Bus::read(uint32_t *frames)
+{
+    _spi.beginTransaction(SPISettings(clock_Hz, MSBFIRST, SPI_MODE0));
+    for (int i = 0; i < _numChips; i++)
+    {
+        digitalWrite(_csPins[i], LOW);
+        frames[i] = _spi.transfer32(0);
+        digitalWrite(_csPins[i], HIGH);
+    }
+    _spi.endTransaction();
+}
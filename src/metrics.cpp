@@ -0,0 +1,136 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "metrics.hpp"
+
+// Family, help and labels per counter;
+// counters of one family are adjacent
+struct CounterInfo
+{
+    const char *family;
+    const char *help;
+    const char *labels;
+};
+
+static const CounterInfo counterInfo[COUNTER_COUNT] = {
+    {"reflow_samples", "Sensor samples read", "channel=\"tc1\""},
+    {"reflow_samples", NULL, "channel=\"tc2\""},
+    {"reflow_samples", NULL, "channel=\"lmt85\""},
+    {"reflow_thermocouple_faults", "Thermocouple reads with a fault", "channel=\"tc1\",type=\"open\""},
+    {"reflow_thermocouple_faults", NULL, "channel=\"tc1\",type=\"short_gnd\""},
+    {"reflow_thermocouple_faults", NULL, "channel=\"tc1\",type=\"short_vcc\""},
+    {"reflow_thermocouple_faults", NULL, "channel=\"tc2\",type=\"open\""},
+    {"reflow_thermocouple_faults", NULL, "channel=\"tc2\",type=\"short_gnd\""},
+    {"reflow_thermocouple_faults", NULL, "channel=\"tc2\",type=\"short_vcc\""},
+    {"reflow_i2c_failures", "Failed I2C reads", "device=\"adc\""},
+    {"reflow_display_refreshes", "OLED display updates", NULL},
+    {"reflow_telemetry_sent_bytes", "CSV telemetry bytes sent", NULL},
+    {"reflow_telemetry_connects", "CSV clients accepted", NULL},
+    {"reflow_telemetry_drops", "CSV clients dropped or disconnected", NULL},
+    {"reflow_telemetry_commands", "CSV client commands answered", NULL},
+    {"reflow_runs", "Reflow runs ended", "result=\"completed\""},
+    {"reflow_runs", NULL, "result=\"cancelled\""},
+    {"reflow_runs", NULL, "result=\"faulted\""},
+    {"reflow_supervisor_faults", "Faults latched by the supervisor", NULL},
+};
+
+static const char metricsEof[] = "# EOF\n";
+
+MetricsWriter::MetricsWriter(char *buf, size_t size)
+    : _buf(buf),
+      _size(size - (sizeof(metricsEof) - 1)),
+      _len(0),
+      _truncated(false),
+      _family(""),
+      _familyStart(0)
+{
+    _buf[0] = '\0';
+}
+
+void MetricsWriter::family(const char *name, const char *type, const char *help)
+{
+    _family = name;
+    _familyStart = _len;
+    if (help != NULL)
+    {
+        append("# HELP %s %s\n", name, help);
+    }
+    append("# TYPE %s %s\n", name, type);
+}
+
+void MetricsWriter::counter(const char *labels, uint32_t value)
+{
+    sampleName("_total", labels);
+    append(" %u\n", (unsigned int)value);
+}
+
+void MetricsWriter::gauge(const char *labels, double value)
+{
+    sampleName("", labels);
+    // Enough digits for byte counts and
+    // microsecond timings alike
+    append(" %.9g\n", value);
+}
+
+void MetricsWriter::state(const char *name, bool active)
+{
+    append("%s{%s=\"%s\"} %d\n", _family, _family, name, active ? 1 : 0);
+}
+
+void MetricsWriter::counters(const Metrics &metrics)
+{
+    for (int i = 0; i < COUNTER_COUNT; i++)
+    {
+        const CounterInfo &info = counterInfo[i];
+        if (i == 0 || strcmp(info.family, counterInfo[i - 1].family) != 0)
+        {
+            family(info.family, "counter", info.help);
+        }
+        counter(info.labels, metrics.get((Counter)i));
+    }
+}
+
+int MetricsWriter::end()
+{
+    // _size left room for it
+    strcpy(_buf + _len, metricsEof);
+    _len += sizeof(metricsEof) - 1;
+
+    return _len;
+}
+
+void MetricsWriter::sampleName(const char *suffix, const char *labels)
+{
+    if (labels != NULL)
+    {
+        append("%s%s{%s}", _family, suffix, labels);
+    }
+    else
+    {
+        append("%s%s", _family, suffix);
+    }
+}
+
+void MetricsWriter::append(const char *format, ...)
+{
+    if (_truncated)
+    {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(_buf + _len, _size - _len, format, args);
+    va_end(args);
+
+    // Drop the family that doesn't fit,
+    // and everything after it
+    if (len < 0 || (size_t)len >= _size - _len)
+    {
+        _truncated = true;
+        _len = _familyStart;
+        _buf[_len] = '\0';
+        return;
+    }
+    _len += len;
+}
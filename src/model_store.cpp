@@ -0,0 +1,47 @@
+#include <LittleFS.h>
+#include <ArduinoJson.h>
+#include "model_store.hpp"
+
+bool loadPlateModel(const char *path, PlateModel &model)
+{
+    File file = LittleFS.open(path, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    StaticJsonDocument<256> doc;
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error || doc["gain"].isNull() || doc["tau"].isNull())
+    {
+        return false;
+    }
+
+    model.gain = doc["gain"];
+    model.tau = doc["tau"];
+    model.deadTime = doc["deadTime"] | 0.0;
+    model.ambient = doc["ambient"] | model.ambient;
+
+    return true;
+}
+
+bool savePlateModel(const char *path, const PlateModel &model, double rmsError)
+{
+    File file = LittleFS.open(path, "w", true);
+    if (!file)
+    {
+        return false;
+    }
+
+    StaticJsonDocument<256> doc;
+    doc["gain"] = model.gain;
+    doc["tau"] = model.tau;
+    doc["deadTime"] = model.deadTime;
+    doc["ambient"] = model.ambient;
+    doc["rmsError"] = rmsError;
+    bool ok = serializeJson(doc, file) > 0;
+    file.close();
+
+    return ok;
+}
@@ -0,0 +1,206 @@
+#include <math.h>
+#include "mpc.hpp"
+
+Mpc::Mpc()
+    : _model(defaultPlateModel),
+      _config(defaultMpcConfig),
+      _a(1.0f),
+      _heaterGain(0.0f),
+      _ambientGain(0.0f),
+      _delaySteps(0),
+      _prevGain(0.0f),
+      _lastDuty(0.0)
+{
+    for (int j = 0; j < maxHorizon; j++)
+    {
+        _gain[j] = 0.0f;
+    }
+}
+
+bool Mpc::begin(const PlateModel &model, const MpcConfig &config)
+{
+    if (config.horizon < 1 || config.horizon > maxHorizon ||
+        config.blocks < 1 || config.blocks > maxBlocks ||
+        config.blocks > config.horizon || config.step <= 0.0)
+    {
+        return false;
+    }
+
+    _model = model;
+    _config = config;
+
+    // Discretize over one prediction step
+    double a = exp(-_config.step / _model.tau);
+    _a = a;
+    _heaterGain = (1.0 - a) * _model.gain;
+    _ambientGain = (1.0 - a) * _model.ambient;
+    _delaySteps = (int)(_model.deadTime / _config.step + 0.5);
+
+    const int n = _config.horizon;
+    const int m = _config.blocks;
+    const int blockLen = (n + m - 1) / m;
+
+    // Step response of each output to each
+    // duty block (phi), delayed by the
+    // dead time
+    double phi[maxHorizon][maxBlocks];
+    for (int j = 0; j < n; j++)
+    {
+        for (int b = 0; b < m; b++)
+        {
+            phi[j][b] = 0.0;
+        }
+
+        // Output j + 1 sees inputs 0..j, each
+        // decayed by a^(j - i), shifted by
+        // the dead time
+        double decay = 1.0;
+        for (int i = j; i >= 0; i--)
+        {
+            int move = i - _delaySteps;
+            if (move >= 0)
+            {
+                int b = move / blockLen;
+                if (b >= m)
+                {
+                    b = m - 1;
+                }
+                phi[j][b] += decay * _heaterGain;
+            }
+            decay *= a;
+        }
+    }
+
+    // H = phi' phi + w D' D, where D takes
+    // first differences of the blocks
+    // (the first against the last duty)
+    double h[maxBlocks][2 * maxBlocks];
+    for (int r = 0; r < m; r++)
+    {
+        for (int c = 0; c < m; c++)
+        {
+            double sum = 0.0;
+            for (int j = 0; j < n; j++)
+            {
+                sum += phi[j][r] * phi[j][c];
+            }
+            h[r][c] = sum;
+            h[r][m + c] = (r == c) ? 1.0 : 0.0;
+        }
+
+        h[r][r] += (r < m - 1) ? 2.0 * _config.moveWeight : _config.moveWeight;
+        if (r > 0)
+        {
+            h[r][r - 1] -= _config.moveWeight;
+        }
+        if (r < m - 1)
+        {
+            h[r][r + 1] -= _config.moveWeight;
+        }
+    }
+
+    // Invert H by Gauss-Jordan elimination
+    // with partial pivoting
+    for (int col = 0; col < m; col++)
+    {
+        int pivot = col;
+        for (int r = col + 1; r < m; r++)
+        {
+            if (fabs(h[r][col]) > fabs(h[pivot][col]))
+            {
+                pivot = r;
+            }
+        }
+        if (fabs(h[pivot][col]) < 1e-12)
+        {
+            return false;
+        }
+        if (pivot != col)
+        {
+            for (int c = 0; c < 2 * m; c++)
+            {
+                double tmp = h[col][c];
+                h[col][c] = h[pivot][c];
+                h[pivot][c] = tmp;
+            }
+        }
+
+        double scale = 1.0 / h[col][col];
+        for (int c = 0; c < 2 * m; c++)
+        {
+            h[col][c] *= scale;
+        }
+        for (int r = 0; r < m; r++)
+        {
+            if (r != col && h[r][col] != 0.0)
+            {
+                double factor = h[r][col];
+                for (int c = 0; c < 2 * m; c++)
+                {
+                    h[r][c] -= factor * h[col][c];
+                }
+            }
+        }
+    }
+
+    // Only the first block is ever applied,
+    // so keep just the first row of
+    // H^-1 phi' and the weight on the
+    // last duty
+    for (int j = 0; j < n; j++)
+    {
+        double sum = 0.0;
+        for (int b = 0; b < m; b++)
+        {
+            sum += h[0][m + b] * phi[j][b];
+        }
+        _gain[j] = sum;
+    }
+    _prevGain = _config.moveWeight * h[0][m];
+
+    return true;
+}
+
+void Mpc::reset(double duty)
+{
+    _lastDuty = duty;
+}
+
+double Mpc::compute(double temp, const Trajectory &trajectory, unsigned long curveTime, double offset)
+{
+    const unsigned long step_ms = _config.step * 1000.0;
+
+    // Free response: the plate decaying
+    // towards ambient with the last duty
+    // still in the dead time pipeline
+    float freeTemp = temp;
+    float duty = _prevGain * _lastDuty;
+    for (int j = 0; j < _config.horizon; j++)
+    {
+        freeTemp = _a * freeTemp + _ambientGain;
+        if (j < _delaySteps)
+        {
+            freeTemp += _heaterGain * _lastDuty;
+        }
+
+        double target = trajectory.setpointAt(curveTime + (j + 1) * step_ms);
+        if (target > 0.0)
+        {
+            target += offset;
+        }
+
+        duty += _gain[j] * (target - freeTemp);
+    }
+
+    if (duty < 0.0f)
+    {
+        duty = 0.0f;
+    }
+    else if (duty > 1.0f)
+    {
+        duty = 1.0f;
+    }
+
+    _lastDuty = duty;
+    return duty;
+}
@@ -0,0 +1,151 @@
+#include "run_state.hpp"
+
+bool RunStateMachine::start()
+{
+    if (_state != RUN_IDLE && _state != RUN_DONE)
+    {
+        return false;
+    }
+
+    _state = RUN_PREHEAT;
+
+    return true;
+}
+
+bool RunStateMachine::cancel()
+{
+    if (!isRunning())
+    {
+        return false;
+    }
+
+    _state = RUN_IDLE;
+
+    return true;
+}
+
+bool RunStateMachine::fault()
+{
+    if (_state == RUN_FAULT)
+    {
+        return false;
+    }
+
+    _state = RUN_FAULT;
+
+    return true;
+}
+
+bool RunStateMachine::clearFault()
+{
+    if (_state != RUN_FAULT)
+    {
+        return false;
+    }
+
+    _state = RUN_IDLE;
+
+    return true;
+}
+
+bool RunStateMachine::advance(const Profile &profile, unsigned long curveTime)
+{
+    if (!isRunning())
+    {
+        return false;
+    }
+
+    RunState next = phaseAt(profile, curveTime);
+    if (next == _state)
+    {
+        return false;
+    }
+
+    _state = next;
+
+    return true;
+}
+
+RunState RunStateMachine::phaseAt(const Profile &profile, unsigned long curveTime)
+{
+    int numPoints = profile.getNumPoints();
+    if (numPoints < 2 || curveTime >= profile.getDuration())
+    {
+        return RUN_DONE;
+    }
+
+    // The peak is the first hottest point
+    int peak = 0;
+    for (int i = 1; i < numPoints; i++)
+    {
+        if (profile.getPoint(i).temp_c > profile.getPoint(peak).temp_c)
+        {
+            peak = i;
+        }
+    }
+
+    // Segment i runs from point i - 1
+    // to point i
+    int segment = 1;
+    while (curveTime >= (unsigned long)profile.getPoint(segment).time_ms)
+    {
+        segment++;
+    }
+
+    if (segment > peak)
+    {
+        return RUN_COOLING;
+    }
+    if (segment == peak)
+    {
+        return RUN_REFLOW;
+    }
+    if (segment == 1)
+    {
+        return RUN_PREHEAT;
+    }
+
+    return RUN_SOAK;
+}
+
+const char *RunStateMachine::getStateName(RunState state)
+{
+    switch (state)
+    {
+    case RUN_IDLE:
+        return "idle";
+    case RUN_PREHEAT:
+        return "preheat";
+    case RUN_SOAK:
+        return "soak";
+    case RUN_REFLOW:
+        return "reflow";
+    case RUN_COOLING:
+        return "cooling";
+    case RUN_DONE:
+        return "done";
+    case RUN_FAULT:
+        return "fault";
+    default:
+        return "unknown";
+    }
+}
+
+const char *RunStateMachine::getEventName(RunEventType type)
+{
+    switch (type)
+    {
+    case EVENT_BUTTON:
+        return "button";
+    case EVENT_START:
+        return "start";
+    case EVENT_CANCEL:
+        return "cancel";
+    case EVENT_FAULT:
+        return "fault";
+    case EVENT_FAULT_CLEARED:
+        return "fault cleared";
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,187 @@
+#include <math.h>
+#include "supervisor.hpp"
+
+Supervisor::Supervisor()
+    : _limits(defaultSupervisorLimits),
+      _faults(FAULT_NONE),
+      _onset_us(0),
+      _reacted(false),
+      _injected(false),
+      _injectedAt_us(0),
+      _lastLatency_us(0),
+      _maxLatency_us(0),
+      _windowStart_us(-1),
+      _windowStartTemp(0.0),
+      _windowHeating(false) {}
+
+void Supervisor::begin(const SupervisorLimits &limits)
+{
+    _limits = limits;
+    _faults = FAULT_NONE;
+    _windowStart_us = -1;
+}
+
+uint32_t Supervisor::check(const SupervisorInputs &inputs, int64_t now_us)
+{
+    int64_t onset_us = now_us;
+    uint32_t faults = evaluate(inputs, now_us, &onset_us);
+
+    if (faults != FAULT_NONE)
+    {
+        // Only the first fault of a latch
+        // defines its onset
+        if (_faults == FAULT_NONE)
+        {
+            _onset_us = onset_us;
+            _reacted = false;
+        }
+        _faults |= faults;
+    }
+
+    return _faults;
+}
+
+void Supervisor::heatersOff(int64_t now_us)
+{
+    if (_faults == FAULT_NONE || _reacted)
+    {
+        return;
+    }
+
+    _reacted = true;
+    _lastLatency_us = now_us - _onset_us;
+    if (_lastLatency_us > _maxLatency_us)
+    {
+        _maxLatency_us = _lastLatency_us;
+    }
+}
+
+bool Supervisor::clear(const SupervisorInputs &inputs, int64_t now_us)
+{
+    int64_t onset_us;
+    _injected.store(false, std::memory_order_relaxed);
+    if (evaluate(inputs, now_us, &onset_us) != FAULT_NONE)
+    {
+        return false;
+    }
+
+    _faults = FAULT_NONE;
+    _windowStart_us = -1;
+    return true;
+}
+
+void Supervisor::inject(int64_t now_us)
+{
+    _injectedAt_us = now_us;
+    _injected.store(true, std::memory_order_release);
+}
+
+uint32_t Supervisor::evaluate(const SupervisorInputs &inputs, int64_t now_us, int64_t *onset_us)
+{
+    uint32_t faults = FAULT_NONE;
+    int64_t onset = now_us;
+    const int64_t maxAge_us = (int64_t)_limits.maxSampleAge_ms * 1000;
+
+    // Sample age; the fault began the
+    // moment the last sample got too old
+    for (int i = 0; i < SUPERVISOR_CHANNEL_COUNT; i++)
+    {
+        if ((_limits.requiredChannels & (1 << i)) == 0)
+        {
+            continue;
+        }
+
+        int64_t staleAt_us = inputs.timestamp_us[i] + maxAge_us;
+        if (now_us >= staleAt_us || isnan(inputs.temp[i]))
+        {
+            faults |= 1 << i;
+            if (staleAt_us < onset)
+            {
+                onset = staleAt_us;
+            }
+        }
+    }
+
+    // Over temperature on any fresh
+    // plate sensor
+    for (int i = 0; i < SUPERVISOR_CHANNEL_COUNT; i++)
+    {
+        if ((_limits.requiredChannels & (1 << i)) != 0 &&
+            inputs.temp[i] > _limits.maxTemp)
+        {
+            faults |= FAULT_OVER_TEMP;
+            if (inputs.timestamp_us[i] < onset)
+            {
+                onset = inputs.timestamp_us[i];
+            }
+        }
+    }
+
+    // TC1 and TC2 should agree
+    if (_limits.maxDisagreement > 0.0 &&
+        fabs(inputs.temp[SUPERVISOR_TC1] - inputs.temp[SUPERVISOR_TC2]) > _limits.maxDisagreement)
+    {
+        faults |= FAULT_DISAGREEMENT;
+        int64_t newest = inputs.timestamp_us[SUPERVISOR_TC1];
+        if (inputs.timestamp_us[SUPERVISOR_TC2] > newest)
+        {
+            newest = inputs.timestamp_us[SUPERVISOR_TC2];
+        }
+        if (newest < onset)
+        {
+            onset = newest;
+        }
+    }
+
+    // Thermal runaway: either heating hard
+    // without the plate responding (sensor
+    // off the plate) or rising with the
+    // heater off (stuck FET). A window
+    // restarts whenever the heater
+    // changes between the two regimes.
+    // Heating only counts while the plate
+    // is well short of where the duty
+    // would settle it, so holding a high
+    // setpoint isn't a runaway.
+    double temp = inputs.temp[SUPERVISOR_TC1];
+    bool heating = inputs.duty >= _limits.runawayDuty &&
+                   temp < inputs.steadyTemp - _limits.runawayMargin;
+    bool off = inputs.duty <= 0.0;
+    if (!isnan(temp) && (heating || off))
+    {
+        if (_windowStart_us < 0 || heating != _windowHeating)
+        {
+            _windowStart_us = now_us;
+            _windowStartTemp = temp;
+            _windowHeating = heating;
+        }
+        else if (now_us - _windowStart_us >= (int64_t)_limits.runawayWindow_ms * 1000)
+        {
+            double rise = temp - _windowStartTemp;
+            if ((heating && rise < _limits.runawayMinRise) ||
+                (!heating && rise > _limits.runawayMinRise))
+            {
+                faults |= FAULT_RUNAWAY;
+            }
+
+            _windowStart_us = now_us;
+            _windowStartTemp = temp;
+        }
+    }
+    else
+    {
+        _windowStart_us = -1;
+    }
+
+    if (_injected.load(std::memory_order_acquire))
+    {
+        faults |= FAULT_INJECTED;
+        if (_injectedAt_us < onset)
+        {
+            onset = _injectedAt_us;
+        }
+    }
+
+    *onset_us = onset;
+    return faults;
+}
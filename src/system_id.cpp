@@ -0,0 +1,231 @@
+#include <math.h>
+#include "system_id.hpp"
+
+SystemId::SystemId()
+    : _config(defaultSysIdConfig),
+      _start(0),
+      _windowEnd(0),
+      _dutySum(0.0),
+      _dutyCount(0),
+      _samples(0)
+{
+    // x^7 + x^6 + 1
+    uint8_t lfsr = 0x7f;
+    for (int i = 0; i < prbsLength; i++)
+    {
+        _prbs[i] = lfsr & 1;
+        uint8_t bit = ((lfsr >> 6) ^ (lfsr >> 5)) & 1;
+        lfsr = ((lfsr << 1) | bit) & 0x7f;
+    }
+}
+
+void SystemId::begin(const SysIdConfig &config)
+{
+    _config = config;
+}
+
+void SystemId::start(unsigned long ms)
+{
+    _start = ms;
+    _windowEnd = ms + sampleMs;
+    for (int c = 0; c < SYSID_CHANNEL_COUNT; c++)
+    {
+        _sum[c] = 0.0;
+        _count[c] = 0;
+        _lastMean[c] = NAN;
+        for (int d = 0; d <= maxDelay; d++)
+        {
+            _fits[c][d].reset();
+        }
+    }
+    _dutySum = 0.0;
+    _dutyCount = 0;
+    for (int d = 0; d < maxDelay + 2; d++)
+    {
+        _dutyHistory[d] = 0.0;
+    }
+    _samples = 0;
+}
+
+double SystemId::dutyAt(unsigned long ms) const
+{
+    unsigned long elapsed = ms - _start;
+
+    if (_config.excitation == SYSID_STEP)
+    {
+        // Hold low for the first tenth so
+        // the fit sees the plate settled
+        // before the step
+        return elapsed < _config.duration * 100UL ? _config.low : _config.high;
+    }
+
+    int bit = (elapsed / (_config.bitTime * 1000UL)) % prbsLength;
+    return _prbs[bit] ? _config.high : _config.low;
+}
+
+void SystemId::addSample(unsigned long ms, double duty, double tc1, double lmt85)
+{
+    // Close out the window first; a tick
+    // landing past its end starts the
+    // next one
+    if ((long)(ms - _windowEnd) >= 0)
+    {
+        double mean[SYSID_CHANNEL_COUNT];
+        for (int c = 0; c < SYSID_CHANNEL_COUNT; c++)
+        {
+            mean[c] = _count[c] > 0 ? _sum[c] / _count[c] : NAN;
+            _sum[c] = 0.0;
+            _count[c] = 0;
+        }
+        if (_dutyCount > 0)
+        {
+            addWindow(mean, _dutySum / _dutyCount);
+        }
+        _dutySum = 0.0;
+        _dutyCount = 0;
+        _windowEnd += sampleMs;
+    }
+
+    const double readings[SYSID_CHANNEL_COUNT] = {tc1, lmt85};
+    for (int c = 0; c < SYSID_CHANNEL_COUNT; c++)
+    {
+        if (!isnan(readings[c]))
+        {
+            _sum[c] += readings[c];
+            _count[c]++;
+        }
+    }
+    _dutySum += duty;
+    _dutyCount++;
+}
+
+void SystemId::addWindow(const double mean[SYSID_CHANNEL_COUNT], double duty)
+{
+    // Shift the duty history; index d is
+    // the duty d windows before this one
+    for (int d = maxDelay + 1; d > 0; d--)
+    {
+        _dutyHistory[d] = _dutyHistory[d - 1];
+    }
+    _dutyHistory[0] = duty;
+    _samples++;
+
+    // Every candidate is fit over the same
+    // samples, once the history is full,
+    // so their errors compare fairly
+    if (_samples > maxDelay + 2)
+    {
+        for (int c = 0; c < SYSID_CHANNEL_COUNT; c++)
+        {
+            if (isnan(_lastMean[c]) || isnan(mean[c]))
+            {
+                continue;
+            }
+
+            // The duty behind the step from
+            // the last window to this one is
+            // the last window's, delayed
+            for (int d = 0; d <= maxDelay; d++)
+            {
+                const double phi[3] = {_lastMean[c], _dutyHistory[d + 1], 1.0};
+                _fits[c][d].update(phi, mean[c]);
+            }
+        }
+    }
+
+    for (int c = 0; c < SYSID_CHANNEL_COUNT; c++)
+    {
+        _lastMean[c] = mean[c];
+    }
+}
+
+bool SystemId::isDone(unsigned long ms, double tc1) const
+{
+    return ms - _start >= _config.duration * 1000UL || tc1 >= _config.maxTemp;
+}
+
+bool SystemId::getModel(SysIdChannel channel, PlateModel &model, double &rmsError) const
+{
+    int best = -1;
+    for (int d = 0; d <= maxDelay; d++)
+    {
+        const Fit &fit = _fits[channel][d];
+        if (fit.count > 0 && (best < 0 || fit.sumSqError < _fits[channel][best].sumSqError))
+        {
+            best = d;
+        }
+    }
+    if (best < 0)
+    {
+        return false;
+    }
+
+    const Fit &fit = _fits[channel][best];
+    double a = fit.theta[0];
+    double b = fit.theta[1];
+    double c = fit.theta[2];
+    if (!(a > 0.0 && a < 1.0 && b > 0.0))
+    {
+        return false;
+    }
+
+    double ts = sampleMs / 1000.0;
+    model.tau = -ts / log(a);
+    model.gain = b / (1.0 - a);
+    model.ambient = c / (1.0 - a);
+    // Candidate d pairs each window with
+    // the duty d + 1 windows earlier
+    model.deadTime = (best + 1) * ts;
+    rmsError = sqrt(fit.sumSqError / fit.count);
+
+    return true;
+}
+
+void SystemId::Fit::reset()
+{
+    for (int i = 0; i < 3; i++)
+    {
+        theta[i] = 0.0;
+        for (int j = 0; j < 3; j++)
+        {
+            p[i][j] = i == j ? 1e4 : 0.0;
+        }
+    }
+    sumSqError = 0.0;
+    count = 0;
+}
+
+void SystemId::Fit::update(const double phi[3], double y)
+{
+    // A priori error; also what ranks the
+    // candidate dead times
+    double error = y;
+    for (int i = 0; i < 3; i++)
+    {
+        error -= theta[i] * phi[i];
+    }
+    sumSqError += error * error;
+    count++;
+
+    double pPhi[3];
+    double denom = 1.0;
+    for (int i = 0; i < 3; i++)
+    {
+        pPhi[i] = 0.0;
+        for (int j = 0; j < 3; j++)
+        {
+            pPhi[i] += p[i][j] * phi[j];
+        }
+        denom += phi[i] * pPhi[i];
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        double k = pPhi[i] / denom;
+        theta[i] += k * error;
+        for (int j = 0; j < 3; j++)
+        {
+            p[i][j] -= k * pPhi[j];
+        }
+    }
+}
@@ -0,0 +1,217 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "telemetry.hpp"
+
+static const uint32_t decimalScale[] = {1, 10, 100, 1000};
+
+int formatFixed(char *buf, double value, int decimals)
+{
+    // Scaled value has to fit 32 bits;
+    // anything else (including NaN) is
+    // left to printf, which is slow but
+    // never happens on a healthy plate
+    double scaled = fabs(value) * decimalScale[decimals] + 0.5;
+    if (!(scaled < 4294967295.0))
+    {
+        int len = snprintf(buf, fixedMaxLength, "%0.*f", decimals, value);
+        return len < fixedMaxLength ? len : fixedMaxLength - 1;
+    }
+
+    // Digits are generated backwards
+    char tmp[16];
+    int n = 0;
+    uint32_t v = (uint32_t)scaled;
+    bool negative = value < 0 && v != 0;
+    for (int i = 0; i < decimals; i++)
+    {
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    }
+    if (decimals > 0)
+    {
+        tmp[n++] = '.';
+    }
+    do
+    {
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v != 0);
+    if (negative)
+    {
+        tmp[n++] = '-';
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        buf[i] = tmp[n - 1 - i];
+    }
+    buf[n] = '\0';
+
+    return n;
+}
+
+// Per column: subscription name and
+// header title; output titles are
+// prefixed with the zone name
+static const char *const columnNames[COLUMN_COUNT] = {
+    "setpoint",
+    "tc1",
+    "tc2",
+    "lmt85",
+    "estimate",
+    "rate",
+    "latency",
+    "age",
+    "energy",
+    "outputs",
+    "phase",
+};
+static const char *const columnTitles[COLUMN_COUNT] = {
+    "Set Point",
+    "Under Heater",
+    "Target Board",
+    "Built-In Temp",
+    "Estimate",
+    "Rate",
+    "Sensor To Actuation (us)",
+    "Sample To Client (us)",
+    "Energy (J)",
+    "PID Output",
+    "Phase",
+};
+
+int formatCsvBody(char *buf, size_t size, const TelemetryRow &row, uint32_t columns)
+{
+    // Rate is in C/s and needs the extra
+    // digit; latencies are whole us and
+    // energy whole J
+    const double values[] = {row.setpoint,
+                             row.tc1Temp,
+                             row.tc2Temp,
+                             row.lmt85Temp,
+                             row.estimateTemp,
+                             row.estimateRate,
+                             row.sensorToActuation_us,
+                             row.sampleToClient_us,
+                             row.energy_J};
+    const int decimals[] = {2, 2, 2, 2, 2, 3, 0, 0, 0};
+    const int numValues = sizeof(values) / sizeof(values[0]);
+    const int numOutputs = (columns & (1u << COLUMN_OUTPUTS)) ? row.numOutputs : 0;
+
+    // Each field takes a comma plus at
+    // most fixedMaxLength bytes; stop
+    // early rather than overrun
+    size_t len = 0;
+    for (int i = 0; i < numValues + numOutputs; i++)
+    {
+        if (i < numValues && !(columns & (1u << i)))
+        {
+            continue;
+        }
+        if (size - len < (size_t)fixedMaxLength + 2)
+        {
+            break;
+        }
+
+        buf[len++] = ',';
+        if (i < numValues)
+        {
+            len += formatFixed(buf + len, values[i], decimals[i]);
+        }
+        else
+        {
+            len += formatFixed(buf + len, row.outputs[i - numValues], 2);
+        }
+    }
+    size_t phaseLen = strlen(row.phase);
+    if ((columns & (1u << COLUMN_PHASE)) && size - len >= phaseLen + 3)
+    {
+        buf[len++] = ',';
+        memcpy(buf + len, row.phase, phaseLen);
+        len += phaseLen;
+    }
+    buf[len++] = '\n';
+    buf[len] = '\0';
+
+    return len;
+}
+
+int formatCsvHeader(char *buf, size_t size, uint32_t columns, const char *const *outputNames, int numOutputs)
+{
+    int len = snprintf(buf, size, "Time");
+    for (int c = 0; c < COLUMN_COUNT; c++)
+    {
+        if (!(columns & (1u << c)))
+        {
+            continue;
+        }
+
+        if (c != COLUMN_OUTPUTS)
+        {
+            len += snprintf(buf + len, size - len, ",\"%s\"", columnTitles[c]);
+        }
+        for (int i = 0; c == COLUMN_OUTPUTS && i < numOutputs && len < (int)size; i++)
+        {
+            len += snprintf(buf + len, size - len, ",\"%s %s\"", outputNames[i], columnTitles[c]);
+        }
+        if (len >= (int)size)
+        {
+            return size - 1;
+        }
+    }
+
+    return len;
+}
+
+uint32_t parseCsvColumns(const char *names)
+{
+    if (strcmp(names, "all") == 0)
+    {
+        return csvAllColumns;
+    }
+
+    uint32_t columns = 0;
+    while (*names != '\0')
+    {
+        const char *end = strchr(names, ',');
+        size_t length = end != NULL ? (size_t)(end - names) : strlen(names);
+
+        int c = 0;
+        while (c < COLUMN_COUNT &&
+               !(strlen(columnNames[c]) == length && strncmp(columnNames[c], names, length) == 0))
+        {
+            c++;
+        }
+        if (c == COLUMN_COUNT)
+        {
+            return 0;
+        }
+        columns |= 1u << c;
+
+        names += end != NULL ? length + 1 : length;
+    }
+
+    return columns;
+}
+
+char *prependCsvTime(char *body, unsigned long time_ms)
+{
+    // Round to hundredths of a second
+    unsigned long centis = (time_ms + 5) / 10;
+
+    char *p = body;
+    *--p = '0' + centis % 10;
+    centis /= 10;
+    *--p = '0' + centis % 10;
+    centis /= 10;
+    *--p = '.';
+    do
+    {
+        *--p = '0' + centis % 10;
+        centis /= 10;
+    } while (centis != 0);
+
+    return p;
+}
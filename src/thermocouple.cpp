@@ -0,0 +1,212 @@
+#include <math.h>
+#include "thermocouple.hpp"
+
+// NIST ITS-90 K-type coefficients,
+// lowest order first. Temperature (C) to
+// EMF (mV), -270 C to 0 C:
+static constexpr double emfBelowZero[] = {
+    0.000000000000E+00,
+    0.394501280250E-01,
+    0.236223735980E-04,
+    -0.328589067840E-06,
+    -0.499048287770E-08,
+    -0.675090591730E-10,
+    -0.574103274280E-12,
+    -0.310888728940E-14,
+    -0.104516093650E-16,
+    -0.198892668780E-19,
+    -0.163226974860E-22,
+};
+
+// 0 C to 1372 C, plus
+// a0 exp(a1 (t - a2)^2)
+static constexpr double emfAboveZero[] = {
+    -0.176004136860E-01,
+    0.389212049750E-01,
+    0.185587700320E-04,
+    -0.994575928740E-07,
+    0.318409457190E-09,
+    -0.560728448890E-12,
+    0.560750590590E-15,
+    -0.320207200030E-18,
+    0.971511471520E-22,
+    -0.121047212750E-25,
+};
+static constexpr double emfA0 = 0.118597600000E+00;
+static constexpr double emfA1 = -0.118343200000E-03;
+static constexpr double emfA2 = 0.126968600000E+03;
+
+// EMF (mV) to temperature (C), -5.891 mV
+// to 0 mV (-200 C to 0 C):
+static constexpr double tempBelowZero[] = {
+    0.0000000E+00,
+    2.5173462E+01,
+    -1.1662878E+00,
+    -1.0833638E+00,
+    -8.9773540E-01,
+    -3.7342377E-01,
+    -8.6632643E-02,
+    -1.0450598E-02,
+    -5.1920577E-04,
+};
+
+// 0 mV to 20.644 mV (0 C to 500 C)
+static constexpr double tempToMid[] = {
+    0.000000E+00,
+    2.508355E+01,
+    7.860106E-02,
+    -2.503131E-01,
+    8.315270E-02,
+    -1.228034E-02,
+    9.804036E-04,
+    -4.413030E-05,
+    1.057734E-06,
+    -1.052755E-08,
+};
+
+// 20.644 mV to 54.886 mV (500 C to
+// 1372 C)
+static constexpr double tempToTop[] = {
+    -1.318058E+02,
+    4.830222E+01,
+    -1.646031E+00,
+    5.464731E-02,
+    -9.650715E-04,
+    8.802193E-06,
+    -3.110810E-08,
+};
+static constexpr double tempMid_mV = 20.644;
+
+#define NUM_COEFFS(c) ((int)(sizeof(c) / sizeof(c[0])))
+
+static constexpr double horner(const double *c, int n, double x)
+{
+    return n == 1 ? c[0] : c[0] + x * horner(c + 1, n - 1, x);
+}
+
+// exp() as a constant expression:
+// halve x until the Taylor series
+// converges quickly, then square back
+static constexpr double expSeries(double x, double term, int n)
+{
+    return n > 20 ? term : term + expSeries(x, term * x / n, n + 1);
+}
+
+static constexpr double square(double x)
+{
+    return x * x;
+}
+
+static constexpr double constExp(double x)
+{
+    return x > -0.5 && x < 0.5 ? expSeries(x, 1.0, 1) : square(constExp(x / 2));
+}
+
+static constexpr double nistEmf(double temp)
+{
+    return temp < 0.0
+               ? horner(emfBelowZero, NUM_COEFFS(emfBelowZero), temp)
+               : horner(emfAboveZero, NUM_COEFFS(emfAboveZero), temp) +
+                     emfA0 * constExp(emfA1 * square(temp - emfA2));
+}
+
+static constexpr double nistTemp(double emf)
+{
+    return emf < 0.0          ? horner(tempBelowZero, NUM_COEFFS(tempBelowZero), emf)
+           : emf < tempMid_mV ? horner(tempToMid, NUM_COEFFS(tempToMid), emf)
+                              : horner(tempToTop, NUM_COEFFS(tempToTop), emf);
+}
+
+// Table spans; the EMF table only needs
+// the MAX31855's cold junction range
+static constexpr double tempTableMin_mV = -6.0;
+static constexpr double tempTableStep_mV = 0.25;
+static const int tempTableSize = 245;
+static constexpr double emfTableMin_c = -40.0;
+static constexpr double emfTableStep_c = 2.5;
+static const int emfTableSize = 67;
+
+// 0, 1, ... N - 1 as a parameter pack,
+// to fill a table in one constant
+// expression
+template <int... I>
+struct Indices
+{
+};
+
+template <int N, int... I>
+struct MakeIndices : MakeIndices<N - 1, N - 1, I...>
+{
+};
+
+template <int... I>
+struct MakeIndices<0, I...>
+{
+    typedef Indices<I...> type;
+};
+
+template <int N>
+struct Table
+{
+    float values[N];
+};
+
+template <int N, int... I>
+static constexpr Table<N> makeTempTable(Indices<I...>)
+{
+    return Table<N>{{(float)nistTemp(tempTableMin_mV + I * tempTableStep_mV)...}};
+}
+
+template <int N, int... I>
+static constexpr Table<N> makeEmfTable(Indices<I...>)
+{
+    return Table<N>{{(float)nistEmf(emfTableMin_c + I * emfTableStep_c)...}};
+}
+
+static constexpr Table<tempTableSize> tempTable =
+    makeTempTable<tempTableSize>(MakeIndices<tempTableSize>::type());
+static constexpr Table<emfTableSize> emfTable =
+    makeEmfTable<emfTableSize>(MakeIndices<emfTableSize>::type());
+
+// Linear interpolation; past either end
+// the end segment is extended
+static inline float lookup(const float *table, int size, float min, float perStep, float x)
+{
+    float pos = (x - min) * perStep;
+    int i = (int)pos;
+    if (i < 0)
+    {
+        i = 0;
+    }
+    else if (i > size - 2)
+    {
+        i = size - 2;
+    }
+
+    return table[i] + (table[i + 1] - table[i]) * (pos - i);
+}
+
+double correctKType(double tc_c, double coldJunction_c)
+{
+    if (isnan(tc_c))
+    {
+        return tc_c;
+    }
+
+    float cj_mV = lookup(emfTable.values, emfTableSize,
+                         emfTableMin_c, 1.0f / emfTableStep_c, coldJunction_c);
+    float emf = ((float)tc_c - (float)coldJunction_c) * (float)max31855Gain_mV + cj_mV;
+
+    return lookup(tempTable.values, tempTableSize,
+                  tempTableMin_mV, 1.0f / tempTableStep_mV, emf);
+}
+
+double getKTypeEmf_mV(double temp_c)
+{
+    return nistEmf(temp_c);
+}
+
+double getKTypeTemp_c(double emf_mV)
+{
+    return nistTemp(emf_mV);
+}
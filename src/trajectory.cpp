@@ -0,0 +1,231 @@
+#include <math.h>
+#include "trajectory.hpp"
+
+Trajectory::Trajectory()
+    : _numSamples(0),
+      _step_ms(defaultTrajectoryConfig.step_ms),
+      _duration(0),
+      _numInfeasible(0),
+      _peak(0.0),
+      _maxDeviation(0.0) {}
+
+double Trajectory::maxHeatRate(const PlateModel &model, double headroom, double temp)
+{
+    // From the model at the planned duty;
+    // none above where it levels off
+    double rate = (model.gain * headroom - (temp - model.ambient)) / model.tau;
+    return rate > 0.0 ? rate : 0.0;
+}
+
+double Trajectory::maxCoolRate(const PlateModel &model, double temp)
+{
+    // Heaters off; nothing cools it
+    // below ambient
+    double rate = (temp - model.ambient) / model.tau;
+    return rate > 0.0 ? rate : 0.0;
+}
+
+bool Trajectory::compile(const Profile &profile, const PlateModel &model, const TrajectoryConfig &config)
+{
+    _numSamples = 0;
+    _numInfeasible = 0;
+    _peak = 0.0;
+    _maxDeviation = 0.0;
+    _duration = profile.getDuration();
+    if (profile.getNumPoints() < 2 || _duration == 0 || config.step_ms <= 0 ||
+        model.tau <= 0.0 || config.headroom <= 0.0)
+    {
+        return false;
+    }
+
+    // Heating is hardest at a segment's
+    // hot end and cooling at its cool end
+    for (int i = 1; i < profile.getNumPoints(); i++)
+    {
+        const ReflowCurvePoint &from = profile.getPoint(i - 1);
+        const ReflowCurvePoint &to = profile.getPoint(i);
+        // Profile::set() refuses these, so
+        // this is only a guard
+        if (to.time_ms <= from.time_ms)
+        {
+            _numInfeasible = 0;
+            return false;
+        }
+
+        double slope = (to.temp_c - from.temp_c) * 1000.0 / (to.time_ms - from.time_ms);
+        double limit;
+        if (slope > 0.0)
+        {
+            limit = maxHeatRate(model, config.headroom, to.temp_c);
+        }
+        else
+        {
+            limit = -maxCoolRate(model, to.temp_c);
+        }
+
+        if (fabs(slope) > fabs(limit))
+        {
+            InfeasibleSegment &s = _infeasible[_numInfeasible++];
+            s.point = i;
+            s.slope = slope;
+            s.limit = limit;
+        }
+    }
+
+    _step_ms = config.step_ms;
+    if (_duration / _step_ms + 1 > (unsigned long)maxSamples)
+    {
+        _step_ms = (_duration + maxSamples - 2) / (maxSamples - 1);
+    }
+    _numSamples = _duration / _step_ms + 1;
+
+    // The profile's last point is where
+    // it ends; setpointAt() is already 0
+    // there
+    const int lastPoint = profile.getNumPoints() - 1;
+    const ReflowCurvePoint &last = profile.getPoint(lastPoint);
+    double dt = _step_ms / 1000.0;
+    double temp = profile.getPoint(0).temp_c;
+    int nextPoint = 1;
+    bool holding = false;
+    double heldPeak = 0.0;
+    for (int k = 0; k < _numSamples; k++)
+    {
+        unsigned long t = (unsigned long)k * _step_ms;
+        double target = t < _duration ? profile.setpointAt(t) : last.temp_c;
+
+        // A peak the plate hasn't reached by
+        // its time is held until it has, so
+        // the table keeps the profile's peak
+        for (; nextPoint < lastPoint && (unsigned long)profile.getPoint(nextPoint).time_ms <= t; nextPoint++)
+        {
+            int peak = profile.getPoint(nextPoint).temp_c;
+            if (peak > profile.getPoint(nextPoint - 1).temp_c && peak >= profile.getPoint(nextPoint + 1).temp_c)
+            {
+                holding = true;
+                heldPeak = peak;
+            }
+        }
+        if (holding && temp >= heldPeak)
+        {
+            holding = false;
+        }
+        if (holding)
+        {
+            target = fmax(target, heldPeak);
+        }
+
+        if (!config.enabled || k == 0)
+        {
+            temp = target;
+        }
+        else
+        {
+            // Follow the profile no faster than
+            // the plate can at its temperature
+            double change = target - temp;
+            double up = maxHeatRate(model, config.headroom, temp) * dt;
+            double down = maxCoolRate(model, temp) * dt;
+            temp += change > up ? up : (change < -down ? -down : change);
+        }
+        _table[k] = temp;
+    }
+
+    // Round the corners with a centred
+    // moving average, in place: the ring
+    // keeps the values that have been
+    // overwritten but are still in the
+    // window. The window narrows so it
+    // never spans a local maximum, which
+    // would round the peak off.
+    int half = config.enabled ? (int)(config.cornerTime / dt / 2.0 + 0.5) : 0;
+    if (half > (maxCornerSamples - 1) / 2)
+    {
+        half = (maxCornerSamples - 1) / 2;
+    }
+    if (half > 0)
+    {
+        // Local maxima as runs of equal
+        // samples with lower on both sides
+        int peakStart[Profile::maxPoints];
+        int peakEnd[Profile::maxPoints];
+        int numPeaks = 0;
+        for (int k = 1; k < _numSamples - 1 && numPeaks < Profile::maxPoints;)
+        {
+            int end = k;
+            while (end + 1 < _numSamples - 1 && _table[end + 1] == _table[k])
+            {
+                end++;
+            }
+            if (_table[k - 1] < _table[k] && _table[end + 1] < _table[k])
+            {
+                peakStart[numPeaks] = k;
+                peakEnd[numPeaks] = end;
+                numPeaks++;
+            }
+            k = end + 1;
+        }
+
+        const int width = 2 * half + 1;
+        float ring[maxCornerSamples];
+        double sum = 0.0;
+        for (int j = -half; j <= half; j++)
+        {
+            int k = j < 0 ? 0 : (j >= _numSamples ? _numSamples - 1 : j);
+            ring[j + half] = _table[k];
+            sum += _table[k];
+        }
+
+        int oldest = 0;
+        int peak = 0;
+        for (int k = 0; k < _numSamples; k++)
+        {
+            float value = sum / width;
+
+            // Past a peak, the next one is the
+            // nearest ahead
+            while (peak + 1 < numPeaks && peakEnd[peak] < k)
+            {
+                peak++;
+            }
+            int reach = half;
+            for (int p = peak > 0 ? peak - 1 : 0; p <= peak && p < numPeaks; p++)
+            {
+                int distance = k < peakStart[p] ? peakStart[p] - k : (k > peakEnd[p] ? k - peakEnd[p] : 0);
+                reach = distance < reach ? distance : reach;
+            }
+            if (reach < half)
+            {
+                // Ring slot of k + j is
+                // oldest + half + j
+                double narrow = 0.0;
+                for (int j = -reach; j <= reach; j++)
+                {
+                    narrow += ring[(oldest + half + j) % width];
+                }
+                value = narrow / (2 * reach + 1);
+            }
+
+            // Slide: drop the oldest, take the
+            // sample half past k, or the last
+            // one past the end
+            int next = k + half + 1;
+            float incoming = _table[next < _numSamples ? next : _numSamples - 1];
+            sum += incoming - ring[oldest];
+            ring[oldest] = incoming;
+            oldest = (oldest + 1) % width;
+
+            _table[k] = value;
+        }
+    }
+
+    for (int k = 0; k < _numSamples; k++)
+    {
+        unsigned long t = (unsigned long)k * _step_ms;
+        double given = t < _duration ? profile.setpointAt(t) : last.temp_c;
+        _peak = fmax(_peak, _table[k]);
+        _maxDeviation = fmax(_maxDeviation, fabs(_table[k] - given));
+    }
+
+    return true;
+}
@@ -0,0 +1,134 @@
+#include <Arduino.h>
+#include <PID_v1.h>
+#include "zone.hpp"
+
+Zone::Zone(const char *name,
+           int fetPin,
+           int pwmChannel,
+           ZoneSensor sensor,
+           double profileOffset,
+           double kp,
+           double ki,
+           double kd)
+    : _name(name),
+      _fetPin(fetPin),
+      _pwmChannel(pwmChannel),
+      _sensor(sensor),
+      _profileOffset(profileOffset),
+      _maxDuty(0),
+      _input(0.0),
+      _output(0.0),
+      _setpoint(0.0),
+      _pid(&_input, &_output, &_setpoint, kp, ki, kd, DIRECT),
+      _gainsPending(false),
+      _trim(1.0),
+      _computed_us(0),
+      _sampleTime(1000),
+      _lastInput(0.0),
+      _dInput(0.0) {}
+
+void Zone::holdOff()
+{
+    pinMode(_fetPin, OUTPUT);
+    digitalWrite(_fetPin, LOW);
+}
+
+bool Zone::begin(int maxOutput, int sampleTime, double phase)
+{
+    _maxDuty = maxOutput;
+    _sampleTime = sampleTime;
+
+    if (!_heater.begin(_fetPin, _pwmChannel, phase))
+    {
+        return false;
+    }
+
+    // Set PID output limits, sample time
+    // based on loop delay time, and
+    // automatic mode
+    _pid.SetOutputLimits(0, _maxDuty);
+    _pid.SetSampleTime(sampleTime);
+    _pid.SetMode(AUTOMATIC);
+
+    return true;
+}
+
+void Zone::update(double input, double setpoint)
+{
+    // The offset only applies while a
+    // profile is driving the setpoint;
+    // a zero setpoint means heater off
+    _input = input;
+    _setpoint = (setpoint > 0.0) ? setpoint + _profileOffset : 0.0;
+
+    // Returning from manual re-initializes
+    // the PID from the current output, so
+    // switching controllers is bumpless
+    _pid.SetMode(AUTOMATIC);
+    if (_gainsPending)
+    {
+        switchGains(_pid, _output, _input, _setpoint, _pendingGains);
+        _gainsPending = false;
+    }
+    if (_pid.Compute())
+    {
+        _dInput = _input - _lastInput;
+        _lastInput = _input;
+    }
+    _computed_us = esp_timer_get_time();
+    _heater.setDuty(_output / _maxDuty);
+}
+
+void Zone::updateManual(double input, double setpoint, double output)
+{
+    // Another controller owns the output;
+    // keep the PID tracking it
+    _input = input;
+    _setpoint = (setpoint > 0.0) ? setpoint + _profileOffset : 0.0;
+    _pid.SetMode(MANUAL);
+    _output = output;
+    _computed_us = esp_timer_get_time();
+    _heater.setDuty(_output / _maxDuty);
+}
+
+void Zone::off()
+{
+    _setpoint = 0.0;
+    _output = 0.0;
+    _heater.setDuty(0.0);
+}
+
+void Zone::getPidTerms(double &p, double &i, double &d)
+{
+    if (_pid.GetMode() != AUTOMATIC)
+    {
+        p = 0.0;
+        i = _output;
+        d = 0.0;
+        return;
+    }
+
+    p = _pid.GetKp() * (_setpoint - _input);
+    d = -_pid.GetKd() * _dInput * 1000.0 / _sampleTime;
+    i = _output - p - d;
+}
+
+void Zone::setGains(const PidGains &gains)
+{
+    _pendingGains = gains;
+    _gainsPending = true;
+}
+
+void Zone::setTrim(double trim)
+{
+    if (trim != _trim)
+    {
+        _pid.SetOutputLimits(0, _maxDuty * trim);
+        _trim = trim;
+    }
+}
+
+void Zone::forceOff()
+{
+    _heater.forceOff();
+}
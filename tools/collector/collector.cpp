@@ -0,0 +1,559 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <algorithm>
+#include "collector.hpp"
+
+int64_t monotonic_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static double threadCpu_s()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+bool parsePlateAddress(const char *spec, PlateAddress &address)
+{
+    std::string s(spec);
+    size_t equals = s.find('=');
+    if (equals != std::string::npos)
+    {
+        address.name = s.substr(equals + 1);
+        s = s.substr(0, equals);
+    }
+    else
+    {
+        address.name.clear();
+    }
+
+    address.port = 2112;
+    size_t colon = s.rfind(':');
+    if (colon != std::string::npos)
+    {
+        char *end;
+        long port = strtol(s.c_str() + colon + 1, &end, 10);
+        if (*end != '\0' || port <= 0 || port > 65535)
+        {
+            return false;
+        }
+        address.port = port;
+        s = s.substr(0, colon);
+    }
+    if (s.empty())
+    {
+        return false;
+    }
+    address.host = s;
+
+    if (address.name.empty())
+    {
+        char port[8];
+        snprintf(port, sizeof(port), "%d", address.port);
+        address.name = address.host + "_" + port;
+    }
+
+    return true;
+}
+
+enum PlateState
+{
+    PLATE_WAITING,
+    PLATE_CONNECTING,
+    PLATE_CONNECTED,
+};
+
+// One plate's connection, stream and
+// open run. A run starts when the phase
+// column leaves idle and ends when it
+// reaches done or fault; a stream
+// without a phase column is stored as
+// one run per connection.
+class Plate : public CsvHandler
+{
+public:
+    Plate(const PlateAddress &address, const std::string &dir);
+
+public:
+    void onHeader(const Field *fields, int numFields);
+    void onRow(const Field *fields, int numFields);
+    void onComment(const char *text, int len);
+
+    void endRun(bool complete);
+
+    PlateAddress address;
+    struct sockaddr_storage addr;
+    socklen_t addrLen;
+
+    int fd;
+    PlateState state;
+    int64_t deadline_ms;
+    int backoff_ms;
+    CsvStream stream;
+
+    uint64_t bytesIn;
+    uint64_t rows;
+    uint64_t rowsStored;
+    uint64_t runs;
+    uint64_t bytesWritten;
+
+private:
+    bool beginRun(int numFields);
+    static bool isRunning(const Field &phase);
+
+    std::string _dir;
+    std::string _header;
+    std::vector<ColumnInfo> _columns;
+    int _phaseField;
+    RunWriter _run;
+};
+
+Plate::Plate(const PlateAddress &address, const std::string &dir)
+    : address(address),
+      addrLen(0),
+      fd(-1),
+      state(PLATE_WAITING),
+      deadline_ms(0),
+      backoff_ms(Collector::minBackoff_ms),
+      bytesIn(0),
+      rows(0),
+      rowsStored(0),
+      runs(0),
+      bytesWritten(0),
+      _dir(dir),
+      _phaseField(-1) {}
+
+void Plate::onHeader(const Field *fields, int numFields)
+{
+    // A new header (after a reconnect or
+    // a subscribe) ends whatever run was
+    // open
+    endRun(false);
+
+    _header.clear();
+    _columns.clear();
+    _phaseField = -1;
+    for (int i = 0; i < numFields; i++)
+    {
+        if (i > 0)
+        {
+            _header += ',';
+        }
+        _header.append(fields[i].p, fields[i].len);
+
+        ColumnInfo c;
+        c.title.assign(fields[i].p, fields[i].len);
+        c.name = columnName(fields[i].p, fields[i].len);
+        c.text = c.title == "Phase";
+        for (size_t j = 0; j < _columns.size(); j++)
+        {
+            if (_columns[j].name == c.name)
+            {
+                char suffix[16];
+                snprintf(suffix, sizeof(suffix), "_%d", i);
+                c.name += suffix;
+            }
+        }
+        if (c.text)
+        {
+            _phaseField = i;
+        }
+        _columns.push_back(c);
+    }
+}
+
+void Plate::onRow(const Field *fields, int numFields)
+{
+    rows++;
+    if (_columns.empty())
+    {
+        return;
+    }
+
+    bool running = _phaseField < 0 || (_phaseField < numFields && isRunning(fields[_phaseField]));
+    if (!_run.isOpen())
+    {
+        if (!running || !beginRun(numFields))
+        {
+            return;
+        }
+    }
+
+    _run.addRow(fields, numFields);
+    rowsStored++;
+
+    // The done or fault row is the run's
+    // last
+    if (!running)
+    {
+        endRun(true);
+    }
+}
+
+void Plate::onComment(const char *, int)
+{
+}
+
+bool Plate::beginRun(int numFields)
+{
+    // Header titles past the last field
+    // (the gains) aren't columns
+    std::vector<ColumnInfo> columns(_columns.begin(),
+                                    _columns.begin() + std::min((size_t)numFields, _columns.size()));
+
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char name[48];
+    strftime(name, sizeof(name), "%Y%m%d-%H%M%S", &tm);
+    char seq[16];
+    snprintf(seq, sizeof(seq), "-%llu", (unsigned long long)runs);
+
+    if (!_run.begin(_dir + "/" + name + seq, columns, _header))
+    {
+        fprintf(stderr, "%s: can't create run directory under %s\n", address.name.c_str(), _dir.c_str());
+        return false;
+    }
+    runs++;
+
+    return true;
+}
+
+void Plate::endRun(bool complete)
+{
+    if (!_run.isOpen())
+    {
+        return;
+    }
+
+    uint64_t before = _run.getBytesWritten();
+    if (!_run.end(complete))
+    {
+        fprintf(stderr, "%s: writing run failed\n", address.name.c_str());
+    }
+    bytesWritten += _run.getBytesWritten() - before;
+}
+
+bool Plate::isRunning(const Field &phase)
+{
+    static const char *const stopped[] = {"idle", "done", "fault"};
+    for (size_t i = 0; i < sizeof(stopped) / sizeof(stopped[0]); i++)
+    {
+        if ((size_t)phase.len == strlen(stopped[i]) && memcmp(phase.p, stopped[i], phase.len) == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+Collector::Collector(const std::string &outDir)
+    : _outDir(outDir),
+      _epoll(epoll_create1(EPOLL_CLOEXEC)),
+      _verbose(false),
+      _connects(0),
+      _disconnects(0),
+      _reportedRows(0),
+      _reportedBytesIn(0) {}
+
+Collector::~Collector()
+{
+    for (size_t i = 0; i < _plates.size(); i++)
+    {
+        if (_plates[i]->fd >= 0)
+        {
+            close(_plates[i]->fd);
+        }
+        delete _plates[i];
+    }
+    if (_epoll >= 0)
+    {
+        close(_epoll);
+    }
+}
+
+bool Collector::add(const PlateAddress &address)
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    char port[8];
+    snprintf(port, sizeof(port), "%d", address.port);
+    struct addrinfo *result;
+    if (getaddrinfo(address.host.c_str(), port, &hints, &result) != 0)
+    {
+        return false;
+    }
+
+    Plate *plate = new Plate(address, _outDir + "/" + address.name);
+    memcpy(&plate->addr, result->ai_addr, result->ai_addrlen);
+    plate->addrLen = result->ai_addrlen;
+    freeaddrinfo(result);
+    _plates.push_back(plate);
+
+    return true;
+}
+
+void Collector::setVerbose(bool verbose)
+{
+    _verbose = verbose;
+}
+
+bool Collector::run(const std::atomic<bool> &stop, int reportPeriod_ms)
+{
+    if (_epoll < 0)
+    {
+        return false;
+    }
+
+    int64_t start = monotonic_ms();
+    for (size_t i = 0; i < _plates.size(); i++)
+    {
+        startConnect(*_plates[i], start);
+    }
+
+    // Timers are checked on a fixed tick
+    // rather than per event, so their
+    // cost doesn't grow with the row rate
+    const int timerTick_ms = 100;
+    int64_t nextTimers = start + timerTick_ms;
+    int64_t nextReport = start + reportPeriod_ms;
+    double cpuStart = threadCpu_s();
+    double cpuReported = cpuStart;
+    int64_t reported = start;
+
+    struct epoll_event events[256];
+    while (!stop.load(std::memory_order_relaxed))
+    {
+        int64_t now = monotonic_ms();
+        int timeout = nextTimers > now ? (int)(nextTimers - now) : 0;
+        int n = epoll_wait(_epoll, events, sizeof(events) / sizeof(events[0]), timeout);
+        if (n < 0 && errno != EINTR)
+        {
+            perror("epoll_wait");
+            return false;
+        }
+
+        now = monotonic_ms();
+        for (int i = 0; i < n; i++)
+        {
+            Plate &plate = *(Plate *)events[i].data.ptr;
+            if (plate.state == PLATE_CONNECTING)
+            {
+                onConnected(plate, now);
+            }
+            else if (plate.state == PLATE_CONNECTED)
+            {
+                onReadable(plate, now);
+            }
+        }
+
+        if (now >= nextTimers)
+        {
+            checkTimers(now);
+            nextTimers = now + timerTick_ms;
+        }
+        if (reportPeriod_ms > 0 && now >= nextReport)
+        {
+            double cpu = threadCpu_s();
+            report(now, now - reported, cpu - cpuReported);
+            cpuReported = cpu;
+            reported = now;
+            nextReport = now + reportPeriod_ms;
+        }
+    }
+
+    for (size_t i = 0; i < _plates.size(); i++)
+    {
+        _plates[i]->endRun(false);
+    }
+
+    return true;
+}
+
+void Collector::startConnect(Plate &plate, int64_t now_ms)
+{
+    plate.fd = socket(plate.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (plate.fd < 0)
+    {
+        disconnect(plate, now_ms, strerror(errno));
+        return;
+    }
+
+    int one = 1;
+    setsockopt(plate.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    int r = connect(plate.fd, (struct sockaddr *)&plate.addr, plate.addrLen);
+    if (r != 0 && errno != EINPROGRESS)
+    {
+        disconnect(plate, now_ms, strerror(errno));
+        return;
+    }
+
+    // Writable once connected
+    struct epoll_event ev;
+    ev.events = EPOLLOUT;
+    ev.data.ptr = &plate;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, plate.fd, &ev);
+    plate.state = PLATE_CONNECTING;
+    plate.deadline_ms = now_ms + connectTimeout_ms;
+}
+
+void Collector::onConnected(Plate &plate, int64_t now_ms)
+{
+    int error = 0;
+    socklen_t len = sizeof(error);
+    getsockopt(plate.fd, SOL_SOCKET, SO_ERROR, &error, &len);
+    if (error != 0)
+    {
+        disconnect(plate, now_ms, strerror(error));
+        return;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = &plate;
+    epoll_ctl(_epoll, EPOLL_CTL_MOD, plate.fd, &ev);
+    plate.state = PLATE_CONNECTED;
+    plate.deadline_ms = now_ms + quietTimeout_ms;
+    plate.backoff_ms = minBackoff_ms;
+    plate.stream.reset();
+    _connects++;
+
+    // Every column, whatever another
+    // session subscribed to; the plate
+    // answers with a fresh header
+    static const char subscribe[] = "subscribe all\n";
+    send(plate.fd, subscribe, sizeof(subscribe) - 1, MSG_NOSIGNAL);
+
+    if (_verbose)
+    {
+        fprintf(stderr, "%s: connected\n", plate.address.name.c_str());
+    }
+}
+
+void Collector::onReadable(Plate &plate, int64_t now_ms)
+{
+    // One read per wakeup keeps plates
+    // fair; level triggering brings us
+    // back for the rest
+    ssize_t n = recv(plate.fd, plate.stream.getWritePtr(), plate.stream.getWriteSpace(), 0);
+    if (n > 0)
+    {
+        plate.bytesIn += n;
+        plate.deadline_ms = now_ms + quietTimeout_ms;
+        plate.stream.received(n, plate);
+    }
+    else if (n == 0)
+    {
+        disconnect(plate, now_ms, "closed by plate");
+    }
+    else if (errno != EAGAIN && errno != EINTR)
+    {
+        disconnect(plate, now_ms, strerror(errno));
+    }
+}
+
+void Collector::disconnect(Plate &plate, int64_t now_ms, const char *reason)
+{
+    if (plate.fd >= 0)
+    {
+        close(plate.fd);
+        plate.fd = -1;
+    }
+    if (plate.state == PLATE_CONNECTED)
+    {
+        _disconnects++;
+    }
+
+    // A run cut off here is kept, marked
+    // incomplete
+    plate.endRun(false);
+    plate.state = PLATE_WAITING;
+    plate.deadline_ms = now_ms + plate.backoff_ms;
+    plate.backoff_ms = std::min(plate.backoff_ms * 2, (int)maxBackoff_ms);
+
+    if (_verbose)
+    {
+        fprintf(stderr, "%s: %s; retrying in %lld ms\n",
+                plate.address.name.c_str(), reason, (long long)(plate.deadline_ms - now_ms));
+    }
+}
+
+void Collector::checkTimers(int64_t now_ms)
+{
+    for (size_t i = 0; i < _plates.size(); i++)
+    {
+        Plate &plate = *_plates[i];
+        if (now_ms < plate.deadline_ms)
+        {
+            continue;
+        }
+
+        switch (plate.state)
+        {
+        case PLATE_WAITING:
+            startConnect(plate, now_ms);
+            break;
+        case PLATE_CONNECTING:
+            disconnect(plate, now_ms, "connect timed out");
+            break;
+        case PLATE_CONNECTED:
+            disconnect(plate, now_ms, "no data");
+            break;
+        }
+    }
+}
+
+CollectorStats Collector::getStats() const
+{
+    CollectorStats s;
+    memset(&s, 0, sizeof(s));
+    s.plates = _plates.size();
+    s.connects = _connects;
+    s.disconnects = _disconnects;
+    for (size_t i = 0; i < _plates.size(); i++)
+    {
+        const Plate &p = *_plates[i];
+        s.connected += p.state == PLATE_CONNECTED ? 1 : 0;
+        s.bytesIn += p.bytesIn;
+        s.rows += p.rows;
+        s.rowsStored += p.rowsStored;
+        s.runs += p.runs;
+        s.bytesWritten += p.bytesWritten;
+        s.droppedLines += p.stream.getDroppedLines();
+    }
+
+    return s;
+}
+
+void Collector::report(int64_t, int64_t elapsed_ms, double cpu_s)
+{
+    CollectorStats s = getStats();
+    double seconds = elapsed_ms / 1000.0;
+    fprintf(stderr, "collector: %d/%d connected, %.0f rows/s, %.1f kB/s in, %llu runs, %.1f kB written, CPU %.1f%% of one core\n",
+            s.connected,
+            s.plates,
+            (s.rows - _reportedRows) / seconds,
+            (s.bytesIn - _reportedBytesIn) / seconds / 1000.0,
+            (unsigned long long)s.runs,
+            s.bytesWritten / 1000.0,
+            100.0 * cpu_s / seconds);
+    _reportedRows = s.rows;
+    _reportedBytesIn = s.bytesIn;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "column_store.hpp"
+#include "csv_stream.hpp"
+
+struct PlateAddress
+{
+    std::string host;
+    int port;
+
+    // Directory under the output root;
+    // host_port unless given
+    std::string name;
+};
+
+// host[:port][=name], port 2112 by
+// default
+bool parsePlateAddress(const char *spec, PlateAddress &address);
+
+struct CollectorStats
+{
+    int plates;
+    int connected;
+    uint64_t connects;
+    uint64_t disconnects;
+    uint64_t bytesIn;
+    uint64_t rows;
+    uint64_t rowsStored;
+    uint64_t runs;
+    uint64_t bytesWritten;
+    uint64_t droppedLines;
+};
+
+class Plate;
+
+// Connects to every plate's telemetry
+// port from one thread with epoll,
+// stores each plate's runs as column
+// files and reconnects, with backoff,
+// to plates that drop or go quiet
+class Collector
+{
+public:
+    // Connect and no-data timeouts, and
+    // the first and longest reconnect
+    // backoff (ms)
+    static const int connectTimeout_ms = 5000;
+    static const int quietTimeout_ms = 10000;
+    static const int minBackoff_ms = 500;
+    static const int maxBackoff_ms = 30000;
+
+    explicit Collector(const std::string &outDir);
+    ~Collector();
+
+public:
+    // Resolves the address now; false if
+    // it can't be
+    bool add(const PlateAddress &address);
+
+    // Until stop is set; open runs are
+    // ended, as incomplete, on the way out
+    bool run(const std::atomic<bool> &stop, int reportPeriod_ms);
+
+    CollectorStats getStats() const;
+
+    // Logs to stderr when set
+    void setVerbose(bool verbose);
+
+private:
+    void startConnect(Plate &plate, int64_t now_ms);
+    void onConnected(Plate &plate, int64_t now_ms);
+    void onReadable(Plate &plate, int64_t now_ms);
+    void disconnect(Plate &plate, int64_t now_ms, const char *reason);
+    void checkTimers(int64_t now_ms);
+    void report(int64_t now_ms, int64_t elapsed_ms, double cpu_s);
+
+    std::string _outDir;
+    std::vector<Plate *> _plates;
+    int _epoll;
+    bool _verbose;
+    uint64_t _connects;
+    uint64_t _disconnects;
+
+    // Totals at the last report
+    uint64_t _reportedRows;
+    uint64_t _reportedBytesIn;
+};
+
+int64_t monotonic_ms();
@@ -0,0 +1,487 @@
+// Collects the telemetry stream of many
+// plates into column files, one
+// directory per plate per run:
+//
+//   collector run [--out dir]
+//         [--plates file] [-v]
+//         host[:port][=name]...
+//   collector simulate [--plates n]
+//         [--port base] [--period ms]
+//         [--cycle s] [--drop ms]
+//   collector selftest [--plates n]
+//         [--seconds s] [--period ms]
+//         [--port base]
+//   collector dump rundir
+//
+// The plates file holds one address per
+// line. selftest runs simulated plates
+// and the collector together, then
+// checks every stored run reads back;
+// it exits nonzero if anything is
+// missing or the collector fell behind.
+
+#include <dirent.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <chrono>
+#include <thread>
+
+#include "collector.hpp"
+#include "column_store.hpp"
+#include "plate_sim.hpp"
+
+static std::atomic<bool> stopRequested(false);
+
+static void onSignal(int)
+{
+    stopRequested.store(true);
+}
+
+static void catchSignals()
+{
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+}
+
+// A descriptor per plate, twice that
+// in selftest
+static void raiseFileLimit()
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+static bool readPlatesFile(const char *path, std::vector<PlateAddress> &plates)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "can't open %s\n", path);
+        return false;
+    }
+
+    char line[256];
+    int number = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        number++;
+        line[strcspn(line, "\r\n#")] = '\0';
+        char spec[256];
+        if (sscanf(line, "%255s", spec) != 1)
+        {
+            continue;
+        }
+        PlateAddress address;
+        if (!parsePlateAddress(spec, address))
+        {
+            fprintf(stderr, "%s:%d: bad address %s\n", path, number, spec);
+            ok = false;
+            continue;
+        }
+        plates.push_back(address);
+    }
+    fclose(file);
+
+    return ok;
+}
+
+static int runCollector(int argc, char **argv)
+{
+    std::string outDir = "out";
+    std::vector<PlateAddress> plates;
+    bool verbose = false;
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+        {
+            outDir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--plates") == 0 && i + 1 < argc)
+        {
+            if (!readPlatesFile(argv[++i], plates))
+            {
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "-v") == 0)
+        {
+            verbose = true;
+        }
+        else
+        {
+            PlateAddress address;
+            if (!parsePlateAddress(argv[i], address))
+            {
+                fprintf(stderr, "bad address %s\n", argv[i]);
+                return 2;
+            }
+            plates.push_back(address);
+        }
+    }
+    if (plates.empty())
+    {
+        fprintf(stderr, "no plates given\n");
+        return 2;
+    }
+
+    Collector collector(outDir);
+    collector.setVerbose(verbose);
+    for (size_t i = 0; i < plates.size(); i++)
+    {
+        if (!collector.add(plates[i]))
+        {
+            fprintf(stderr, "can't resolve %s\n", plates[i].host.c_str());
+            return 1;
+        }
+    }
+
+    return collector.run(stopRequested, 10000) ? 0 : 1;
+}
+
+static int runSimulator(int argc, char **argv)
+{
+    int plates = 10;
+    int port = 21000;
+    int period_ms = 100;
+    int cycle_s = 60;
+    int drop_ms = 0;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        int value = atoi(argv[i + 1]);
+        if (strcmp(argv[i], "--plates") == 0)
+        {
+            plates = value;
+        }
+        else if (strcmp(argv[i], "--port") == 0)
+        {
+            port = value;
+        }
+        else if (strcmp(argv[i], "--period") == 0)
+        {
+            period_ms = value;
+        }
+        else if (strcmp(argv[i], "--cycle") == 0)
+        {
+            cycle_s = value;
+        }
+        else if (strcmp(argv[i], "--drop") == 0)
+        {
+            drop_ms = value;
+        }
+    }
+
+    PlateSim sim;
+    if (!sim.begin(port, plates, period_ms, cycle_s))
+    {
+        return 1;
+    }
+    sim.setDropEvery(drop_ms);
+    sim.run(stopRequested);
+    fprintf(stderr, "sim: %llu rows sent, %llu dropped, %llu connections closed\n",
+            (unsigned long long)sim.getRowsSent(),
+            (unsigned long long)sim.getRowsDropped(),
+            (unsigned long long)sim.getDrops());
+
+    return 0;
+}
+
+static std::vector<std::string> listDir(const std::string &dir)
+{
+    std::vector<std::string> names;
+    DIR *d = opendir(dir.c_str());
+    if (d == NULL)
+    {
+        return names;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL)
+    {
+        if (entry->d_name[0] != '.')
+        {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(d);
+
+    return names;
+}
+
+static void removeTree(const std::string &path)
+{
+    std::vector<std::string> names = listDir(path);
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        std::string child = path + "/" + names[i];
+        if (unlink(child.c_str()) != 0)
+        {
+            removeTree(child);
+        }
+    }
+    rmdir(path.c_str());
+}
+
+static int runSelftest(int argc, char **argv)
+{
+    int plates = 200;
+    int seconds = 15;
+    int period_ms = 100;
+    int port = 21000;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        int value = atoi(argv[i + 1]);
+        if (strcmp(argv[i], "--plates") == 0)
+        {
+            plates = value;
+        }
+        else if (strcmp(argv[i], "--seconds") == 0)
+        {
+            seconds = value;
+        }
+        else if (strcmp(argv[i], "--period") == 0)
+        {
+            period_ms = value;
+        }
+        else if (strcmp(argv[i], "--port") == 0)
+        {
+            port = value;
+        }
+    }
+
+    char tmp[] = "/tmp/collector-XXXXXX";
+    if (mkdtemp(tmp) == NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string outDir = tmp;
+
+    // Short cycles so runs complete within
+    // the test, and a dropped connection
+    // every second for reconnects
+    PlateSim sim;
+    if (!sim.begin(port, plates, period_ms, 8))
+    {
+        return 1;
+    }
+    sim.setDropEvery(1000);
+
+    Collector collector(outDir);
+    for (int i = 0; i < plates; i++)
+    {
+        char spec[64];
+        snprintf(spec, sizeof(spec), "127.0.0.1:%d=plate%03d", port + i, i);
+        PlateAddress address;
+        parsePlateAddress(spec, address);
+        collector.add(address);
+    }
+
+    std::atomic<bool> stop(false);
+    std::thread simThread([&sim, &stop]() { sim.run(stop); });
+    std::thread timer([&stop, seconds]() {
+        for (int i = 0; i < seconds * 10 && !stopRequested.load(); i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        stop.store(true);
+    });
+
+    int64_t start = monotonic_ms();
+    struct timespec cpuStart;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuStart);
+    bool ran = collector.run(stop, 5000);
+    struct timespec cpuEnd;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuEnd);
+    double elapsed_s = (monotonic_ms() - start) / 1000.0;
+    double cpu_s = (cpuEnd.tv_sec - cpuStart.tv_sec) + (cpuEnd.tv_nsec - cpuStart.tv_nsec) / 1e9;
+    timer.join();
+    simThread.join();
+
+    // Every run directory must read back
+    // with all its columns at the row
+    // count it recorded
+    CollectorStats s = collector.getStats();
+    int failures = 0;
+    long rowsRead = 0;
+    int completeRuns = 0;
+    int runDirs = 0;
+    std::vector<std::string> plateDirs = listDir(outDir);
+    for (size_t i = 0; i < plateDirs.size(); i++)
+    {
+        std::string plateDir = outDir + "/" + plateDirs[i];
+        std::vector<std::string> runs = listDir(plateDir);
+        for (size_t j = 0; j < runs.size(); j++)
+        {
+            std::string runDir = plateDir + "/" + runs[j];
+            std::vector<ColumnData> columns;
+            long rows;
+            bool complete;
+            runDirs++;
+            if (!readRun(runDir, columns, rows, complete))
+            {
+                fprintf(stderr, "FAIL %s doesn't read back\n", runDir.c_str());
+                failures++;
+                continue;
+            }
+            rowsRead += rows;
+            completeRuns += complete ? 1 : 0;
+
+            // Stored runs hold only running
+            // phases, then the final one
+            for (size_t c = 0; c < columns.size(); c++)
+            {
+                if (columns[c].info.name == "set_point")
+                {
+                    for (long r = 0; r < rows; r++)
+                    {
+                        double v = columns[c].values[r];
+                        if (isnan(v) || v < 0.0 || v > 240.0)
+                        {
+                            fprintf(stderr, "FAIL %s row %ld set point %.2f\n", runDir.c_str(), r, v);
+                            failures++;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (!ran)
+    {
+        fprintf(stderr, "FAIL collector stopped with an error\n");
+        failures++;
+    }
+    if ((int)plateDirs.size() != plates)
+    {
+        fprintf(stderr, "FAIL runs stored for %d of %d plates\n", (int)plateDirs.size(), plates);
+        failures++;
+    }
+    if ((uint64_t)runDirs != s.runs || (uint64_t)rowsRead != s.rowsStored)
+    {
+        fprintf(stderr, "FAIL %d runs, %ld rows read back; %llu, %llu stored\n",
+                runDirs, rowsRead, (unsigned long long)s.runs, (unsigned long long)s.rowsStored);
+        failures++;
+    }
+    if (completeRuns == 0)
+    {
+        fprintf(stderr, "FAIL no run completed\n");
+        failures++;
+    }
+    if (sim.getRowsDropped() > 0)
+    {
+        fprintf(stderr, "FAIL collector fell behind: %llu rows dropped\n",
+                (unsigned long long)sim.getRowsDropped());
+        failures++;
+    }
+    if (s.droppedLines > 0)
+    {
+        fprintf(stderr, "FAIL %llu lines too long\n", (unsigned long long)s.droppedLines);
+        failures++;
+    }
+
+    // Stored bytes against the CSV bytes
+    // of the rows stored
+    double csvStored = s.rows > 0 ? (double)s.bytesIn * s.rowsStored / s.rows : 0.0;
+    printf("%d plates, %.0f s: %llu rows (%.0f rows/s), %llu reconnects, %d runs (%d complete)\n",
+           plates,
+           elapsed_s,
+           (unsigned long long)s.rows,
+           s.rows / elapsed_s,
+           (unsigned long long)sim.getDrops(),
+           runDirs,
+           completeRuns);
+    printf("stored %.1f kB for %.1f kB of CSV (%.1fx); collector CPU %.1f%% of one core\n",
+           s.bytesWritten / 1000.0,
+           csvStored / 1000.0,
+           s.bytesWritten > 0 ? csvStored / s.bytesWritten : 0.0,
+           100.0 * cpu_s / elapsed_s);
+    printf("%s\n", failures == 0 ? "selftest passed" : "selftest FAILED");
+
+    removeTree(outDir);
+
+    return failures == 0 ? 0 : 1;
+}
+
+static int dumpRun(const char *dir)
+{
+    std::vector<ColumnData> columns;
+    long rows;
+    bool complete;
+    if (!readRun(dir, columns, rows, complete))
+    {
+        fprintf(stderr, "can't read run %s\n", dir);
+        return 1;
+    }
+
+    printf("# %ld rows%s\n", rows, complete ? "" : ", incomplete");
+    for (size_t c = 0; c < columns.size(); c++)
+    {
+        printf("%s\"%s\"", c > 0 ? "," : "", columns[c].info.title.c_str());
+    }
+    printf("\n");
+    for (long r = 0; r < rows; r++)
+    {
+        for (size_t c = 0; c < columns.size(); c++)
+        {
+            const ColumnData &column = columns[c];
+            if (c > 0)
+            {
+                printf(",");
+            }
+            if (column.info.text)
+            {
+                printf("%s", column.text[r].c_str());
+            }
+            else if (!isnan(column.values[r]))
+            {
+                printf("%.*f", column.decimals, column.values[r]);
+            }
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: collector run|simulate|selftest|dump ...\n");
+        return 2;
+    }
+
+    catchSignals();
+    raiseFileLimit();
+
+    if (strcmp(argv[1], "run") == 0)
+    {
+        return runCollector(argc - 2, argv + 2);
+    }
+    if (strcmp(argv[1], "simulate") == 0)
+    {
+        return runSimulator(argc - 2, argv + 2);
+    }
+    if (strcmp(argv[1], "selftest") == 0)
+    {
+        return runSelftest(argc - 2, argv + 2);
+    }
+    if (strcmp(argv[1], "dump") == 0 && argc == 3)
+    {
+        return dumpRun(argv[2]);
+    }
+
+    fprintf(stderr, "unknown command %s\n", argv[1]);
+    return 2;
+}
@@ -0,0 +1,379 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "column_store.hpp"
+
+static void putVarint(std::vector<uint8_t> &out, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+static bool getVarint(const uint8_t *&p, const uint8_t *end, uint64_t &v)
+{
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7)
+    {
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+std::string columnName(const char *title, int len)
+{
+    std::string name;
+    for (int i = 0; i < len; i++)
+    {
+        char c = title[i];
+        if (c >= 'A' && c <= 'Z')
+        {
+            c = c - 'A' + 'a';
+        }
+        bool word = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9');
+        if (word)
+        {
+            name += c;
+        }
+        else if (!name.empty() && name[name.size() - 1] != '_')
+        {
+            name += '_';
+        }
+    }
+    while (!name.empty() && name[name.size() - 1] == '_')
+    {
+        name.erase(name.size() - 1);
+    }
+
+    return name.empty() ? "column" : name;
+}
+
+bool makeDirs(const std::string &path)
+{
+    for (size_t i = 1; i <= path.size(); i++)
+    {
+        if (i == path.size() || path[i] == '/')
+        {
+            std::string prefix = path.substr(0, i);
+            if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+RunWriter::RunWriter()
+    : _rows(0),
+      _buffered(0),
+      _bytesWritten(0),
+      _open(false) {}
+
+bool RunWriter::begin(const std::string &dir, const std::vector<ColumnInfo> &columns, const std::string &header)
+{
+    if (!makeDirs(dir))
+    {
+        return false;
+    }
+
+    _dir = dir;
+    _header = header;
+    _columns.clear();
+    for (size_t i = 0; i < columns.size(); i++)
+    {
+        Column c;
+        c.info = columns[i];
+        c.previous = 0;
+        c.decimals = 0;
+        _columns.push_back(c);
+    }
+    _rows = 0;
+    _buffered = 0;
+    _open = true;
+
+    return true;
+}
+
+bool RunWriter::isOpen() const
+{
+    return _open;
+}
+
+void RunWriter::addRow(const Field *fields, int numFields)
+{
+    for (size_t i = 0; i < _columns.size(); i++)
+    {
+        Column &c = _columns[i];
+        Field f = (int)i < numFields ? fields[i] : Field{"", 0};
+        size_t before = c.data.size();
+
+        if (c.info.text)
+        {
+            if (_rows == 0 || c.lastText.size() != (size_t)f.len || memcmp(c.lastText.data(), f.p, f.len) != 0)
+            {
+                c.lastText.assign(f.p, f.len);
+                char row[24];
+                int len = snprintf(row, sizeof(row), "%ld\t", _rows);
+                c.data.insert(c.data.end(), row, row + len);
+                c.data.insert(c.data.end(), f.p, f.p + f.len);
+                c.data.push_back('\n');
+            }
+        }
+        else
+        {
+            int64_t milli;
+            int decimals;
+            if (parseMilli(f, milli, decimals))
+            {
+                putVarint(c.data, zigzag(milli - c.previous) << 1);
+                c.previous = milli;
+                if (decimals > c.decimals)
+                {
+                    c.decimals = decimals;
+                }
+            }
+            else
+            {
+                putVarint(c.data, 1);
+            }
+        }
+
+        _buffered += c.data.size() - before;
+    }
+    _rows++;
+
+    if (_buffered >= flushSize)
+    {
+        flush();
+    }
+}
+
+bool RunWriter::flush()
+{
+    // Column files are opened only to
+    // append, so hundreds of plates don't
+    // hold thousands of descriptors
+    bool ok = true;
+    for (size_t i = 0; i < _columns.size(); i++)
+    {
+        Column &c = _columns[i];
+        std::string path = _dir + "/" + c.info.name + (c.info.text ? ".txt" : ".col");
+        FILE *file = fopen(path.c_str(), "ab");
+        if (file == NULL)
+        {
+            ok = false;
+            continue;
+        }
+        if (!c.data.empty() && fwrite(c.data.data(), 1, c.data.size(), file) != c.data.size())
+        {
+            ok = false;
+        }
+        if (fclose(file) != 0)
+        {
+            ok = false;
+        }
+        _bytesWritten += c.data.size();
+        c.data.clear();
+    }
+    _buffered = 0;
+
+    return ok;
+}
+
+bool RunWriter::end(bool complete)
+{
+    if (!_open)
+    {
+        return true;
+    }
+    _open = false;
+    bool ok = flush();
+
+    std::string path = _dir + "/columns.txt";
+    FILE *file = fopen(path.c_str(), "w");
+    if (file == NULL)
+    {
+        return false;
+    }
+    fprintf(file, "# %s\n", _header.c_str());
+    fprintf(file, "rows\t%ld\n", _rows);
+    fprintf(file, "complete\t%d\n", complete ? 1 : 0);
+    for (size_t i = 0; i < _columns.size(); i++)
+    {
+        const Column &c = _columns[i];
+        fprintf(file, "%s\t%s\t%d\t%s\n",
+                c.info.text ? "text" : "fixed",
+                c.info.name.c_str(),
+                c.decimals,
+                c.info.title.c_str());
+    }
+
+    return fclose(file) == 0 && ok;
+}
+
+long RunWriter::getRows() const
+{
+    return _rows;
+}
+
+size_t RunWriter::getBuffered() const
+{
+    return _buffered;
+}
+
+uint64_t RunWriter::getBytesWritten() const
+{
+    return _bytesWritten;
+}
+
+static bool readFile(const std::string &path, std::vector<uint8_t> &out)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0)
+    {
+        out.insert(out.end(), buf, buf + n);
+    }
+    fclose(file);
+
+    return true;
+}
+
+static bool readColumn(const std::string &dir, long rows, ColumnData &column)
+{
+    std::vector<uint8_t> data;
+    std::string path = dir + "/" + column.info.name + (column.info.text ? ".txt" : ".col");
+    if (!readFile(path, data))
+    {
+        return rows == 0;
+    }
+
+    const uint8_t *p = data.data();
+    const uint8_t *end = p + data.size();
+    if (column.info.text)
+    {
+        // Each change holds until the next
+        std::string value;
+        while (p < end)
+        {
+            const uint8_t *newline = (const uint8_t *)memchr(p, '\n', end - p);
+            const uint8_t *tab = (const uint8_t *)memchr(p, '\t', end - p);
+            if (newline == NULL || tab == NULL || tab > newline)
+            {
+                return false;
+            }
+            long row = strtol((const char *)p, NULL, 10);
+            while ((long)column.text.size() < row)
+            {
+                column.text.push_back(value);
+            }
+            value.assign((const char *)tab + 1, newline - tab - 1);
+            p = newline + 1;
+        }
+        while ((long)column.text.size() < rows)
+        {
+            column.text.push_back(value);
+        }
+        return (long)column.text.size() == rows;
+    }
+
+    int64_t value = 0;
+    while (p < end)
+    {
+        uint64_t v;
+        if (!getVarint(p, end, v))
+        {
+            return false;
+        }
+        if (v & 1)
+        {
+            column.values.push_back(NAN);
+            continue;
+        }
+        value += unzigzag(v >> 1);
+        column.values.push_back(value / 1000.0);
+    }
+
+    return (long)column.values.size() == rows;
+}
+
+bool readRun(const std::string &dir, std::vector<ColumnData> &columns, long &rows, bool &complete)
+{
+    std::string path = dir + "/columns.txt";
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    rows = 0;
+    complete = false;
+    columns.clear();
+    char line[512];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        line[strcspn(line, "\n")] = '\0';
+        char kind[8];
+        char name[128];
+        int decimals;
+        int offset = 0;
+        int flag;
+        if (sscanf(line, "rows\t%ld", &rows) == 1)
+        {
+            continue;
+        }
+        if (sscanf(line, "complete\t%d", &flag) == 1)
+        {
+            complete = flag != 0;
+            continue;
+        }
+        if (sscanf(line, "%7[a-z]\t%127[^\t]\t%d\t%n", kind, name, &decimals, &offset) == 3 && offset > 0)
+        {
+            ColumnData c;
+            c.info.name = name;
+            c.info.title = line + offset;
+            c.info.text = strcmp(kind, "text") == 0;
+            c.decimals = decimals;
+            columns.push_back(c);
+        }
+    }
+    fclose(file);
+
+    for (size_t i = 0; i < columns.size(); i++)
+    {
+        if (!readColumn(dir, rows, columns[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "csv_stream.hpp"
+
+// A run is stored as one directory with
+// a file per column and columns.txt
+// describing them.
+//
+// Numeric columns (<name>.col) hold
+// values in thousandths, each as the
+// zigzag varint of its difference from
+// the previous value, shifted left one
+// bit; a set low bit marks a missing
+// value (NaN). Telemetry changes slowly
+// from row to row, so most values take
+// one byte.
+//
+// Text columns (<name>.txt) are run
+// length coded: "<row>\t<value>" lines
+// where the value changes.
+
+struct ColumnInfo
+{
+    std::string title;
+    std::string name;
+    bool text;
+};
+
+// File name for a column title, e.g.
+// "Sensor To Actuation (us)" becomes
+// "sensor_to_actuation_us"
+std::string columnName(const char *title, int len);
+
+class RunWriter
+{
+public:
+    // Flush once this much is buffered
+    // across all columns
+    static const size_t flushSize = 32768;
+
+    RunWriter();
+
+public:
+    // Creates dir; header is the raw
+    // header line, kept in columns.txt
+    bool begin(const std::string &dir, const std::vector<ColumnInfo> &columns, const std::string &header);
+    bool isOpen() const;
+
+    // Fields past the last column are
+    // ignored
+    void addRow(const Field *fields, int numFields);
+
+    // Appends buffered data to the column
+    // files; end() also writes columns.txt
+    bool flush();
+    bool end(bool complete);
+
+    long getRows() const;
+    size_t getBuffered() const;
+    uint64_t getBytesWritten() const;
+
+private:
+    struct Column
+    {
+        ColumnInfo info;
+        std::vector<uint8_t> data;
+        int64_t previous;
+        int decimals;
+        std::string lastText;
+    };
+
+    std::string _dir;
+    std::string _header;
+    std::vector<Column> _columns;
+    long _rows;
+    size_t _buffered;
+    uint64_t _bytesWritten;
+    bool _open;
+};
+
+// Decoded column, for dump and self
+// test; text columns come back one
+// value per row
+struct ColumnData
+{
+    ColumnInfo info;
+    int decimals;
+    std::vector<double> values;
+    std::vector<std::string> text;
+};
+
+// Reads a run directory; false if it
+// is unreadable or a column doesn't
+// have every row
+bool readRun(const std::string &dir, std::vector<ColumnData> &columns, long &rows, bool &complete);
+
+// mkdir -p
+bool makeDirs(const std::string &path);
@@ -0,0 +1,167 @@
+#include <string.h>
+#include "csv_stream.hpp"
+
+CsvStream::CsvStream()
+    : _used(0),
+      _discarding(false),
+      _lines(0),
+      _droppedLines(0) {}
+
+void CsvStream::reset()
+{
+    _used = 0;
+    _discarding = false;
+}
+
+void CsvStream::received(size_t n, CsvHandler &handler)
+{
+    const char *start = _buffer;
+    const char *end = _buffer + _used + n;
+    const char *scan = _buffer + _used;
+
+    while (true)
+    {
+        const char *newline = (const char *)memchr(scan, '\n', end - scan);
+        if (newline == NULL)
+        {
+            break;
+        }
+
+        // The rest of an overlong line
+        if (_discarding)
+        {
+            _discarding = false;
+        }
+        else
+        {
+            parseLine(start, newline, handler);
+        }
+        start = newline + 1;
+        scan = start;
+    }
+
+    _used = end - start;
+    if (_used == bufferSize)
+    {
+        _discarding = true;
+        _droppedLines++;
+        _used = 0;
+    }
+    else if (start != _buffer)
+    {
+        memmove(_buffer, start, _used);
+    }
+}
+
+void CsvStream::parseLine(const char *p, const char *end, CsvHandler &handler)
+{
+    if (end > p && end[-1] == '\r')
+    {
+        end--;
+    }
+    if (p == end)
+    {
+        return;
+    }
+    _lines++;
+
+    if (*p == '#')
+    {
+        handler.onComment(p, end - p);
+        return;
+    }
+
+    Field fields[maxFields];
+    int numFields = 0;
+    while (numFields < maxFields)
+    {
+        const char *comma = (const char *)memchr(p, ',', end - p);
+        const char *fieldEnd = comma != NULL ? comma : end;
+
+        Field &f = fields[numFields++];
+        f.p = p;
+        f.len = fieldEnd - p;
+        if (f.len >= 2 && f.p[0] == '"' && f.p[f.len - 1] == '"')
+        {
+            f.p++;
+            f.len -= 2;
+        }
+
+        if (comma == NULL)
+        {
+            break;
+        }
+        p = comma + 1;
+    }
+
+    // Data rows start with the time; the
+    // header starts with its title
+    int64_t milli;
+    int decimals;
+    if (parseMilli(fields[0], milli, decimals))
+    {
+        handler.onRow(fields, numFields);
+    }
+    else
+    {
+        handler.onHeader(fields, numFields);
+    }
+}
+
+bool parseMilli(const Field &field, int64_t &milli, int &decimals)
+{
+    const char *p = field.p;
+    const char *end = field.p + field.len;
+    bool negative = p < end && *p == '-';
+    if (negative)
+    {
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9')
+    {
+        return false;
+    }
+
+    int64_t value = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        value = value * 10 + (*p++ - '0');
+    }
+
+    // Digits past the third decimal are
+    // rounded away
+    decimals = 0;
+    if (p < end && *p == '.')
+    {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            if (decimals < 3)
+            {
+                value = value * 10 + (*p - '0');
+                decimals++;
+            }
+            else if (decimals == 3)
+            {
+                value += *p >= '5' ? 1 : 0;
+                decimals++;
+            }
+            p++;
+        }
+    }
+    if (p != end)
+    {
+        return false;
+    }
+    if (decimals > 3)
+    {
+        decimals = 3;
+    }
+    for (int i = decimals; i < 3; i++)
+    {
+        value *= 10;
+    }
+
+    milli = negative ? -value : value;
+    return true;
+}
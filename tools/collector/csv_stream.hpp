@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One field of a line, pointing into
+// the receive buffer; quotes are
+// stripped, nothing is terminated
+struct Field
+{
+    const char *p;
+    int len;
+};
+
+// What a plate's telemetry stream
+// carries: a header row (on connect and
+// after each subscribe), data rows and
+// "# ..." comment lines
+class CsvHandler
+{
+public:
+    virtual ~CsvHandler() {}
+
+    virtual void onHeader(const Field *fields, int numFields) = 0;
+    virtual void onRow(const Field *fields, int numFields) = 0;
+    virtual void onComment(const char *text, int len) = 0;
+};
+
+// Splits the stream into lines and
+// fields where it was received. Only a
+// partial last line is moved, to the
+// front of the buffer; a line longer
+// than the buffer is dropped.
+class CsvStream
+{
+public:
+    static const int bufferSize = 8192;
+    static const int maxFields = 32;
+
+    CsvStream();
+
+public:
+    void reset();
+
+    // Where to recv() into, and how much
+    // fits
+    char *getWritePtr();
+    size_t getWriteSpace() const;
+
+    // Hands every complete line of the n
+    // bytes just received to handler
+    void received(size_t n, CsvHandler &handler);
+
+    uint64_t getLines() const;
+    uint64_t getDroppedLines() const;
+
+private:
+    void parseLine(const char *p, const char *end, CsvHandler &handler);
+
+    char _buffer[bufferSize];
+    size_t _used;
+    bool _discarding;
+    uint64_t _lines;
+    uint64_t _droppedLines;
+};
+
+// Fixed point number at three decimals
+// (the most the firmware writes), parsed
+// without conversion to double; false if
+// the field isn't a number
+bool parseMilli(const Field &field, int64_t &milli, int &decimals);
+
+inline char *CsvStream::getWritePtr()
+{
+    return _buffer + _used;
+}
+
+inline size_t CsvStream::getWriteSpace() const
+{
+    return bufferSize - _used;
+}
+
+inline uint64_t CsvStream::getLines() const
+{
+    return _lines;
+}
+
+inline uint64_t CsvStream::getDroppedLines() const
+{
+    return _droppedLines;
+}
@@ -0,0 +1,291 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "collector.hpp"
+#include "plate_sim.hpp"
+#include "telemetry.hpp"
+
+// Listener events carry the plate
+// number, client events this offset
+// plus the client's fd
+static const uint64_t clientTag = 1ull << 32;
+
+PlateSim::PlateSim()
+    : _epoll(-1),
+      _period_ms(100),
+      _cycle_s(60),
+      _dropEvery_ms(0),
+      _nextDrop(0),
+      _rowsSent(0),
+      _rowsDropped(0),
+      _drops(0) {}
+
+PlateSim::~PlateSim()
+{
+    for (size_t i = 0; i < _clients.size(); i++)
+    {
+        close(_clients[i].fd);
+    }
+    for (size_t i = 0; i < _listeners.size(); i++)
+    {
+        close(_listeners[i]);
+    }
+    if (_epoll >= 0)
+    {
+        close(_epoll);
+    }
+}
+
+bool PlateSim::begin(int basePort, int numPlates, int period_ms, int cycle_s)
+{
+    _period_ms = period_ms;
+    _cycle_s = cycle_s;
+    _epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (_epoll < 0)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < numPlates; i++)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(basePort + i);
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0)
+        {
+            fprintf(stderr, "sim: can't listen on port %d: %s\n", basePort + i, strerror(errno));
+            close(fd);
+            return false;
+        }
+        _listeners.push_back(fd);
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u64 = i;
+        epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    return true;
+}
+
+void PlateSim::setDropEvery(int dropEvery_ms)
+{
+    _dropEvery_ms = dropEvery_ms;
+}
+
+void PlateSim::run(const std::atomic<bool> &stop)
+{
+    int64_t nextRow = monotonic_ms();
+    int64_t nextDrop = nextRow + _dropEvery_ms;
+
+    struct epoll_event events[64];
+    while (!stop.load(std::memory_order_relaxed))
+    {
+        int64_t now = monotonic_ms();
+        int timeout = nextRow > now ? (int)(nextRow - now) : 0;
+        int n = epoll_wait(_epoll, events, sizeof(events) / sizeof(events[0]), timeout);
+
+        now = monotonic_ms();
+        for (int i = 0; i < n; i++)
+        {
+            uint64_t tag = events[i].data.u64;
+            if (tag < clientTag)
+            {
+                accept((int)tag, now);
+                continue;
+            }
+
+            // Commands are read and dropped;
+            // a subscribe would bring a new
+            // header, which the collector
+            // handles on connect anyway
+            int fd = (int)(tag - clientTag);
+            char buf[256];
+            ssize_t r = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+            if (r == 0 || (r < 0 && errno != EAGAIN))
+            {
+                for (size_t c = 0; c < _clients.size(); c++)
+                {
+                    if (_clients[c].fd == fd)
+                    {
+                        close(fd);
+                        _clients.erase(_clients.begin() + c);
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (now >= nextRow)
+        {
+            sendRows(now);
+            nextRow += _period_ms;
+            if (nextRow < now)
+            {
+                nextRow = now + _period_ms;
+            }
+        }
+        if (_dropEvery_ms > 0 && now >= nextDrop)
+        {
+            dropOne();
+            nextDrop = now + _dropEvery_ms;
+        }
+    }
+}
+
+void PlateSim::accept(int plate, int64_t now_ms)
+{
+    int fd = accept4(_listeners[plate], NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.u64 = clientTag + fd;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev);
+
+    Client client = {fd, plate, now_ms};
+    _clients.push_back(client);
+
+    // Same header as the firmware, gains
+    // column included
+    const char *const zoneNames[] = {"Left", "Right"};
+    char header[512];
+    int len = formatCsvHeader(header, sizeof(header), csvAllColumns, zoneNames, 2);
+    len += snprintf(header + len, sizeof(header) - len, ",\"Kp=500.00 Ki=0.62 Kd=1.00\"\n");
+    send(fd, header, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+void PlateSim::sendRows(int64_t now_ms)
+{
+    char frame[512];
+    char *body = frame + csvTimePrefixSize;
+
+    for (size_t c = 0; c < _clients.size();)
+    {
+        Client &client = _clients[c];
+
+        // Plates run staggered cycles: 30%
+        // idle, a run through the phases,
+        // and done for the last second
+        int64_t cycle_ms = _cycle_s * 1000LL;
+        int64_t t = (now_ms + client.plate * 997LL) % cycle_ms;
+        double idle = 0.3 * cycle_ms;
+        double x = (t - idle) / (cycle_ms - idle);
+
+        TelemetryRow row;
+        const char *phase;
+        double setpoint;
+        if (t < idle)
+        {
+            phase = "idle";
+            setpoint = 0.0;
+        }
+        else if (t >= cycle_ms - 1000)
+        {
+            phase = "done";
+            setpoint = 0.0;
+        }
+        else if (x < 0.35)
+        {
+            phase = "preheat";
+            setpoint = 25.0 + x / 0.35 * 125.0;
+        }
+        else if (x < 0.6)
+        {
+            phase = "soak";
+            setpoint = 150.0 + (x - 0.35) / 0.25 * 30.0;
+        }
+        else if (x < 0.8)
+        {
+            phase = "reflow";
+            setpoint = 180.0 + (x - 0.6) / 0.2 * 60.0;
+        }
+        else
+        {
+            phase = "cooling";
+            setpoint = 240.0 - (x - 0.8) / 0.2 * 190.0;
+        }
+
+        double plate = setpoint > 0.0 ? setpoint - 1.5 : 25.0;
+        double noise = 0.25 * sin(t * 0.0137 + client.plate);
+        row.setpoint = setpoint;
+        row.tc1Temp = plate + noise;
+        row.tc2Temp = plate - 2.0 - noise;
+        row.lmt85Temp = 24.0 + plate * 0.05;
+        row.estimateTemp = plate;
+        row.estimateRate = setpoint > 0.0 ? 0.8 : 0.0;
+        row.sensorToActuation_us = 850 + (t % 40);
+        row.sampleToClient_us = 1200 + (t % 300);
+        row.energy_J = x > 0.0 ? x * 14000.0 : 0.0;
+        row.numOutputs = 2;
+        row.outputs[0] = setpoint > 0.0 ? 55.0 + 10.0 * noise : 0.0;
+        row.outputs[1] = row.outputs[0];
+        row.phase = phase;
+
+        formatCsvBody(body, sizeof(frame) - csvTimePrefixSize, row);
+        char *line = prependCsvTime(body, now_ms - client.connected_ms);
+        size_t len = strlen(line);
+
+        // A row that doesn't fit means the
+        // collector fell behind; a partial
+        // one would corrupt the stream, so
+        // the client goes
+        ssize_t sent = send(client.fd, line, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent == (ssize_t)len)
+        {
+            _rowsSent++;
+            c++;
+            continue;
+        }
+        _rowsDropped++;
+        if (sent > 0)
+        {
+            close(client.fd);
+            _clients.erase(_clients.begin() + c);
+            continue;
+        }
+        c++;
+    }
+}
+
+void PlateSim::dropOne()
+{
+    if (_clients.empty())
+    {
+        return;
+    }
+
+    size_t c = _nextDrop++ % _clients.size();
+    close(_clients[c].fd);
+    _clients.erase(_clients.begin() + c);
+    _drops++;
+}
+
+uint64_t PlateSim::getRowsSent() const
+{
+    return _rowsSent;
+}
+
+uint64_t PlateSim::getRowsDropped() const
+{
+    return _rowsDropped;
+}
+
+uint64_t PlateSim::getDrops() const
+{
+    return _drops;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+// Simulated plates for testing the
+// collector: one listening port each,
+// serving the firmware's CSV stream
+// (same formatting code) through a
+// repeating cycle of idle and a run
+class PlateSim
+{
+public:
+    PlateSim();
+    ~PlateSim();
+
+public:
+    // Ports basePort to basePort +
+    // numPlates - 1; rows every period_ms
+    // and a run every cycle_s seconds
+    bool begin(int basePort, int numPlates, int period_ms, int cycle_s);
+
+    // Closes one client connection every
+    // dropEvery_ms, round robin, to
+    // exercise reconnects; 0 never
+    void setDropEvery(int dropEvery_ms);
+
+    void run(const std::atomic<bool> &stop);
+
+    // Rows that didn't fit a client's
+    // socket buffer, i.e. the collector
+    // fell behind
+    uint64_t getRowsSent() const;
+    uint64_t getRowsDropped() const;
+    uint64_t getDrops() const;
+
+private:
+    struct Client
+    {
+        int fd;
+        int plate;
+        int64_t connected_ms;
+    };
+
+    void accept(int plate, int64_t now_ms);
+    void sendRows(int64_t now_ms);
+    void dropOne();
+
+    std::vector<int> _listeners;
+    std::vector<Client> _clients;
+    int _epoll;
+    int _period_ms;
+    int _cycle_s;
+    int _dropEvery_ms;
+    int _nextDrop;
+    uint64_t _rowsSent;
+    uint64_t _rowsDropped;
+    uint64_t _drops;
+};